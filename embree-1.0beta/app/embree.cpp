@@ -41,6 +41,12 @@ namespace embree
   Ref<Device> g_device = null;
   Ref<Device::RTRenderer> g_renderer = null;
   std::string g_accel = "default";
+  FileName g_bvhCache = "";
+  FileName g_shadowRays = "";
+  FileName g_bvhInput = "";
+  int g_numThreads = 1;
+  bool g_persistent = false;
+  std::string g_affinity = "core";
   Ref<GroupNode> g_scene = new GroupNode;
   int g_depth = -1;
   int g_spp = 1;
@@ -53,6 +59,8 @@ namespace embree
   size_t g_width = 512, g_height = 512;
   Ref<Device::RTFrameBuffer> g_frameBuffer = NULL;
   Ref<Device::RTImage> g_backplate = NULL;
+  std::string g_traceFormat = "v1";
+  std::string g_traceSampling = "all";
 
   /* regression testing mode */
   bool g_regression = false;
@@ -110,8 +118,11 @@ namespace embree
     return texture_map[fileName.str()] = texture;
   }
 
-  Ref<Device::RTScene> createScene(const Ref<Scene>& root, const TraceData traceFile)
+  Ref<Device::RTScene> createScene(const Ref<Scene>& root, TraceData traceFile)
   {
+    traceFile.bvhCacheDir = g_bvhCache;
+    traceFile.shadowRayFile = g_shadowRays;
+    traceFile.bvhInputFile = g_bvhInput;
     std::vector<Ref<Device::RTPrimitive> > prims;
     for (Scene::iterator i=root->begin(); i!=root->end(); i++)
     {
@@ -151,9 +162,9 @@ namespace embree
     return renderer;
   }
 
-  static Ref<Device::RTRenderer> parsePathTracer(Ref<ParseStream> cin, const FileName& path)
+  static Ref<Device::RTRenderer> parsePathTracer(Ref<ParseStream> cin, const FileName& path, const char* type = "pathtracer")
   {
-    Ref<Device::RTRenderer> renderer = g_device->rtNewRenderer("pathtracer");
+    Ref<Device::RTRenderer> renderer = g_device->rtNewRenderer(type);
     renderer->rtSetFloat1("gamma",g_gamma);
     if (g_depth >= 0) renderer->rtSetInt1("maxDepth",g_depth);
     renderer->rtSetInt1("sampler.spp",g_spp);
@@ -217,6 +228,14 @@ namespace embree
     g_rendered = true;
   }
 
+  static void replayMode(const FileName& fileName, bool legacy)
+  {
+    /* build the acceleration structure without recording */
+    Ref<Device::RTScene> scene = createScene(g_scene.cast<Scene>(), TraceData(FileName(""),FileName("")));
+    g_device->rtReplayTrace(fileName.c_str(),scene,legacy);
+    g_rendered = true;
+  }
+
   static void parseCommandLine(Ref<ParseStream> cin, const FileName& path)
   {
     while (true)
@@ -353,9 +372,29 @@ namespace embree
       else if (tag == "-refine") g_refine = true;
       else if (tag == "-norefine") g_refine = false;
 
+      /* the thread options are read before the library got initialized, see parseInitOptions */
+      else if (tag == "-threads") {
+        if (cin->getInt() != g_numThreads) std::cerr << "Warning: -threads is only supported on the command line" << std::endl;
+      }
+      else if (tag == "-persistent") {
+        if (!g_persistent) std::cerr << "Warning: -persistent is only supported on the command line" << std::endl;
+      }
+      else if (tag == "-affinity") {
+        if (cin->getString() != g_affinity) std::cerr << "Warning: -affinity is only supported on the command line" << std::endl;
+      }
+
       /* acceleration structure to use */
       else if (tag == "-accel") g_accel = cin->getString();
 
+      /* directory of cached acceleration structures */
+      else if (tag == "-bvhcache") g_bvhCache = path + cin->getFileName();
+
+      /* recorded trace whose AnyHit rays guide the SRDH builders */
+      else if (tag == "-shadowrays") g_shadowRays = path + cin->getFileName();
+
+      /* BVH file written by Topaz for the .import accels */
+      else if (tag == "-bvhinput") g_bvhInput = path + cin->getFileName();
+
       /* set renderer */
       else if (tag == "-renderer")
       {
@@ -363,6 +402,7 @@ namespace embree
         if      (renderer == "debug"     ) g_renderer = parseDebugRenderer(cin,path);
         else if (renderer == "pt"        ) g_renderer = parsePathTracer(cin,path);
         else if (renderer == "pathtracer") g_renderer = parsePathTracer(cin,path);
+        else if (renderer == "wavefront" ) g_renderer = parsePathTracer(cin,path,"wavefront");
         else throw std::runtime_error("unknown renderer: "+renderer);
       }
 
@@ -399,10 +439,24 @@ namespace embree
       {
         FileName raysFile = cin->getFileName();
         FileName bvhFile = cin->getFileName();
-        TraceData d = TraceData(FileName(path + raysFile),FileName(FileName(path + bvhFile)));
+        TraceData d = TraceData(FileName(path + raysFile),FileName(FileName(path + bvhFile)),g_traceFormat,g_traceSampling);
         traceMode(d);
       }
 
+      /* replay ray traces */
+      else if (tag == "-replaytrace")
+        replayMode(path + cin->getFileName(),false);
+
+      /* replay ray traces of the original printer */
+      else if (tag == "-replaylegacytrace")
+        replayMode(path + cin->getFileName(),true);
+
+      /* format of saved ray traces */
+      else if (tag == "-traceformat") g_traceFormat = cin->getString();
+
+      /* sampling of saved ray traces */
+      else if (tag == "-tracesampling") g_traceSampling = cin->getString();
+
       /* display image */
       else if (tag == "-display")
         displayMode();
@@ -428,7 +482,7 @@ namespace embree
         std::cout << "         embree -i model.obj -renderer pathtracer -o out.tga" << std::endl;
         std::cout << "         embree -c model.ecs -display" << std::endl;
         std::cout << std::endl;
-        std::cout << "-renderer [debug,pathtracer]" << std::endl;
+        std::cout << "-renderer [debug,pathtracer,wavefront]" << std::endl;
         std::cout << "  Sets the renderer to use." << std::endl;
         std::cout << std::endl;
         std::cout << "-c file" << std::endl;
@@ -443,6 +497,20 @@ namespace embree
         std::cout << "-savetrace file" << std::endl;
         std::cout << "  Renders and saves the ray trace data to the file." << std::endl;
         std::cout << std::endl;
+        std::cout << "-replaytrace file" << std::endl;
+        std::cout << "  Shoots the rays of a saved ray trace again and reports the rays per second." << std::endl;
+        std::cout << std::endl;
+        std::cout << "-replaylegacytrace file" << std::endl;
+        std::cout << "  Like -replaytrace for version 1 traces of the original printer, which swap the" << std::endl;
+        std::cout << "  ABrk and ACon IDs and store only the direction of AnyHit rays." << std::endl;
+        std::cout << std::endl;
+        std::cout << "-traceformat v1|v2|v2.lz4[+ext]" << std::endl;
+        std::cout << "  Sets the file format of saved ray traces (default v1). With +ext the records" << std::endl;
+        std::cout << "  additionally store pixel, sample, hit primitive, and ray segment." << std::endl;
+        std::cout << std::endl;
+        std::cout << "-tracesampling all|every:n|rate:p|reservoir:k" << std::endl;
+        std::cout << "  Saves only a weighted sample of the rays, requires -traceformat v2." << std::endl;
+        std::cout << std::endl;
         std::cout << "-display" << std::endl;
         std::cout << "  Interactively displays the rendering into a window." << std::endl;
         std::cout << std::endl;
@@ -467,9 +535,32 @@ namespace embree
         std::cout << "-fullscreen" << std::endl;
         std::cout << "  Enables full screen display mode." << std::endl;
         std::cout << std::endl;
-        std::cout << "-accel [bvh2,bvh4,bvh4.spatial]" << std::endl;
+        std::cout << "-threads n" << std::endl;
+        std::cout << "  Uses n threads, -1 for one per logical thread (default 1)." << std::endl;
+        std::cout << std::endl;
+        std::cout << "-persistent" << std::endl;
+        std::cout << "  Keeps the worker threads waiting for jobs instead of meeting at a barrier." << std::endl;
+        std::cout << std::endl;
+        std::cout << "-affinity [core,compact,scatter,none]" << std::endl;
+        std::cout << "  Pins the threads one per core, filling cores first, spreading them over" << std::endl;
+        std::cout << "  the packages, or not at all (default core)." << std::endl;
+        std::cout << std::endl;
+        std::cout << "-accel [bvh2,bvh2.morton,bvh2.trbvh,bvh2.srdh,bvh2.rbvh,bvh2.srdh.rbvh,bvh2.import,bvh4,bvh4.packet,bvh4.spatial,bvh4.morton,bvh4.trbvh,bvh4.srdh,bvh4.import,bvh8,bvh8.spatial]" << std::endl;
         std::cout << "  Sets the spatial index structure to use." << std::endl;
         std::cout << std::endl;
+        std::cout << "-bvhcache dir" << std::endl;
+        std::cout << "  Loads spatial index structures from dir instead of building them, and stores" << std::endl;
+        std::cout << "  newly built ones there. Entries are keyed by the scene triangles and -accel." << std::endl;
+        std::cout << std::endl;
+        std::cout << "-shadowrays file" << std::endl;
+        std::cout << "  Samples the AnyHit rays of a recorded trace, the bvh2.srdh and bvh4.srdh" << std::endl;
+        std::cout << "  builders pick the splits that are cheapest for these rays, the .rbvh" << std::endl;
+        std::cout << "  variants order the children of each node for them." << std::endl;
+        std::cout << std::endl;
+        std::cout << "-bvhinput file" << std::endl;
+        std::cout << "  Loads the BVH or RBVH of a Topaz .bvh file for bvh2.import and bvh4.import." << std::endl;
+        std::cout << "  The OBJ triangle indices of the file refer to the triangles of the scene." << std::endl;
+        std::cout << std::endl;
         std::cout << "-gamma v" << std::endl;
         std::cout << "  Sets gamma correction to v (only pathtracer)." << std::endl;
         std::cout << std::endl;
@@ -531,9 +622,22 @@ namespace embree
     }
   }
 
+  /*! The device initializes the library before the command line
+   *  gets parsed, thus the options of the library are read first. */
+  static void parseInitOptions(int argc, char** argv)
+  {
+    for (int i=1; i<argc; i++) {
+      std::string tag = argv[i];
+      if (tag == "-threads" && i+1 < argc) g_numThreads = atoi(argv[++i]);
+      else if (tag == "-persistent") g_persistent = true;
+      else if (tag == "-affinity" && i+1 < argc) g_affinity = argv[++i];
+    }
+  }
+
   /* main function in embree namespace */
   int main( int argc, char** argv) {
-    g_device = new Device();
+    parseInitOptions(argc,argv);
+    g_device = new Device(g_numThreads,g_persistent,g_affinity.c_str());
     g_renderer = g_device->rtNewRenderer("pathtracer");
     g_renderer->rtSetInt1("maxDepth",10);
     g_renderer->rtSetInt1("sampler.spp",1);
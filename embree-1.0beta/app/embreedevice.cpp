@@ -26,9 +26,9 @@ namespace embree
 
   static Atomic initialized(0);
 
-  Device::Device() {
+  Device::Device(int numThreads, bool persistent, const char* affinity) {
     if (initialized++) return;
-    rtInit();
+    rtInit(numThreads,persistent,affinity);
   }
 
   Device::~Device() {
@@ -223,4 +223,9 @@ namespace embree
   bool Device::rtPick(float x, float y, Vec3f& p, const Ref<RTCamera>& camera, const Ref<RTScene>& scene) {
     return embree::rtPick(x, y, p, (embree::RTCamera)camera->handle, (embree::RTScene)scene->handle);
   }
+
+  /** replays a recorded ray trace file against the scene */
+  void Device::rtReplayTrace(const char* fileName, const Ref<RTScene>& scene, bool legacy) {
+    embree::rtReplayTrace(fileName, (embree::RTScene)scene->handle, legacy);
+  }
 }
@@ -36,7 +36,8 @@ namespace embree
                     construction / destruction
     *******************************************************************/
 
-    Device();
+    /*! The first device initializes the library with the given threads. */
+    Device(int numThreads = 1, bool persistent = false, const char* affinity = "core");
     virtual ~Device();
 
 
@@ -182,6 +183,9 @@ namespace embree
 
     /** pick the 3D point at the give location in the image plane */
     bool rtPick(float x, float y, Vec3f& p, const Ref<RTCamera>& camera, const Ref<RTScene>& scene);
+
+    /** replays a recorded ray trace file against the scene */
+    void rtReplayTrace(const char* fileName, const Ref<RTScene>& scene, bool legacy = false);
   };
 }
 
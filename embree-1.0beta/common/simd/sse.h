@@ -35,25 +35,29 @@
 #include <tmmintrin.h>
 #endif
 
-const __m128 _mm_lookupmask_ps[16] = {
-  _mm_castsi128_ps(_mm_set_epi32( 0, 0, 0, 0)),
-  _mm_castsi128_ps(_mm_set_epi32( 0, 0, 0,-1)),
-  _mm_castsi128_ps(_mm_set_epi32( 0, 0,-1, 0)),
-  _mm_castsi128_ps(_mm_set_epi32( 0, 0,-1,-1)),
-  _mm_castsi128_ps(_mm_set_epi32( 0,-1, 0, 0)),
-  _mm_castsi128_ps(_mm_set_epi32( 0,-1, 0,-1)),
-  _mm_castsi128_ps(_mm_set_epi32( 0,-1,-1, 0)),
-  _mm_castsi128_ps(_mm_set_epi32( 0,-1,-1,-1)),
-  _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0)),
-  _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0,-1)),
-  _mm_castsi128_ps(_mm_set_epi32(-1, 0,-1, 0)),
-  _mm_castsi128_ps(_mm_set_epi32(-1, 0,-1,-1)),
-  _mm_castsi128_ps(_mm_set_epi32(-1,-1, 0, 0)),
-  _mm_castsi128_ps(_mm_set_epi32(-1,-1, 0,-1)),
-  _mm_castsi128_ps(_mm_set_epi32(-1,-1,-1, 0)),
-  _mm_castsi128_ps(_mm_set_epi32(-1,-1,-1,-1))
+/* the masks are stored as integers, such that the table is constant
+ * initialized and no code has to run at load time to fill it */
+__align(16) const int _mm_lookupmask_pi32[16][4] = {
+  { 0, 0, 0, 0},
+  {-1, 0, 0, 0},
+  { 0,-1, 0, 0},
+  {-1,-1, 0, 0},
+  { 0, 0,-1, 0},
+  {-1, 0,-1, 0},
+  { 0,-1,-1, 0},
+  {-1,-1,-1, 0},
+  { 0, 0, 0,-1},
+  {-1, 0, 0,-1},
+  { 0,-1, 0,-1},
+  {-1,-1, 0,-1},
+  { 0, 0,-1,-1},
+  {-1, 0,-1,-1},
+  { 0,-1,-1,-1},
+  {-1,-1,-1,-1}
 };
 
+__forceinline __m128 _mm_lookupmask_ps(size_t i) { return _mm_load_ps((const float*)_mm_lookupmask_pi32[i]); }
+
 #if defined (__SSE4_1__) || defined (__SSE4_2__)
 #include <smmintrin.h>
 #else
@@ -41,7 +41,7 @@ namespace embree
     __forceinline sseb( const bool input )
       : m128(input ? _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_setzero_si128(), _mm_setzero_si128())) : _mm_setzero_ps()) {}
     __forceinline sseb( const bool input_0, const bool input_1, const bool input_2, const bool input_3 )
-      : m128(_mm_lookupmask_ps[(size_t(input_3) << 3) | (size_t(input_2) << 2) | (size_t(input_1) << 1) | size_t(input_0)]) {}
+      : m128(_mm_lookupmask_ps((size_t(input_3) << 3) | (size_t(input_2) << 2) | (size_t(input_1) << 1) | size_t(input_0))) {}
 
     __forceinline operator const __m128&( void ) const { return m128; }
     __forceinline operator const __m128i( void ) const { return _mm_castps_si128(m128); }
@@ -22,6 +22,22 @@
 #endif
 
 #include <limits>
+#include <cfloat>
+
+/* GCC does not inline the std::numeric_limits functions at -O0 and emits
+ * them into every object, also into the ones compiled with AVX, where
+ * they get VEX encoded. The builtins are constants instead. */
+#if defined(__GNUC__)
+#define __embree_inf()  __builtin_huge_val()
+#define __embree_inff() __builtin_huge_valf()
+#define __embree_nan()  __builtin_nan("")
+#define __embree_nanf() __builtin_nanf("")
+#else
+#define __embree_inf()  std::numeric_limits<double>::infinity()
+#define __embree_inff() std::numeric_limits<float>::infinity()
+#define __embree_nan()  std::numeric_limits<double>::quiet_NaN()
+#define __embree_nanf() std::numeric_limits<float>::quiet_NaN()
+#endif
 
 namespace embree
 {
@@ -73,8 +89,8 @@ namespace embree
 
   static struct NegInfTy
   {
-    __forceinline operator double( ) const { return -std::numeric_limits<double>::infinity(); }
-    __forceinline operator float ( ) const { return -std::numeric_limits<float>::infinity(); }
+    __forceinline operator double( ) const { return -__embree_inf(); }
+    __forceinline operator float ( ) const { return -__embree_inff(); }
     __forceinline operator int64 ( ) const { return std::numeric_limits<int64>::min(); }
     __forceinline operator uint64( ) const { return std::numeric_limits<uint64>::min(); }
     __forceinline operator int32 ( ) const { return std::numeric_limits<int32>::min(); }
@@ -91,8 +107,8 @@ namespace embree
 
   static struct PosInfTy
   {
-    __forceinline operator double( ) const { return std::numeric_limits<double>::infinity(); }
-    __forceinline operator float ( ) const { return std::numeric_limits<float>::infinity(); }
+    __forceinline operator double( ) const { return __embree_inf(); }
+    __forceinline operator float ( ) const { return __embree_inff(); }
     __forceinline operator int64 ( ) const { return std::numeric_limits<int64>::max(); }
     __forceinline operator uint64( ) const { return std::numeric_limits<uint64>::max(); }
     __forceinline operator int32 ( ) const { return std::numeric_limits<int32>::max(); }
@@ -108,14 +124,14 @@ namespace embree
 
   static struct NaNTy
   {
-    __forceinline operator double( ) const { return std::numeric_limits<double>::quiet_NaN(); }
-    __forceinline operator float ( ) const { return std::numeric_limits<float>::quiet_NaN(); }
+    __forceinline operator double( ) const { return __embree_nan(); }
+    __forceinline operator float ( ) const { return __embree_nanf(); }
   } nan MAYBE_UNUSED;
 
   static struct UlpTy
   {
-    __forceinline operator double( ) const { return std::numeric_limits<double>::epsilon(); }
-    __forceinline operator float ( ) const { return std::numeric_limits<float>::epsilon(); }
+    __forceinline operator double( ) const { return DBL_EPSILON; }
+    __forceinline operator float ( ) const { return FLT_EPSILON; }
   } ulp MAYBE_UNUSED;
 
   static struct PiTy
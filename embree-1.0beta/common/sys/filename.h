@@ -87,7 +87,13 @@ namespace embree
 	public:
 		FileName rayTraceFile;
 		FileName bvhOutputFile;
-		TraceData(FileName& rayTraceFile0, FileName& bvhOutputFile0) : rayTraceFile(rayTraceFile0), bvhOutputFile(bvhOutputFile0) {}
+		std::string rayTraceFormat;
+		std::string rayTraceSampling;
+		FileName bvhCacheDir; // directory of cached acceleration structures, empty to always build
+		FileName shadowRayFile; // recorded trace whose AnyHit rays guide the .srdh builders, empty for none
+		FileName bvhInputFile; // BVH file written by Topaz that the .import accels load, empty for none
+		TraceData(const FileName& rayTraceFile0, const FileName& bvhOutputFile0, const std::string& rayTraceFormat0 = "v1", const std::string& rayTraceSampling0 = "all")
+			: rayTraceFile(rayTraceFile0), bvhOutputFile(bvhOutputFile0), rayTraceFormat(rayTraceFormat0), rayTraceSampling(rayTraceSampling0), bvhCacheDir(""), shadowRayFile(""), bvhInputFile("") {}
 	};
 
 }
@@ -43,6 +43,10 @@ __forceinline int __btr(int v, int i) {
   long r = v; _bittestandreset(&r,i); return r;
 }
 
+__forceinline uint64 rdtsc() {
+  return __rdtsc();
+}
+
 #if defined(__X86_64__) && !defined(__INTEL_COMPILER)
 
 __forceinline size_t __bsf(size_t v) {
@@ -119,6 +123,10 @@ __forceinline int __btr(int v, int i) {
   int r = 0; asm ("btr %1,%0" : "=r"(r) : "r"(i), "0"(v) : "flags"); return r;
 }
 
+__forceinline uint64 rdtsc() {
+  uint32 lo, hi; asm volatile ("rdtsc" : "=a"(lo), "=d"(hi)); return (uint64(hi) << 32) | lo;
+}
+
 __forceinline size_t __bsf(size_t v) {
   size_t r = 0; asm ("bsf %1,%0" : "=r"(r) : "r"(v)); return r;
 }
@@ -144,20 +152,20 @@ __forceinline size_t __btr(size_t v, size_t i) {
   typedef int64 atomic_t;
 
   __forceinline int64 atomic_add( int64 volatile* value, int64 input )
-  {  asm volatile("lock xaddq %0,%1" : "+r" (input), "+m" (*value) : "r" (input), "m" (*value));  return input;  }
+  {  asm volatile("lock xaddq %0,%1" : "+r" (input), "+m" (*value) : "r" (input), "m" (*value) : "memory");  return input;  }
 
   __forceinline int64 atomic_cmpxchg( int64 volatile* value, const int64 input, int64 comparand )
-  {  asm volatile("lock cmpxchgq %2,%0" : "+m" (*value), "+a" (comparand) : "r" (input), "m" (*value), "r" (comparand) : "flags"); return comparand;  }
+  {  asm volatile("lock cmpxchgq %2,%0" : "+m" (*value), "+a" (comparand) : "r" (input), "m" (*value), "r" (comparand) : "flags", "memory"); return comparand;  }
 
 #else
 
   typedef int32 atomic_t;
 
   __forceinline int32 atomic_add( int32 volatile* value, int32 input )
-  {  asm volatile("lock xadd %0,%1" : "+r" (input), "+m" (*value) : "r" (input), "m" (*value)); return input; }
+  {  asm volatile("lock xadd %0,%1" : "+r" (input), "+m" (*value) : "r" (input), "m" (*value) : "memory"); return input; }
 
   __forceinline int32 atomic_cmpxchg( int32 volatile* value, const int32 input, int32 comparand )
-  {  asm volatile("lock cmpxchg %2,%0" : "=m" (*value), "=a" (comparand) : "r" (input), "m" (*value), "a" (comparand) : "flags"); return comparand; }
+  {  asm volatile("lock cmpxchg %2,%0" : "=m" (*value), "=a" (comparand) : "r" (input), "m" (*value), "a" (comparand) : "flags", "memory"); return comparand; }
 
 #endif
 
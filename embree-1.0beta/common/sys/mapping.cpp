@@ -0,0 +1,135 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "sys/mapping.h"
+
+namespace embree
+{
+  struct opaque_mapping_t {
+    const char* data;
+    size_t size;
+#if defined(__WIN32__)
+    void* file;
+    void* map;
+#endif
+  };
+
+  /* returns pointer to the mapped file contents */
+  const char* mappedData(mapping_t mapping) {
+    return mapping->data;
+  }
+
+  /* returns size of the mapped file in bytes */
+  size_t mappedSize(mapping_t mapping) {
+    return mapping->size;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Windows Platform
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__WIN32__)
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+namespace embree
+{
+  /* maps a file read only into memory */
+  mapping_t mapFile(const FileName& file)
+  {
+    HANDLE handle = CreateFileA(file.c_str(),GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+    if (handle == INVALID_HANDLE_VALUE) throw std::runtime_error("cannot open file " + file.str());
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle,&size) || size.QuadPart == 0) {
+      CloseHandle(handle);
+      throw std::runtime_error("cannot map empty file " + file.str());
+    }
+
+    HANDLE map = CreateFileMapping(handle,NULL,PAGE_READONLY,0,0,NULL);
+    void* data = map ? MapViewOfFile(map,FILE_MAP_READ,0,0,0) : NULL;
+    if (!data) {
+      if (map) CloseHandle(map);
+      CloseHandle(handle);
+      throw std::runtime_error("cannot map file " + file.str());
+    }
+
+    mapping_t mapping = new opaque_mapping_t;
+    mapping->data = (const char*) data;
+    mapping->size = size_t(size.QuadPart);
+    mapping->file = handle;
+    mapping->map = map;
+    return mapping;
+  }
+
+  /* unmaps the file */
+  void unmapFile(mapping_t mapping)
+  {
+    UnmapViewOfFile(mapping->data);
+    CloseHandle(HANDLE(mapping->map));
+    CloseHandle(HANDLE(mapping->file));
+    delete mapping;
+  }
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+/// Unix Platform
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__UNIX__)
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace embree
+{
+  /* maps a file read only into memory */
+  mapping_t mapFile(const FileName& file)
+  {
+    int fd = open(file.c_str(),O_RDONLY);
+    if (fd < 0) throw std::runtime_error("cannot open file " + file.str());
+
+    struct stat st;
+    if (fstat(fd,&st) != 0 || st.st_size == 0) {
+      close(fd);
+      throw std::runtime_error("cannot map empty file " + file.str());
+    }
+
+    /* the mapping stays valid after the file descriptor is closed */
+    void* data = mmap(NULL,size_t(st.st_size),PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if (data == MAP_FAILED) throw std::runtime_error("cannot map file " + file.str());
+
+    mapping_t mapping = new opaque_mapping_t;
+    mapping->data = (const char*) data;
+    mapping->size = size_t(st.st_size);
+    return mapping;
+  }
+
+  /* unmaps the file */
+  void unmapFile(mapping_t mapping)
+  {
+    munmap((void*)mapping->data,mapping->size);
+    delete mapping;
+  }
+}
+#endif
@@ -0,0 +1,42 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef __EMBREE_MAPPING_H__
+#define __EMBREE_MAPPING_H__
+
+#include "sys/platform.h"
+#include "sys/filename.h"
+
+namespace embree
+{
+  /*! type for memory mapped file */
+  typedef struct opaque_mapping_t* mapping_t;
+
+  /*! maps a file read only into memory */
+  mapping_t mapFile(const FileName& file);
+
+  /*! returns pointer to the mapped file contents */
+  const char* mappedData(mapping_t mapping);
+
+  /*! returns size of the mapped file in bytes */
+  size_t mappedSize(mapping_t mapping);
+
+  /*! unmaps the file */
+  void unmapFile(mapping_t mapping);
+}
+
+#endif
@@ -0,0 +1,150 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#ifndef __EMBREE_PARALLEL_H__
+#define __EMBREE_PARALLEL_H__
+
+#include "tasking.h"
+
+namespace embree
+{
+  /*! Splits a range into blocks of at most grainSize elements that
+   *  run as the elements of one task, thus they spread over the
+   *  threads of the scheduler. */
+  class BlockedRange
+  {
+  public:
+    BlockedRange (size_t begin, size_t end, size_t grainSize)
+      : begin(begin), end(end), numBlocks(0)
+    {
+      if (grainSize == 0) grainSize = 1;
+      if (end > begin) numBlocks = (end-begin+grainSize-1)/grainSize;
+    }
+
+    /*! Returns the first element of a block, block numBlocks returns end. */
+    __forceinline size_t blockBegin(size_t block) const { return begin+block*(end-begin)/numBlocks; }
+
+  public:
+    size_t begin;        //!< First element of the range.
+    size_t end;          //!< Element after the last one of the range.
+    size_t numBlocks;    //!< Number of blocks the range is split into.
+  };
+
+  /*! Task of a parallel_for, calls the body for one block. */
+  template<typename Func>
+    class ParallelForTask : public BlockedRange
+  {
+  public:
+    ParallelForTask (const BlockedRange& range, const Func& func)
+      : BlockedRange(range), func(func) {}
+
+    static void run(size_t tid, ParallelForTask* This, size_t elt) {
+      This->func(This->blockBegin(elt),This->blockBegin(elt+1));
+    }
+
+  private:
+    const Func& func;
+  };
+
+  /*! Calls func(begin,end) for subranges of at most grainSize
+   *  elements that cover [begin,end) in parallel and returns after
+   *  all calls finished. Can be called inside of a running task. */
+  template<typename Func>
+    void parallel_for(size_t begin, size_t end, size_t grainSize, const Func& func)
+  {
+    BlockedRange range(begin,end,grainSize);
+    if (range.numBlocks <= 1 || scheduler->getNumThreads() == 1) {
+      if (begin < end) func(begin,end);
+      return;
+    }
+    ParallelForTask<Func> task(range,func);
+    TaskGroup group;
+    group.spawn((Task::runFunction)&ParallelForTask<Func>::run,&task,range.numBlocks);
+    group.sync();
+  }
+
+  /*! Task of a parallel_reduce, stores the result of each block. */
+  template<typename Value, typename Func>
+    class ParallelReduceTask : public BlockedRange
+  {
+  public:
+    ParallelReduceTask (const BlockedRange& range, const Func& func)
+      : BlockedRange(range), func(func), values((Value*)alignedMalloc(numBlocks*sizeof(Value))) {}
+
+    ~ParallelReduceTask () {
+      for (size_t i=0; i<numBlocks; i++) values[i].~Value();
+      alignedFree(values);
+    }
+
+    static void run(size_t tid, ParallelReduceTask* This, size_t elt) {
+      new (&This->values[elt]) Value(This->func(This->blockBegin(elt),This->blockBegin(elt+1)));
+    }
+
+  private:
+    const Func& func;
+  public:
+    Value* values;        //!< Result per block.
+  };
+
+  /*! Computes func(begin,end) for subranges of at most grainSize
+   *  elements in parallel and combines the results with reduction,
+   *  starting from identity. The results are combined in the order
+   *  of the subranges, thus the result does not depend on the
+   *  number of threads as long as grainSize does not. */
+  template<typename Value, typename Func, typename Reduction>
+    Value parallel_reduce(size_t begin, size_t end, size_t grainSize, const Value& identity, const Func& func, const Reduction& reduction)
+  {
+    BlockedRange range(begin,end,grainSize);
+    if (range.numBlocks == 0) return identity;
+    ParallelReduceTask<Value,Func> task(range,func);
+    TaskGroup group;
+    group.spawn((Task::runFunction)&ParallelReduceTask<Value,Func>::run,&task,range.numBlocks);
+    group.sync();
+
+    Value value = identity;
+    for (size_t i=0; i<range.numBlocks; i++) value = reduction(value,task.values[i]);
+    return value;
+  }
+
+  /*! Body of firstTouch, writes one byte of each page of a block of pages. */
+  struct FirstTouch
+  {
+    enum { pageSize = 4096 };
+    FirstTouch (char* ptr) : ptr(ptr) {}
+
+    void operator() (size_t begin, size_t end) const {
+      for (size_t i=begin; i<end; i++) ptr[i*size_t(pageSize)] = 0;
+    }
+
+  private:
+    char* ptr;      //!< Start of the memory.
+  };
+
+  /*! Writes to every page of freshly allocated memory from the
+   *  threads of the scheduler. Operating systems with a first touch
+   *  policy place a page on the NUMA node of the thread writing it
+   *  first, thus the memory gets spread over the nodes of the
+   *  threads that work on it instead of the node of the allocating
+   *  thread. The content of the memory is undefined afterwards. */
+  inline void firstTouch(void* ptr, size_t bytes)
+  {
+    if (bytes == 0) return;
+    const size_t pages = (bytes+FirstTouch::pageSize-1)/FirstTouch::pageSize;
+    parallel_for(0,pages,64,FirstTouch((char*)ptr));
+  }
+}
+
+#endif
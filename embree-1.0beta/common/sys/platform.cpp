@@ -130,4 +130,11 @@ namespace embree
 
 #endif
 
+////////////////////////////////////////////////////////////////////////////////
+/// All Platforms
+////////////////////////////////////////////////////////////////////////////////
 
+namespace embree
+{
+  RefCount::~RefCount() {}
+}
@@ -25,8 +25,8 @@ namespace embree
   {
   template<typename Type> friend class Ref;
   public:
-    RefCount() : refCounter(0) {}
-    virtual ~RefCount() {};
+    __forceinline RefCount() : refCounter(0) {}
+    virtual ~RefCount(); //!< out of line, such that only platform.cpp holds the vtable
   private:
     __forceinline void refInc() { refCounter++; }
     __forceinline bool refDec() { return !(--refCounter); }
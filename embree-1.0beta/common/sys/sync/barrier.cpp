@@ -0,0 +1,58 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "sys/sync/barrier.h"
+#include "sys/sysinfo.h"
+#include <emmintrin.h>
+
+namespace embree
+{
+  /*! Iterations a thread spins on the sense before it sleeps. */
+  static const size_t spinsBeforeSleep = 4096;
+
+  void BarrierHybrid::init(size_t count)
+  {
+    this->count = 0;
+    this->full_size = count;
+    this->spins = count <= size_t(getNumberOfLogicalThreads()) ? spinsBeforeSleep : 0;
+  }
+
+  int BarrierHybrid::wait()
+  {
+    const int32 mySense = sense;
+
+    /* the last thread resets the barrier for the next phase and flips the sense */
+    if (atomic_add(&count,1) == atomic_t(full_size)-1) {
+      count = 0;
+      sense = 1-mySense;
+
+      /* the sense has to be visible before sleepers is read, pairs with the increment of sleepers */
+      _mm_mfence();
+      if (sleepers) futexWakeAll(&sense);
+      return 1;
+    }
+
+    for (size_t i=0; i<spins; i++) {
+      if (sense != mySense) return 0;
+      _mm_pause();
+    }
+
+    atomic_add(&sleepers,1);
+    while (sense == mySense) futexWait(&sense,mySense);
+    atomic_add(&sleepers,-1);
+    return 0;
+  }
+}
@@ -18,6 +18,7 @@
 #define __EMBREE_BARRIER_H__
 
 #include "sys/sync/condition.h"
+#include "sys/sync/futex.h"
 
 namespace embree
 {
@@ -54,8 +55,32 @@ namespace embree
     ConditionSys cond;
   };
 
+  /*! Sense reversing barrier. Threads spin shortly on the sense
+   *  and then sleep on a futex until the last thread arrives and
+   *  flips the sense, thus short waits avoid the wake up latency of
+   *  the operating system and long waits do not burn the core. */
+  class BarrierHybrid
+  {
+  public:
+    BarrierHybrid () : count(0), full_size(0), spins(0), sense(0), sleepers(0) {}
+
+    /*! Initializes the barrier for count threads. Threads only spin
+     *  if each of them can have its own hardware thread. */
+    void init(size_t count);
+
+    /*! Waits for all threads, returns 1 for the last arriving thread. */
+    int wait();
+
+  protected:
+    volatile atomic_t count;      //!< Number of threads that arrived.
+    size_t full_size;             //!< Number of threads to wait for.
+    size_t spins;                 //!< Iterations a thread spins before it sleeps.
+    volatile int32 sense;         //!< Flipped by the last arriving thread.
+    volatile atomic_t sleepers;   //!< Number of threads sleeping on the futex.
+  };
+
   /* default barrier type */
-  class Barrier : public BarrierSys {};
+  class Barrier : public BarrierHybrid {};
 }
 
 #endif
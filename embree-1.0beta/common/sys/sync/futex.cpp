@@ -0,0 +1,63 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "sys/sync/futex.h"
+
+#if defined(__LINUX__)
+
+#include <unistd.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+namespace embree
+{
+  void futexWait(volatile int32* address, int32 expected) {
+    syscall(SYS_futex,(int32*)address,FUTEX_WAIT_PRIVATE,expected,NULL,NULL,0);
+  }
+
+  void futexWakeAll(volatile int32* address) {
+    syscall(SYS_futex,(int32*)address,FUTEX_WAKE_PRIVATE,INT_MAX,NULL,NULL,0);
+  }
+}
+
+#else
+
+#include "sys/sync/mutex.h"
+#include "sys/sync/condition.h"
+
+namespace embree
+{
+  /*! One condition for all addresses, waking wakes every sleeper. */
+  static MutexSys* futexMutex = new MutexSys;
+  static ConditionSys* futexCondition = new ConditionSys;
+
+  void futexWait(volatile int32* address, int32 expected)
+  {
+    futexMutex->lock();
+    if (*address == expected) futexCondition->wait(*futexMutex);
+    futexMutex->unlock();
+  }
+
+  void futexWakeAll(volatile int32* address)
+  {
+    futexMutex->lock();
+    futexCondition->broadcast();
+    futexMutex->unlock();
+  }
+}
+
+#endif
@@ -0,0 +1,35 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#ifndef __EMBREE_FUTEX_H__
+#define __EMBREE_FUTEX_H__
+
+#include "sys/platform.h"
+
+namespace embree
+{
+  /*! Puts the calling thread to sleep while the value at the
+   *  address equals the expected value. Uses a futex under Linux and
+   *  a global condition variable elsewhere. Can return spuriously,
+   *  thus callers recheck the value in a loop. */
+  void futexWait(volatile int32* address, int32 expected);
+
+  /*! Wakes all threads sleeping on the address. The value has to be
+   *  changed before calling this function. */
+  void futexWakeAll(volatile int32* address);
+}
+
+#endif
@@ -30,6 +30,7 @@ namespace embree
     ~MutexSys( void );
 
     void lock( void );
+    bool try_lock( void );
     void unlock( void );
 
   protected:
@@ -16,6 +16,15 @@
 
 #include "sys/sysinfo.h"
 
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__WIN32__)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 /// All Platforms
 ////////////////////////////////////////////////////////////////////////////////
@@ -52,6 +61,131 @@ namespace embree
     return "Unknown";
 #endif
   }
+
+  /* executes the cpuid instruction for the given leaf */
+  static void cpuid(int out[4], int leaf)
+  {
+#if defined(__WIN32__)
+    __cpuid(out,leaf);
+#else
+    unsigned int a,b,c,d; __cpuid(leaf,a,b,c,d);
+    out[0] = a; out[1] = b; out[2] = c; out[3] = d;
+#endif
+  }
+
+  /* reads the extended control register 0 that tells which register states the OS saves */
+  static int64 getXCR0()
+  {
+#if defined(__WIN32__)
+    return (int64)_xgetbv(0);
+#else
+    int32 lo, hi;
+    asm volatile (".byte 0x0f, 0x01, 0xd0" : "=a"(lo), "=d"(hi) : "c"(0)); // xgetbv
+    return (int64(hi) << 32) | uint32(lo);
+#endif
+  }
+
+  /* return true if the CPU supports AVX and the OS saves the AVX state */
+  bool hasAVX()
+  {
+    int info[4]; cpuid(info,0);
+    if (info[0] < 1) return false;
+    cpuid(info,1);
+    const int osxsave = 1 << 27, avx = 1 << 28;
+    if ((info[2] & (osxsave|avx)) != (osxsave|avx)) return false;
+    return (getXCR0() & 6) == 6; //!< XMM and YMM state enabled
+  }
+
+  /* discovers the topology, implemented per platform */
+  static void discoverTopology(std::vector<LogicalThread>& threads);
+
+  /* return the logical threads of the system */
+  const std::vector<LogicalThread>& getThreadTopology()
+  {
+    static std::vector<LogicalThread>* threads = NULL;
+    if (!threads) {
+      std::vector<LogicalThread>* t = new std::vector<LogicalThread>;
+      discoverTopology(*t);
+
+      /* number the threads of each core */
+      for (size_t i=0; i<t->size(); i++) {
+        (*t)[i].smt = 0;
+        for (size_t j=0; j<i; j++)
+          if ((*t)[j].core == (*t)[i].core) (*t)[i].smt++;
+      }
+      threads = t;
+    }
+    return *threads;
+  }
+
+  /* sort key of a logical thread for a placement policy */
+  struct Placement
+  {
+    bool operator< (const Placement& other) const {
+      for (size_t i=0; i<4; i++)
+        if (key[i] != other.key[i]) return key[i] < other.key[i];
+      return id < other.id;
+    }
+  public:
+    int key[4];
+    int id;
+  };
+
+  /* parses an affinity policy */
+  AffinityPolicy parseAffinityPolicy(const std::string& name)
+  {
+    if (name == "none"   ) return AFFINITY_NONE;
+    if (name == "compact") return AFFINITY_COMPACT;
+    if (name == "scatter") return AFFINITY_SCATTER;
+    if (name == "core"   ) return AFFINITY_ONE_PER_CORE;
+    throw std::runtime_error("unknown affinity policy: "+name);
+  }
+
+  /* orders the logical threads for a placement policy */
+  static std::vector<int>* placeThreads(AffinityPolicy policy)
+  {
+    const std::vector<LogicalThread>& threads = getThreadTopology();
+    std::vector<Placement> order(threads.size());
+    for (size_t j=0; j<threads.size(); j++)
+    {
+      const LogicalThread& t = threads[j];
+      Placement& p = order[j];
+      p.id = t.id;
+      switch (policy) {
+      case AFFINITY_COMPACT:
+        p.key[0] = t.package; p.key[1] = t.node; p.key[2] = t.core; p.key[3] = t.smt;
+        break;
+      case AFFINITY_SCATTER: {
+        int rank = 0; /* rank of the core inside its NUMA node */
+        for (size_t k=0; k<threads.size(); k++)
+          if (threads[k].node == t.node && threads[k].smt == 0 && threads[k].core < t.core) rank++;
+        p.key[0] = t.smt; p.key[1] = rank; p.key[2] = t.node; p.key[3] = t.package;
+        break;
+      }
+      default:
+        p.key[0] = t.smt; p.key[1] = t.package; p.key[2] = t.node; p.key[3] = t.core;
+        break;
+      }
+    }
+    std::sort(order.begin(),order.end());
+
+    std::vector<int>* ids = new std::vector<int>(order.size());
+    for (size_t j=0; j<order.size(); j++) (*ids)[j] = order[j].id;
+    return ids;
+  }
+
+  /* return the logical thread to pin the i-th thread of a pool to */
+  int getThreadAffinity(size_t i, AffinityPolicy policy)
+  {
+    if (policy == AFFINITY_NONE) return -1;
+
+    /* the order of each policy is computed on first use */
+    static std::vector<int>* orders[AFFINITY_ONE_PER_CORE+1] = { NULL, NULL, NULL, NULL };
+    if (!orders[policy]) orders[policy] = placeThreads(policy);
+    const std::vector<int>& order = *orders[policy];
+    if (order.empty()) return -1;
+    return order[i % order.size()];
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -88,7 +222,12 @@ namespace embree
 #ifdef __LINUX__
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <sched.h>
 
 namespace embree
 {
@@ -100,6 +239,63 @@ namespace embree
     if (bytes != -1) buf[bytes] = '\0';
     return std::string(buf);
   }
+
+  /* reads an integer from a file of /sys, returns the default if the file cannot be read */
+  static int readSysInt(const char* path, int def)
+  {
+    FILE* file = fopen(path,"r");
+    if (!file) return def;
+    int value = def;
+    if (fscanf(file,"%d",&value) != 1) value = def;
+    fclose(file);
+    return value;
+  }
+
+  /* discovers packages, cores and NUMA nodes of the logical threads the process may run on */
+  static void discoverTopology(std::vector<LogicalThread>& threads)
+  {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    const bool restricted = sched_getaffinity(0,sizeof(allowed),&allowed) == 0;
+
+    /* CPU numbers may be sparse, thus enumerate the cpu directories instead of counting up to the number of threads */
+    std::vector<std::pair<int,int> > cores;
+    for (int i=0; ; i++)
+    {
+      char path[256];
+      sprintf(path,"/sys/devices/system/cpu/cpu%d",i);
+      DIR* dir = opendir(path);
+      if (!dir) break;
+
+      /* the NUMA node shows up as a nodeN entry of the cpu directory */
+      int node = 0;
+      while (struct dirent* entry = readdir(dir))
+        if (!strncmp(entry->d_name,"node",4) && isdigit(entry->d_name[4])) node = atoi(entry->d_name+4);
+      closedir(dir);
+
+      if (restricted && i < CPU_SETSIZE && !CPU_ISSET(i,&allowed)) continue;
+      sprintf(path,"/sys/devices/system/cpu/cpu%d/online",i);
+      if (!readSysInt(path,1)) continue;
+
+      sprintf(path,"/sys/devices/system/cpu/cpu%d/topology/physical_package_id",i);
+      const int package = std::max(readSysInt(path,0),0);
+      sprintf(path,"/sys/devices/system/cpu/cpu%d/topology/core_id",i);
+      const int coreID = readSysInt(path,i);
+
+      /* core IDs are only unique inside a package */
+      size_t core = 0;
+      while (core < cores.size() && cores[core] != std::make_pair(package,coreID)) core++;
+      if (core == cores.size()) cores.push_back(std::make_pair(package,coreID));
+
+      threads.push_back(LogicalThread(i,int(core),package,node));
+    }
+
+    /* without /sys every logical thread counts as a core of its own */
+    if (threads.empty()) {
+      const int N = getNumberOfLogicalThreads();
+      for (int i=0; i<N; i++) threads.push_back(LogicalThread(i,i));
+    }
+  }
 }
 
 #endif
@@ -143,3 +339,20 @@ namespace embree
 }
 #endif
 
+////////////////////////////////////////////////////////////////////////////////
+/// Platforms without Topology Discovery
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(__LINUX__)
+
+namespace embree
+{
+  /* reports every logical thread as a core of its own */
+  static void discoverTopology(std::vector<LogicalThread>& threads)
+  {
+    const int N = getNumberOfLogicalThreads();
+    for (int i=0; i<N; i++) threads.push_back(LogicalThread(i,i));
+  }
+}
+#endif
+
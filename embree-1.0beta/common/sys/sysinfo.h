@@ -20,6 +20,7 @@
 #include "sys/platform.h"
 
 #include <string>
+#include <vector>
 
 namespace embree
 {
@@ -31,6 +32,41 @@ namespace embree
 
   /*! return the number of logical threads of the system */
   int getNumberOfLogicalThreads();
+
+  /*! return true if the CPU supports AVX and the OS saves the AVX state */
+  bool hasAVX();
+
+  /*! Location of a logical thread in the machine. */
+  struct LogicalThread
+  {
+    LogicalThread (int id = 0, int core = 0, int package = 0, int node = 0, int smt = 0)
+      : id(id), core(core), package(package), node(node), smt(smt) {}
+
+  public:
+    int id;       //!< ID of the logical thread as used for setting the affinity.
+    int core;     //!< Physical core, unique over all packages.
+    int package;  //!< Package (socket) of the core.
+    int node;     //!< NUMA node of the logical thread.
+    int smt;      //!< Index of the logical thread among the threads of its core.
+  };
+
+  /*! return the logical threads of the system, discovered from /sys
+   *  under Linux, other platforms report one core per logical thread */
+  const std::vector<LogicalThread>& getThreadTopology();
+
+  /*! Policies to place the threads of a thread pool. */
+  enum AffinityPolicy {
+    AFFINITY_NONE,           //!< Do not pin threads.
+    AFFINITY_COMPACT,        //!< Fill the SMT threads of a core, then the cores of a NUMA node, then the next node and package.
+    AFFINITY_SCATTER,        //!< Spread threads round robin over the NUMA nodes, using one thread per core first.
+    AFFINITY_ONE_PER_CORE    //!< One thread per core through the packages and their NUMA nodes, SMT siblings only once all cores are used.
+  };
+
+  /*! parses compact, scatter, core or none into a policy */
+  AffinityPolicy parseAffinityPolicy(const std::string& name);
+
+  /*! return the logical thread to pin the i-th thread of a pool to, -1 for no pinning */
+  int getThreadAffinity(size_t i, AffinityPolicy policy);
 }
 
 #endif
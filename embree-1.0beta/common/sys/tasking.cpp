@@ -16,6 +16,7 @@
 
 #include "tasking.h"
 #include <xmmintrin.h>
+#include <emmintrin.h>
 #include "sys/sysinfo.h"
 
 #if defined(__WIN32__)
@@ -23,70 +24,258 @@
 #include <windows.h>
 #endif
 
+/*! prevents the compiler from moving memory accesses across this point */
+#if defined(__WIN32__)
+#define COMPILER_BARRIER _ReadWriteBarrier()
+#else
+#define COMPILER_BARRIER asm volatile("" ::: "memory")
+#endif
+
 namespace embree
 {
-  TaskScheduler::TaskScheduler (size_t numThreads) : numTasks(0), activeTasks(0)
+  /*! Index of the scheduler thread that runs the calling thread,
+   *  selects the deque that tasks created by the thread go to. */
+  static __thread size_t threadIndex = 0;
+
+  /*! True while the calling thread runs tasks of the scheduler. */
+  static __thread bool runningTasks = false;
+
+  /*! Initial number of slots of a deque. */
+  static const size_t initialDequeSize = 256;
+
+  /*! Failed attempts to find a task before an idle thread yields. */
+  static const size_t spinsBeforeYield = 64;
+
+  /*! Iterations an idle persistent worker spins before it sleeps. */
+  static const size_t spinsBeforeSleep = 4096;
+
+  TaskScheduler::TaskDeque::TaskDeque ()
+    : top(0), bottom(0), array(new Array(initialDequeSize)) {}
+
+  TaskScheduler::TaskDeque::~TaskDeque ()
+  {
+    delete array;
+    for (size_t i=0; i<retired.size(); i++) delete retired[i];
+  }
+
+  TaskScheduler::TaskDeque::Array* TaskScheduler::TaskDeque::grow(Array* old, atomic_t b, atomic_t t)
+  {
+    Array* a = new Array(2*(old->mask+1));
+    for (atomic_t i=t; i<b; i++) a->set(i,old->get(i));
+    retired.push_back(old);
+    COMPILER_BARRIER;
+    array = a;
+    return a;
+  }
+
+  void TaskScheduler::TaskDeque::push(Task* task)
+  {
+    const atomic_t b = bottom, t = top;
+    Array* a = array;
+    if (b-t > atomic_t(a->mask)) a = grow(a,b,t);
+    a->set(b,task);
+
+    /* stores are not reordered on x86, thus the task is visible before the new bottom */
+    COMPILER_BARRIER;
+    bottom = b+1;
+  }
+
+  Task* TaskScheduler::TaskDeque::pop()
   {
+    const atomic_t b = bottom-1;
+    Array* a = array;
+    bottom = b;
+
+    /* the new bottom has to be visible to stealers before top is read */
+    _mm_mfence();
+    const atomic_t t = top;
+    if (t > b) { bottom = b+1; return NULL; }
+
+    /* the last task goes to whoever advances top first */
+    Task* task = a->get(b);
+    if (t == b) {
+      if (atomic_cmpxchg(&top,t+1,t) != t) task = NULL;
+      bottom = b+1;
+    }
+    return task;
+  }
+
+  Task* TaskScheduler::TaskDeque::steal()
+  {
+    const atomic_t t = top;
+    COMPILER_BARRIER;
+    const atomic_t b = bottom;
+    if (t >= b) return NULL;
+
+    Task* task = array->get(t);
+    if (atomic_cmpxchg(&top,t+1,t) != t) return NULL;
+    return task;
+  }
+
+  TaskScheduler::TaskScheduler (size_t numThreads, bool persistent, AffinityPolicy affinity)
+    : persistent(persistent), jobs(0), sleepers(0), working(0), activeTasks(0)
+  {
+    /* spinning only pays off if every thread has its own hardware thread */
+    spins = numThreads <= size_t(getNumberOfLogicalThreads()) ? spinsBeforeSleep : 0;
     terminateThreads = false;
-    setAffinity(0);
+    setAffinity(getThreadAffinity(0,affinity));
+    for (size_t i=0; i<numThreads; i++) states.push_back(new ThreadState);
     barrier.init(numThreads);
     for (size_t i=0; i<numThreads-1; i++)
-      threads.push_back(createThread((thread_func)threadFunction,new Thread(i+1,this),4*1024*1024,int(i+1)));
+      threads.push_back(createThread((thread_func)threadFunction,new Thread(i+1,this),4*1024*1024,getThreadAffinity(i+1,affinity)));
     barrier.wait();
   }
 
   TaskScheduler::~TaskScheduler()
   {
-    if (threads.size() == 0) return;
-    terminateThreads = true;
-    barrier.wait();
-    for (size_t i=0; i<threads.size(); i++) join(threads[i]);
-    threads.clear();
-    terminateThreads = false;
+    if (threads.size()) {
+      terminateThreads = true;
+      if (persistent) wakeWorkers();
+      else barrier.wait();
+      for (size_t i=0; i<threads.size(); i++) join(threads[i]);
+      threads.clear();
+      terminateThreads = false;
+    }
+
+    for (size_t i=0; i<states.size(); i++) {
+      for (size_t j=0; j<states[i]->pool.size(); j++) delete states[i]->pool[j];
+      delete states[i];
+    }
+    states.clear();
   }
 
   void TaskScheduler::addTask(Task::runFunction run, void* runData, size_t elts, Task::completeFunction complete, void* completeData)
   {
-    Task* task = new Task(run,runData,elts,complete,completeData);
+    if (elts == 0) return;
+    ThreadState* state = states[threadIndex];
+
+    Task* task = NULL;
+    if (state->pool.size()) {
+      task = state->pool.back();
+      state->pool.pop_back();
+      task->init(run,runData,elts,complete,completeData);
+    }
+    else task = new Task(run,runData,elts,complete,completeData);
+
     activeTasks++;
-    taskMutex.lock();
-    if (numTasks >= MAX_TASKS) throw std::runtime_error("too many tasks generated");
-    tasks[numTasks++] = task;
-    taskMutex.unlock();
+    state->deque.push(task);
   }
 
-  void TaskScheduler::go() {
+  void TaskScheduler::go()
+  {
+    if (persistent)
+    {
+      working = atomic_t(threads.size());
+      wakeWorkers();
+      run(0);
+
+      /* no worker may still look for tasks when go returns */
+      size_t failures = 0;
+      while (working) {
+        if (++failures < spinsBeforeYield) _mm_pause();
+        else yield();
+      }
+      return;
+    }
     barrier.wait();
     run(0);
     barrier.wait();
   }
 
+  void TaskScheduler::wakeWorkers()
+  {
+    jobs = jobs+1;
+
+    /* the new job has to be visible before sleepers is read, pairs with the increment in waitForJob */
+    _mm_mfence();
+    if (sleepers) futexWakeAll(&jobs);
+  }
+
+  void TaskScheduler::waitForJob(int32 job)
+  {
+    for (size_t i=0; i<spins; i++) {
+      if (jobs != job) return;
+      _mm_pause();
+    }
+
+    atomic_add(&sleepers,1);
+    while (jobs == job) futexWait(&jobs,job);
+    atomic_add(&sleepers,-1);
+  }
+
+  Task* TaskScheduler::getTask(size_t tid, size_t& victim)
+  {
+    if (Task* task = states[tid]->deque.pop()) return task;
+
+    /* steal, starting at the thread that had work the last time */
+    const size_t numThreads = states.size();
+    for (size_t i=0; i<numThreads; i++) {
+      const size_t v = (victim+i) % numThreads;
+      if (v == tid) continue;
+      if (Task* task = states[v]->deque.steal()) { victim = v; return task; }
+    }
+    return NULL;
+  }
+
+  void TaskScheduler::execute(size_t tid, Task* task)
+  {
+    /* claim an element, the task stays available while further elements remain */
+    const atomic_t elt = --task->started;
+    if (elt > 0) states[tid]->deque.push(task);
+
+    /* run the task */
+    if (task->run)
+      task->run(tid,task->runData,size_t(elt));
+
+    /* complete the task */
+    if (--task->completed == 0) {
+      if (task->complete) task->complete(tid,task->completeData);
+      states[tid]->pool.push_back(task);
+      activeTasks--;
+    }
+  }
+
   void TaskScheduler::run(size_t tid)
   {
+    runningTasks = true;
+    size_t victim = tid+1, failures = 0;
     while (int32(activeTasks))
     {
-      Task* task = NULL;
-      size_t elt = 0;
-
-      taskMutex.lock();
-      if (int32(numTasks)) {
-        task = tasks[int32(numTasks)-1];
-        elt = --task->started;
-        if (elt == 0) numTasks--;
+      Task* task = getTask(tid,victim);
+      if (task) {
+        failures = 0;
+        execute(tid,task);
+        continue;
       }
-      taskMutex.unlock();
-      if (!task) continue;
-
-      /* run the task */
-      if (task->run)
-        task->run(tid,task->runData,elt);
-
-      /* complete the task */
-      if (--task->completed == 0) {
-        if (task->complete) task->complete(tid,task->completeData);
-        delete task;
-        activeTasks--;
+
+      /* back off, spin shortly and then give the core to other threads */
+      if (++failures < spinsBeforeYield) _mm_pause();
+      else yield();
+    }
+    runningTasks = false;
+  }
+
+  void TaskScheduler::wait(Atomic& counter)
+  {
+    /* outside of tasks the threads wait at the barrier, go runs all tasks */
+    if (!runningTasks) {
+      go();
+      return;
+    }
+
+    /* help with other tasks until the awaited ones completed */
+    const size_t tid = threadIndex;
+    size_t victim = tid+1, failures = 0;
+    while (int32(counter))
+    {
+      Task* task = getTask(tid,victim);
+      if (task) {
+        failures = 0;
+        execute(tid,task);
+        continue;
       }
+      if (++failures < spinsBeforeYield) _mm_pause();
+      else yield();
     }
   }
 
@@ -97,17 +286,32 @@ namespace embree
       /* get thread ID */
       TaskScheduler* This = thread->scheduler;
       size_t tid = thread->tid;
+      threadIndex = tid;
       delete thread;
 
       /* flush to zero and no denormals */
       _mm_setcsr(_mm_getcsr() | /*FTZ:*/ (1<<15) | /*DAZ:*/ (1<<6));
 
       This->barrier.wait();
-      while (true) {
-        This->barrier.wait();
-        if (This->terminateThreads) break;
-        This->run(tid);
-        This->barrier.wait();
+
+      /* a persistent worker only runs tasks once go published a new job */
+      if (This->persistent) {
+        int32 job = This->jobs;
+        while (true) {
+          This->waitForJob(job);
+          job = This->jobs;
+          if (This->terminateThreads) break;
+          This->run(tid);
+          atomic_add(&This->working,-1);
+        }
+      }
+      else {
+        while (true) {
+          This->barrier.wait();
+          if (This->terminateThreads) break;
+          This->run(tid);
+          This->barrier.wait();
+        }
       }
     }
     catch (const std::exception& e) {
@@ -116,10 +320,10 @@ namespace embree
     }
   }
 
-  void TaskScheduler::init(int numThreads)
+  void TaskScheduler::init(int numThreads, bool persistent, AffinityPolicy affinity)
   {
-    if (numThreads < 0) scheduler = new TaskScheduler(getNumberOfLogicalThreads());
-    else scheduler = new TaskScheduler(numThreads);
+    if (numThreads < 0) scheduler = new TaskScheduler(getNumberOfLogicalThreads(),persistent,affinity);
+    else scheduler = new TaskScheduler(numThreads,persistent,affinity);
   }
 
   void TaskScheduler::cleanup()
@@ -132,4 +336,3 @@ namespace embree
 
   TaskScheduler* scheduler;
 }
-
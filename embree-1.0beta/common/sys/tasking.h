@@ -19,13 +19,13 @@
 
 #include "platform.h"
 #include "thread.h"
+#include "sysinfo.h"
 #include "sync/atomic.h"
 #include "sync/barrier.h"
+#include "sync/futex.h"
 
 #include <vector>
 
-#define MAX_TASKS 100000
-
 namespace embree
 {
   class Task
@@ -39,6 +39,13 @@ namespace embree
     __forceinline Task(runFunction run, void* runData, size_t elts, completeFunction complete, void* completeData)
       : run(run), runData(runData), complete(complete), completeData(completeData), started(elts), completed(elts) {}
 
+    /*! Reinitializes a pooled task. */
+    __forceinline void init(runFunction run, void* runData, size_t elts, completeFunction complete, void* completeData) {
+      this->run = run; this->runData = runData;
+      this->complete = complete; this->completeData = completeData;
+      started = elts; completed = elts;
+    }
+
   public:
     runFunction run;
     void* runData;
@@ -47,16 +54,86 @@ namespace embree
     Atomic started,completed;
   };
 
+  /*! Work stealing scheduler. Each thread owns a deque of tasks, it
+   *  pushes the tasks it creates to the bottom of its deque and pops
+   *  them from there in LIFO order. Threads without work steal the
+   *  oldest task from the top of the deque of another thread. A
+   *  task with several elements stays in exactly one deque until its
+   *  last element got claimed, a thread that claims an element
+   *  pushes the task back into its own deque before running the
+   *  element, thus the elements spread over the threads. Finished
+   *  tasks are kept in a per thread pool for reuse.
+   *
+   *  By default the worker threads meet the calling thread at a
+   *  barrier before and after each go. In persistent mode workers
+   *  stay in the scheduler between calls of go and wait for the next
+   *  job by spinning shortly and then sleeping on a futex. go bumps
+   *  the job counter and returns once all workers finished the job,
+   *  thus tasks added between two calls of go only run in the next
+   *  job, as in the default mode. */
   class TaskScheduler
   {
+    /*! Chase-Lev deque of tasks. Only the owning thread pushes and
+     *  pops, other threads steal. The deque grows on demand, retired
+     *  arrays are kept alive as stealers may still read them. */
+    class TaskDeque
+    {
+    public:
+      TaskDeque ();
+      ~TaskDeque ();
+
+      /*! Pushes a task to the bottom, called by the owner only. */
+      void push(Task* task);
+
+      /*! Pops a task from the bottom, called by the owner only. */
+      Task* pop();
+
+      /*! Steals a task from the top, called by other threads. */
+      Task* steal();
+
+    private:
+
+      /*! Circular array of tasks. */
+      struct Array {
+        Array (size_t size) : mask(size-1), tasks(new Task* volatile[size]) {}
+        ~Array () { delete[] tasks; }
+        __forceinline Task* get(atomic_t i) const { return tasks[size_t(i) & mask]; }
+        __forceinline void set(atomic_t i, Task* task) { tasks[size_t(i) & mask] = task; }
+      public:
+        size_t mask;               //!< Size of the array minus one, the size is a power of two.
+        Task* volatile* tasks;     //!< Slots of the array.
+      };
+
+      /*! Replaces the array with one of twice the size. */
+      Array* grow(Array* array, atomic_t bottom, atomic_t top);
+
+    private:
+      volatile atomic_t top;       //!< Index of the oldest task, advanced by stealers.
+      char align0[64];             //!< Keeps top and bottom in different cache lines.
+      volatile atomic_t bottom;    //!< Index after the newest task, changed by the owner.
+      Array* volatile array;       //!< Current array.
+      std::vector<Array*> retired; //!< Arrays replaced by growing.
+    };
+
+    /*! State of a thread of the scheduler. */
+    struct ThreadState {
+      TaskDeque deque;             //!< Tasks of the thread.
+      std::vector<Task*> pool;     //!< Finished tasks for reuse.
+    };
+
     volatile bool terminateThreads;
     std::vector<thread_t> threads;
     Barrier barrier;
 
+    /* persistent mode */
+    bool persistent;                 //!< Workers wait for jobs instead of meeting at the barrier.
+    volatile int32 jobs;             //!< Counts calls of go, workers wait for it to change.
+    volatile atomic_t sleepers;      //!< Number of workers sleeping on the job counter.
+    volatile atomic_t working;       //!< Number of workers that did not finish the current job.
+    size_t spins;                    //!< Iterations an idle worker spins before it sleeps.
+
     /* workqueue */
-    MutexSys taskMutex;
-    Atomic numTasks;
-    class Task* tasks[MAX_TASKS];
+    std::vector<ThreadState*> states;
     Atomic activeTasks;
 
     struct Thread {
@@ -66,21 +143,68 @@ namespace embree
     };
 
   public:
-    TaskScheduler (size_t numThreads);
+    TaskScheduler (size_t numThreads, bool persistent = false, AffinityPolicy affinity = AFFINITY_ONE_PER_CORE);
     ~TaskScheduler();
 
     void addTask(Task::runFunction run, void* runData, size_t elts = 1, Task::completeFunction complete = NULL, void* completeData = NULL);
     void go();
     void run(size_t tid);
+
+    /*! Runs tasks until the counter drops to zero. Inside a task the
+     *  calling thread helps with any available task while waiting,
+     *  outside of tasks this starts the scheduler like go. */
+    void wait(Atomic& counter);
     size_t getNumThreads() { return threads.size()+1; }
 
-    static void init(int numThreads = -1);
+    static void init(int numThreads = -1, bool persistent = false, AffinityPolicy affinity = AFFINITY_ONE_PER_CORE);
     static void cleanup();
     static void threadFunction(Thread* thread);
+
+  private:
+
+    /*! Takes a task of the own deque or steals one, returns NULL if there is none. */
+    Task* getTask(size_t tid, size_t& victim);
+
+    /*! Runs one element of a task taken out of a deque. */
+    void execute(size_t tid, Task* task);
+
+    /*! Starts the workers waiting for the next job in persistent mode. */
+    void wakeWorkers();
+
+    /*! Waits in persistent mode until the job counter differs from the given one. */
+    void waitForJob(int32 job);
   };
 
   extern TaskScheduler* scheduler;
+
+  /*! Group of tasks that can be waited for. Tasks get spawned into
+   *  the scheduler and sync returns once all of them completed. A
+   *  task can spawn and sync its own groups, which nests parallelism
+   *  into running tasks without hand written continuations. */
+  class TaskGroup
+  {
+  public:
+    TaskGroup () : pending(0) {}
+    ~TaskGroup () { sync(); }
+
+    /*! Adds a task of elts elements to the group. */
+    void spawn(Task::runFunction run, void* runData, size_t elts = 1) {
+      if (elts == 0) return;
+      pending++;
+      scheduler->addTask(run,runData,elts,(Task::completeFunction)&done,this);
+    }
+
+    /*! Waits until all spawned tasks completed. */
+    void sync() {
+      if (int32(pending)) scheduler->wait(pending);
+    }
+
+  private:
+    static void done(size_t tid, TaskGroup* This) { This->pending--; }
+
+  private:
+    Atomic pending;    //!< Number of spawned tasks that did not complete yet.
+  };
 }
 
 #endif
-
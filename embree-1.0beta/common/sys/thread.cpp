@@ -55,6 +55,13 @@ namespace embree
     if (affinity >= 0) SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1L << affinity));
   }
 
+  /*! allow the calling thread to run on all logical threads of the process */
+  void clearAffinity() {
+    DWORD_PTR processMask, systemMask;
+    if (GetProcessAffinityMask(GetCurrentProcess(),&processMask,&systemMask))
+      SetThreadAffinityMask(GetCurrentThread(), processMask);
+  }
+
   /*! the thread calling this function gets yielded */
   void yield() {
     Sleep(0);
@@ -105,8 +112,6 @@ namespace embree
   /*! set affinity of the calling thread */
   void setAffinity(int affinity)
   {
-    int wrap = getNumberOfLogicalThreads()/2;
-    affinity = (affinity/2) + wrap*(affinity%2);
     if (affinity >= 0 && affinity < 64*64) {
       uint64 mask[64];
       for (size_t i=0; i<64; i++) mask[i] = 0;
@@ -115,6 +120,15 @@ namespace embree
         std::cerr << "Thread: cannot set affinity" << std::endl;
     }
   }
+
+  /*! allow the calling thread to run on all logical threads, the kernel drops the ones outside the cpuset */
+  void clearAffinity()
+  {
+    uint64 mask[64];
+    for (size_t i=0; i<64; i++) mask[i] = uint64(-1);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(mask), (cpu_set_t*)mask) < 0)
+      std::cerr << "Thread: cannot clear affinity" << std::endl;
+  }
 }
 #endif
 
@@ -140,6 +154,15 @@ namespace embree
         std::cerr << "Thread: cannot set affinity" << std::endl;
     }
   }
+
+  /*! remove the affinity tag of the calling thread */
+  void clearAffinity()
+  {
+    thread_affinity_policy ap;
+    ap.affinity_tag = THREAD_AFFINITY_TAG_NULL;
+    if (thread_policy_set(mach_thread_self(),THREAD_AFFINITY_POLICY,(integer_t*)&ap,THREAD_AFFINITY_POLICY_COUNT) != KERN_SUCCESS)
+      std::cerr << "Thread: cannot clear affinity" << std::endl;
+  }
 }
 #endif
 
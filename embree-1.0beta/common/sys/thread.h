@@ -30,9 +30,12 @@ namespace embree
   /*! creates a hardware thread running on specific logical thread */
   thread_t createThread(thread_func f, void* arg, size_t stack_size = 0, int affinity = -1);
 
-  /*! set affinity of the calling thread */
+  /*! set affinity of the calling thread to a logical thread, see getThreadAffinity for placement policies */
   void setAffinity(int affinity);
 
+  /*! allow the calling thread to run on all logical threads again, e.g. after it inherited the affinity of its creator */
+  void clearAffinity();
+
   /*! the thread calling this function gets yielded */
   void yield();
 
@@ -16,6 +16,7 @@
 
 #include "default.h"
 #include "sys/tasking.h"
+#include "sys/parallel.h"
 #define RT_API_SYMBOL __dllexport
 
 /* include general stuff */
@@ -59,9 +60,11 @@
 /* include all renderers */
 #include "renderers/debugrenderer.h"
 #include "renderers/integratorrenderer.h"
+#include "renderers/wavefrontrenderer.h"
 
 /* include ray tracing core interface */
 #include "rtcore/rtcore.h"
+#include "rtcore/trace/trace_replay.h"
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -143,6 +146,11 @@ namespace embree
   static bool initialized = false;
   static MutexSys* mutex = new MutexSys;
 
+  /*! Guards the task scheduler. Ray queries do not hold the API
+   *  mutex during traversal, thus calls that use the scheduler
+   *  additionally hold this mutex. Always taken after the API mutex. */
+  static MutexSys* schedulerMutex = new MutexSys;
+
   /*******************************************************************
                  generic handle implementations
   *******************************************************************/
@@ -437,17 +445,17 @@ namespace embree
     if (!initialized) throw std::runtime_error("embree not initalized");
   }
 
-  RT_API_SYMBOL void rtInit() {
+  RT_API_SYMBOL void rtInit(int numThreads, bool persistent, const char* affinity) {
     Lock<MutexSys> lock(*mutex);
     if (initialized) throw std::runtime_error("embree already initialized");
-    TaskScheduler::init(1); std::cout << "Using only one thread !!!!!!!" << std::endl;
-    //TaskScheduler::init(2); std::cout << "Using only two threads !!!!!!!" << std::endl;
-    //TaskScheduler::init();
+    if (numThreads == 1) std::cout << "Using only one thread !!!!!!!" << std::endl;
+    TaskScheduler::init(numThreads,persistent,parseAffinityPolicy(affinity));
     initialized = true;
   }
 
   RT_API_SYMBOL void rtExit() {
     Lock<MutexSys> lock(*mutex);
+    Lock<MutexSys> schedulerLock(*schedulerMutex);
     verifyInitialized();
     TaskScheduler::cleanup();
     initialized = false;
@@ -563,9 +571,46 @@ namespace embree
     return (RTPrimitive) new PrimitiveHandle(light->instance,space);
   }
 
+  /*! Vertex positions of the triangle meshes. */
+  __forceinline const Vec3f& meshPosition(const TriangleMesh* mesh, uint32 i) { return mesh->position[i]; }
+  __forceinline const Vec3f& meshPosition(const TriangleMeshWithNormals* mesh, uint32 i) { return mesh->vertices[i].p; }
+  __forceinline const Vec3f& meshPosition(const TriangleMeshConsistentNormals* mesh, uint32 i) { return mesh->position[i]; }
+
+  /*! Converts a range of mesh triangles into build triangles. */
+  template<typename Mesh>
+    struct ExtractTriangles
+  {
+    ExtractTriangles (const Mesh* mesh, int id, BuildTriangle* triangles)
+      : mesh(mesh), id(id), triangles(triangles) {}
+
+    void operator() (size_t begin, size_t end) const {
+      for (size_t j=begin; j<end; j++) {
+        const typename Mesh::Triangle& tri = mesh->triangles[j];
+        triangles[j] = BuildTriangle(meshPosition(mesh,tri.v0),meshPosition(mesh,tri.v1),meshPosition(mesh,tri.v2),id,(int)j);
+      }
+    }
+
+  private:
+    const Mesh* mesh;           //!< Mesh to extract triangles from.
+    int id;                     //!< ID of the mesh instance.
+    BuildTriangle* triangles;   //!< Destination of the build triangles of the mesh.
+  };
+
+  /*! Appends the triangles of a mesh to the build triangles in parallel. */
+  template<typename Mesh>
+    void extractTriangles(vector_t<BuildTriangle>& triangles, const Mesh* mesh, int id)
+  {
+    const size_t N = mesh->triangles.size();
+    if (N == 0) return;
+    const size_t offset = triangles.size();
+    triangles.resize(offset+N,false);
+    parallel_for(0,N,4096,ExtractTriangles<Mesh>(mesh,id,triangles.begin()+offset));
+  }
+
   RT_API_SYMBOL RTScene rtNewScene(const char* type, TraceData traceFile, RTPrimitive* prims, size_t size)
   {
     Lock<MutexSys> lock(*mutex);
+    Lock<MutexSys> schedulerLock(*schedulerMutex);
     verifyInitialized();
 
     Ref<BackendScene> scene = new BackendScene;
@@ -584,28 +629,16 @@ namespace embree
         size_t id = scene->add(new Instance(i,shape,prim->material,null));
 
         /* extract triangle mesh */
-        if (Ref<TriangleMesh> mesh = shape.dynamicCast<TriangleMesh>()) {
-          for (size_t j=0; j<mesh->triangles.size(); j++) {
-            const TriangleMesh::Triangle& tri = mesh->triangles[j];
-            triangles.push_back(BuildTriangle(mesh->position[tri.v0],mesh->position[tri.v1],mesh->position[tri.v2],(int)id,(int)j));
-          }
-        }
+        if (Ref<TriangleMesh> mesh = shape.dynamicCast<TriangleMesh>())
+          extractTriangles(triangles,mesh.ptr,(int)id);
 
         /* extract triangle mesh with position and normals */
-        else if (Ref<TriangleMeshWithNormals> nmesh = shape.dynamicCast<TriangleMeshWithNormals>()) {
-          for (size_t j=0; j<nmesh->triangles.size(); j++) {
-            const TriangleMeshWithNormals::Triangle& tri = nmesh->triangles[j];
-            triangles.push_back(BuildTriangle(nmesh->vertices[tri.v0].p,nmesh->vertices[tri.v1].p,nmesh->vertices[tri.v2].p,(int)id,(int)j));
-          }
-        }
+        else if (Ref<TriangleMeshWithNormals> nmesh = shape.dynamicCast<TriangleMeshWithNormals>())
+          extractTriangles(triangles,nmesh.ptr,(int)id);
 
         /* extract consistent normal triangle mesh */
-        else if (Ref<TriangleMeshConsistentNormals> cmesh = shape.dynamicCast<TriangleMeshConsistentNormals>()) {
-          for (size_t j=0; j<cmesh->triangles.size(); j++) {
-            const TriangleMeshConsistentNormals::Triangle& tri = cmesh->triangles[j];
-            triangles.push_back(BuildTriangle(cmesh->position[tri.v0],cmesh->position[tri.v1],cmesh->position[tri.v2],(int)id,(int)j));
-          }
-        }
+        else if (Ref<TriangleMeshConsistentNormals> cmesh = shape.dynamicCast<TriangleMeshConsistentNormals>())
+          extractTriangles(triangles,cmesh.ptr,(int)id);
 
         /* extract single triangles */
         else if (Ref<Triangle> tri = prim->shape.dynamicCast<Triangle>()) {
@@ -642,6 +675,7 @@ namespace embree
       handle->set("integrator",Variant("pathtracer"));
       return (RTRenderer) handle;
     }
+    else if (!strcasecmp(type,"wavefront")) return (RTRenderer) new NormalHandle<WavefrontRenderer,Renderer>;
     else throw std::runtime_error("unknown renderer type: "+std::string(type));
   }
 
@@ -853,6 +887,7 @@ namespace embree
   RT_API_SYMBOL void rtRenderFrame(RTRenderer renderer_i, RTCamera camera_i, RTScene scene_i, RTFrameBuffer frameBuffer_i)
   {
     Lock<MutexSys> lock(*mutex);
+    Lock<MutexSys> schedulerLock(*schedulerMutex);
     verifyInitialized();
 
     /* extract objects from handles */
@@ -865,23 +900,130 @@ namespace embree
     renderer->instance->renderFrame(camera->instance,scene->instance,frameBuffer->instance);
   }
 
+  /*! Number of rays from which on ray queries are split across the task scheduler. */
+  static const size_t parallelRayQuerySize = 4096;
+
+  /*! Number of packets of 4 rays a task of a ray query traces. */
+  static const size_t rayQueryGrainSize = 256;
+
+  /*! Gathers packet i of 4 rays of a ray query, the rays behind the end of the query are invalid. */
+  static __forceinline sseb gatherRays(const RTRay* rays, size_t numRays, size_t i, Ray* ray)
+  {
+    const size_t num = min(numRays-4*i,size_t(4));
+    for (size_t j=0; j<num; j++) {
+      const RTRay& r = rays[4*i+j];
+      ray[j] = Ray(Vec3f(r.org.x,r.org.y,r.org.z),Vec3f(r.dir.x,r.dir.y,r.dir.z),r._near,r._far);
+    }
+    for (size_t j=num; j<4; j++) ray[j] = ray[0];
+    return sseb(num > 0,num > 1,num > 2,num > 3);
+  }
+
+  /*! Traces the packets [begin,end) of a rtTraceRays call. */
+  class TraceRays
+  {
+  public:
+    TraceRays (const RTRay* rays, const BackendScene* scene, RTHit* hits, size_t numRays)
+      : rays(rays), scene(scene), hits(hits), numRays(numRays) {}
+
+    void operator()(size_t begin, size_t end) const
+    {
+      for (size_t i=begin; i<end; i++)
+      {
+        Ray ray[4]; Hit hit[4];
+        const sseb valid = gatherRays(rays,numRays,i,ray);
+        scene->accel->intersect4(valid,ray,hit,0);
+
+        for (size_t j=0; j<4; j++) {
+          if (!valid[j]) continue;
+          RTHit& h = hits[4*i+j];
+          if (hit[j].id0 == -1) { h.prim = -1; h.dist = hit[j].t; }
+          else { h.prim = (int)scene->geometry[hit[j].id0]->id; h.dist = hit[j].t; }
+        }
+      }
+    }
+
+  private:
+    const RTRay* rays;
+    const BackendScene* scene;
+    RTHit* hits;
+    size_t numRays;
+  };
+
+  /*! Tests the packets [begin,end) of a rtOccludedRays call for occlusion. */
+  class OccludedRays
+  {
+  public:
+    OccludedRays (const RTRay* rays, const BackendScene* scene, bool* occluded, size_t numRays)
+      : rays(rays), scene(scene), occluded(occluded), numRays(numRays) {}
+
+    void operator()(size_t begin, size_t end) const
+    {
+      for (size_t i=begin; i<end; i++)
+      {
+        Ray ray[4];
+        const sseb valid = gatherRays(rays,numRays,i,ray);
+        const sseb hit = scene->accel->occluded4(valid,ray,0);
+        for (size_t j=0; j<4; j++)
+          if (valid[j]) occluded[4*i+j] = hit[j];
+      }
+    }
+
+  private:
+    const RTRay* rays;
+    const BackendScene* scene;
+    bool* occluded;
+    size_t numRays;
+  };
+
+  /*! Runs a ray query. Large queries are split across the task
+   *  scheduler, if another thread currently uses the scheduler the
+   *  query is answered on the calling thread instead of waiting. */
+  template<typename Query>
+  static void runRayQuery(const Query& query, size_t numRays)
+  {
+    const size_t numPackets = (numRays+3)/4;
+    if (numRays >= parallelRayQuerySize && schedulerMutex->try_lock()) {
+      parallel_for(0,numPackets,rayQueryGrainSize,query);
+      schedulerMutex->unlock();
+    }
+    else query(0,numPackets);
+  }
+
+  /*! Returns a reference to the scene of a handle, the reference
+   *  keeps the scene alive while rays are traced without holding the
+   *  API mutex. */
+  static Ref<BackendScene> acquireScene(RTScene scene_i)
+  {
+    Lock<MutexSys> lock(*mutex);
+    verifyInitialized();
+    return castHandle<ConstHandle<BackendScene> >(scene_i,"scene")->instance;
+  }
+
   RT_API_SYMBOL void rtTraceRays(const RTRay* rays, RTScene scene_i, RTHit* hits, size_t numRays)
+  {
+    Ref<BackendScene> scene = acquireScene(scene_i);
+    runRayQuery(TraceRays(rays,scene.ptr,hits,numRays),numRays);
+  }
+
+  RT_API_SYMBOL void rtOccludedRays(const RTRay* rays, RTScene scene_i, bool* occluded, size_t numRays)
+  {
+    Ref<BackendScene> scene = acquireScene(scene_i);
+    runRayQuery(OccludedRays(rays,scene.ptr,occluded,numRays),numRays);
+  }
+
+  RT_API_SYMBOL void rtReplayTrace(const char* fileName, RTScene scene_i, bool legacy)
   {
     Lock<MutexSys> lock(*mutex);
+    Lock<MutexSys> schedulerLock(*schedulerMutex);
     verifyInitialized();
 
     /* extract scene */
     ConstHandle<BackendScene>* scene = castHandle<ConstHandle<BackendScene> >(scene_i,"scene");
 
-    /* trace rays */
-    for (size_t i=0; i<numRays; i++)
-    {
-      const RTRay& r = rays[i];
-      Ray ray(Vec3f(r.org.x,r.org.y,r.org.z),Vec3f(r.dir.x,r.dir.y,r.dir.z),r._near,r._far);
-      Hit hit; scene->instance->accel->intersect(ray,hit,0);
-      if (hit.id0 == -1) { hits[i].prim = -1; hits[i].dist = hit.t; }
-      else { hits[i].prim = (int)scene->instance->geometry[hit.id0]->id; hits[i].dist = hit.t; }
-    }
+    /* replay all rays of the trace */
+    TraceReplay replay(scene->instance->accel,new TraceReader(fileName,legacy));
+    replay.run();
+    replay.print(std::cout);
   }
 
   RT_API_SYMBOL bool rtPick(float x, float y, Vec3f& p, RTCamera camera_i, RTScene scene_i)
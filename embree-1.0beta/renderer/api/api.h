@@ -106,8 +106,12 @@ namespace embree
                     initialization / cleanup
   *******************************************************************/
 
-  /*! Initialized the Embree library. */
-  RT_API_SYMBOL void rtInit();
+  /*! Initialized the Embree library. The task scheduler uses
+   *  numThreads threads, -1 for one per logical thread. Persistent
+   *  worker threads wait for the next job instead of meeting the
+   *  calling thread at a barrier. The affinity policy (compact,
+   *  scatter, core or none) places the threads on the cores. */
+  RT_API_SYMBOL void rtInit(int numThreads = 1, bool persistent = false, const char* affinity = "core");
 
   /*! Cleanup of the Embree library. */
   RT_API_SYMBOL void rtExit();
@@ -163,7 +167,7 @@ namespace embree
   RT_API_SYMBOL RTPrimitive rtNewLightPrimitive(RTLight light, float* transform = NULL);
 
   /*! Creates a new scene. \param type is the type of acceleration
-   *  structure of the scene (e.g. "bvh2", "bvh4", "bvh4.spatial")
+   *  structure of the scene (e.g. "bvh2", "bvh4", "bvh4.spatial", "bvh8")
    *  \param prims is a pointer to an array of primitives
    *  \param size is the number of primitives in that array \returns
    *  scene handle */
@@ -267,9 +271,25 @@ namespace embree
   /*! Traces rays. \param rays is an array of rays to trace \parm
    *  scene is the scene to trace the rays in \param hits is an array
    *  that is overwritten with the result \param numRays are the
-   *  number of rays to shoot */
+   *  number of rays to shoot. Large batches are traced in parallel.
+   *  Ray queries do not block other API calls during traversal, thus
+   *  a scene can be queried from several threads at once. */
   RT_API_SYMBOL void rtTraceRays(const RTRay* rays, RTScene scene, RTHit* hits, size_t numRays);
 
+  /*! Tests rays for occlusion. \param rays is an array of rays to
+   *  test \parm scene is the scene to test the rays against \param
+   *  occluded is an array that is overwritten with true for each
+   *  occluded ray and false otherwise \param numRays are the number
+   *  of rays to test */
+  RT_API_SYMBOL void rtOccludedRays(const RTRay* rays, RTScene scene, bool* occluded, size_t numRays);
+
+  /*! Shoots the rays of a recorded ray trace file again and prints
+   *  the achieved rays per second. \param fileName is the ray trace
+   *  file to replay \param scene is the scene to shoot the rays at
+   *  \param legacy reads version 1 files in the layout of the
+   *  original printer, with swapped AnyHit IDs and directions */
+  RT_API_SYMBOL void rtReplayTrace(const char* fileName, RTScene scene, bool legacy = false);
+
   /*! Pick a 3D point. \returns true if a point was picked, false otherwise
    *  \parm x is the x coordinate [0:1] in the image plane
    *  \parm y is the y coordinate [0:1] in the image plane
@@ -42,6 +42,13 @@ namespace embree
                      Sampler*                 sampler, /*!< Sampler used to generate (pseudo) random numbers. */
                      size_t&                  numRays,  /*!< Used to count the number of rays shot.            */
 					 int depth) = 0;
+
+    /*! Computes the radiance along a ray whose closest hit is already
+     *  known, e.g. as the renderer traced it in a packet. The default
+     *  implementation traces the ray again. */
+    virtual Col3f Li(const Ray& ray, const Hit& hit, const Ref<BackendScene>& scene, Sampler* sampler, size_t& numRays, int depth) {
+      return Li(ray,scene,sampler,numRays,depth);
+    }
   };
 }
 
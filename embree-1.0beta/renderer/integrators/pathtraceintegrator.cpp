@@ -41,7 +41,7 @@ namespace embree
     firstScatterTypeSampleID = samplerFactory->request1D((int)maxDepth);
   }
 
-  Col3f PathTraceIntegrator::Li(const LightPath& lightPath, const Ref<BackendScene>& scene, Sampler* sampler, size_t& numRays, int depth)
+  Col3f PathTraceIntegrator::Li(const LightPath& lightPath, const Ref<BackendScene>& scene, Sampler* sampler, size_t& numRays, int depth, const Hit* hit)
   {
     BRDFType directLightingBRDFTypes = (BRDFType)(DIFFUSE);
     BRDFType giBRDFTypes = (BRDFType)(ALL);
@@ -53,7 +53,8 @@ namespace embree
 
     /*! Traverse ray. */
     DifferentialGeometry dg;
-    scene->accel->intersect(lightPath.lastRay,dg,depth);
+    if (hit) static_cast<Hit&>(dg) = *hit;
+    else scene->accel->intersect(lightPath.lastRay,dg,depth);
     scene->postIntersect(lightPath.lastRay,dg);
     const Vec3f wo = -lightPath.lastRay.dir;
     numRays++;
@@ -157,5 +158,9 @@ namespace embree
   Col3f PathTraceIntegrator::Li(const Ray& ray, const Ref<BackendScene>& scene, Sampler* sampler, size_t& numRays, int depth) {
     return Li(LightPath(ray),scene,sampler,numRays, depth);
   }
+
+  Col3f PathTraceIntegrator::Li(const Ray& ray, const Hit& hit, const Ref<BackendScene>& scene, Sampler* sampler, size_t& numRays, int depth) {
+    return Li(LightPath(ray),scene,sampler,numRays, depth, &hit);
+  }
 }
 
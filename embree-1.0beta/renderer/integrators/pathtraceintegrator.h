@@ -63,12 +63,16 @@ namespace embree
     /*! Registers samples we need tom the sampler. */
     void requestSamples(Ref<SamplerFactory>& samplerFactory, const Ref<BackendScene>& scene);
 
-    /*! Function that is recursively called to compute the path. */
-    Col3f Li(const LightPath& lightPath, const Ref<BackendScene>& scene, Sampler* sampler, size_t& numRays, int depth);
+    /*! Function that is recursively called to compute the path. The
+     *  hit of the last ray is traced unless it is given. */
+    Col3f Li(const LightPath& lightPath, const Ref<BackendScene>& scene, Sampler* sampler, size_t& numRays, int depth, const Hit* hit = NULL);
 
     /*! Computes the radiance arriving at the origin of the ray from the ray direction. */
     Col3f Li(const Ray& ray, const Ref<BackendScene>& scene, Sampler* sampler, size_t& numRays, int depth);
 
+    /*! Computes the radiance along a ray whose closest hit is already known. */
+    Col3f Li(const Ray& ray, const Hit& hit, const Ref<BackendScene>& scene, Sampler* sampler, size_t& numRays, int depth);
+
     /* Configuration. */
   private:
     size_t maxDepth;               //!< Maximal recursion depth (1=primary ray only)
@@ -26,6 +26,9 @@
 #include "filters/boxfilter.h"
 #include "filters/bsplinefilter.h"
 
+/* rays are attributed to pixels in ray traces */
+#include "rtcore/trace/ray_context.h"
+
 namespace embree
 {
   IntegratorRenderer::IntegratorRenderer(const Parms& parms)
@@ -73,17 +76,37 @@ namespace embree
       sampler->init(Vec2i((int)film->width, (int)film->height), start, end, iteration);
       if (!accumulate) film->clear(start,end);
 
-      /*! process all tile samples */
-      while (!sampler->finished()) {
-        Vec2f rasterPos = sampler->proceed();
-        Ray primary; camera->ray(rasterPos*Vec2f(rcpWidth,rcpHeight), sampler->getLens(), primary);
-        Col3f L = integrator->Li(primary, scene, sampler, numRays, 0);
-        if (!finite(L.r+L.g+L.b) || L.r < 0 || L.g < 0 || L.b < 0) L = zero;
-        film->accumulate(sampler->getIntegerRaster(), start, end, L, 1.0f);
+      /*! process the tile samples in groups of 4, whose coherent primary rays are traced as one packet */
+      while (!sampler->finished())
+      {
+        PrecomputedSample samples[4]; int sampleIndices[4];
+        Ray primary[4]; Hit hits[4]; RayContext contexts[4];
+        size_t num = 0;
+        for (; num<4 && !sampler->finished(); num++) {
+          Vec2f rasterPos = sampler->proceed();
+          samples[num] = sampler->getSample();
+          sampleIndices[num] = sampler->getSampleIndex();
+          contexts[num] = RayContext(samples[num].integerRaster.x,samples[num].integerRaster.y,sampleIndices[num]);
+          camera->ray(rasterPos*Vec2f(rcpWidth,rcpHeight), sampler->getLens(), primary[num]);
+        }
+        setRayContext4(contexts);
+        scene->accel->intersect4(sseb(num > 0, num > 1, num > 2, num > 3), primary, hits, 0);
+
+        /*! shade the samples one by one, the sampler has to return the values of each sample again */
+        for (size_t i=0; i<num; i++) {
+          sampler->setSample(samples[i],sampleIndices[i]);
+          setRayContext(contexts[i]);
+          Col3f L = integrator->Li(primary[i], hits[i], scene, sampler, numRays, 0);
+          if (!finite(L.r+L.g+L.b) || L.r < 0 || L.g < 0 || L.b < 0) L = zero;
+          film->accumulate(samples[i].integerRaster, start, end, L, 1.0f);
+        }
       }
       film->normalize(start,end);
     }
 
+    /*! rays shot later by this thread do not belong to the frame */
+    setRayContext(RayContext());
+
     /*! we access the atomic ray counter only once per tile */
     atomicNumRays += numRays;
     delete sampler;
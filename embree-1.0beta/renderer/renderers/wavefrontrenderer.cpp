@@ -0,0 +1,399 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "renderers/wavefrontrenderer.h"
+#include <algorithm>
+
+/* include all image filters */
+#include "filters/boxfilter.h"
+#include "filters/bsplinefilter.h"
+
+/* rays are attributed to pixels in ray traces */
+#include "rtcore/trace/ray_context.h"
+
+namespace embree
+{
+  void WavefrontRenderer::RayQueue::clear()
+  {
+    orgx.clear(); orgy.clear(); orgz.clear();
+    dirx.clear(); diry.clear(); dirz.clear();
+    tnear.clear(); tfar.clear();
+  }
+
+  void WavefrontRenderer::RayQueue::push_back(const Ray& ray)
+  {
+    orgx.push_back(ray.org.x); orgy.push_back(ray.org.y); orgz.push_back(ray.org.z);
+    dirx.push_back(ray.dir.x); diry.push_back(ray.dir.y); dirz.push_back(ray.dir.z);
+    tnear.push_back(ray.near); tfar.push_back(ray.far);
+  }
+
+  RayStreamSoA WavefrontRenderer::RayQueue::stream() const
+  {
+    RayStreamSoA rays;
+    if (size() == 0) return rays;
+    rays.orgx = &orgx[0]; rays.orgy = &orgy[0]; rays.orgz = &orgz[0];
+    rays.dirx = &dirx[0]; rays.diry = &diry[0]; rays.dirz = &dirz[0];
+    rays.tnear = &tnear[0]; rays.tfar = &tfar[0];
+    return rays;
+  }
+
+  void WavefrontRenderer::HitQueue::resize(size_t n)
+  {
+    id0.resize(n); id1.resize(n);
+    u.resize(n); v.resize(n); t.resize(n);
+  }
+
+  HitStreamSoA WavefrontRenderer::HitQueue::stream()
+  {
+    HitStreamSoA hits;
+    if (t.size() == 0) return hits;
+    hits.id0 = &id0[0]; hits.id1 = &id1[0];
+    hits.u = &u[0]; hits.v = &v[0]; hits.t = &t[0];
+    return hits;
+  }
+
+  WavefrontRenderer::WavefrontRenderer(const Parms& parms)
+    : lightSampleID(-1), firstScatterSampleID(-1), firstScatterTypeSampleID(-1)
+  {
+    /*! path tracing configuration, same as for the PathTraceIntegrator */
+    maxDepth        = parms.getInt  ("maxDepth"       ,10    );
+    minContribution = parms.getFloat("minContribution",0.01f );
+    epsilon         = parms.getFloat("epsilon"        ,128.0f)*float(ulp);
+    backplate       = parms.getImage("backplate");
+
+    /*! create sampler to use */
+    std::string _samplers = parms.getString("sampler","multijittered");
+    if (_samplers == "multijittered"   ) samplers = new SamplerFactory(parms);
+    else throw std::runtime_error("unknown sampler type: "+_samplers);
+
+    /*! create pixel filter to use */
+    std::string _filter = parms.getString("filter","bspline");
+    if      (_filter == "none"   ) filter = NULL;
+    else if (_filter == "box"    ) filter = new BoxFilter;
+    else if (_filter == "bspline") filter = new BSplineFilter;
+    else throw std::runtime_error("unknown filter type: "+_filter);
+
+    /*! get framebuffer configuration */
+    accumulate = parms.getBool("accumulate",false);
+    gamma = parms.getFloat("gamma",1.0f);
+  }
+
+  void WavefrontRenderer::requestSamples(const Ref<BackendScene>& scene)
+  {
+    precomputedLightSampleID.resize(scene->allLights.size());
+
+    lightSampleID = samplers->request2D();
+    for (size_t i=0; i<scene->allLights.size(); i++) {
+      precomputedLightSampleID[i] = -1;
+      if (scene->allLights[i]->precompute())
+        precomputedLightSampleID[i] = samplers->requestLightSample(lightSampleID, scene->allLights[i]);
+    }
+    firstScatterSampleID = samplers->request2D((int)maxDepth);
+    firstScatterTypeSampleID = samplers->request1D((int)maxDepth);
+  }
+
+  /*! Orders hits by material. */
+  struct CompareMaterial {
+    __forceinline bool operator()(const std::pair<const Material*,size_t>& a, const std::pair<const Material*,size_t>& b) const {
+      return a.first < b.first || (a.first == b.first && a.second < b.second);
+    }
+  };
+
+  /*! Groups hits by material. Scenes mostly use few materials, thus
+   *  the groups are found by a linear search and filled by a counting
+   *  sort, with many materials we fall back to sorting. */
+  static void groupByMaterial(std::vector<std::pair<const Material*,size_t> >& order, std::vector<std::pair<const Material*,size_t> >& scratch)
+  {
+    enum { maxGroups = 16 };
+    const Material* groups[maxGroups];
+    size_t count[maxGroups];
+    size_t numGroups = 0;
+
+    /*! find groups and count their hits */
+    for (size_t i=0; i<order.size(); i++) {
+      size_t g = 0; while (g < numGroups && groups[g] != order[i].first) g++;
+      if (g == numGroups) {
+        if (numGroups == maxGroups) { std::sort(order.begin(),order.end(),CompareMaterial()); return; }
+        groups[numGroups] = order[i].first; count[numGroups++] = 0;
+      }
+      count[g]++;
+    }
+    if (numGroups <= 1) return;
+
+    /*! scatter the hits to their groups */
+    size_t start[maxGroups];
+    for (size_t g=0, s=0; g<numGroups; g++) { start[g] = s; s += count[g]; }
+    scratch.resize(order.size());
+    for (size_t i=0; i<order.size(); i++) {
+      size_t g = 0; while (groups[g] != order[i].first) g++;
+      scratch[start[g]++] = order[i];
+    }
+    order.swap(scratch);
+  }
+
+  bool WavefrontRenderer::shade(Path& path, size_t pathID, DifferentialGeometry& dg, const Vec2i& imageSize, Queues& queues)
+  {
+    BRDFType directLightingBRDFTypes = (BRDFType)(DIFFUSE);
+    BRDFType giBRDFTypes = (BRDFType)(ALL);
+    const Vec3f wo = -path.ray.dir;
+
+    /*! Environment shading when nothing hit. */
+    if (!dg)
+    {
+      Col3f L = zero;
+      if (backplate && path.unbend) {
+        Vec2f raster = path.sample.raster;
+        int x = (int)((raster.x / imageSize.x) * backplate->width);
+        x = clamp(x, 0, int(backplate->width)-1);
+        int y = (int)((raster.y / imageSize.y) * backplate->height);
+        y = clamp(y, 0, int(backplate->height)-1);
+        L = backplate->get(x, y);
+      }
+      else {
+        if (!path.ignoreVisibleLights)
+          for (size_t i=0; i<scene->envLights.size(); i++)
+            L += scene->envLights[i]->Le(wo);
+      }
+      path.L += path.weight * L;
+      return false;
+    }
+
+    /*! Shade surface. */
+    CompositedBRDF brdfs;
+    if (dg.material) dg.material->shade(path.ray, path.medium, dg, brdfs);
+
+    /*! face forward normals */
+    bool backfacing = false;
+#if defined(__EMBREE_CONSISTENT_NORMALS__) && __EMBREE_CONSISTENT_NORMALS__ > 1
+    path.L += path.weight * Col3f(abs(dg.Ns.x),abs(dg.Ns.y),abs(dg.Ns.z));
+    return false;
+#else
+    if (dot(dg.Ng, path.ray.dir) > 0) {
+      backfacing = true; dg.Ng = -dg.Ng; dg.Ns = -dg.Ns;
+    }
+#endif
+
+    /*! Add light emitted by hit area light source. */
+    if (!path.ignoreVisibleLights && dg.light && !backfacing)
+      path.L += path.weight * dg.light->Le(dg,wo);
+
+    /*! Check if any BRDF component uses direct lighting. */
+    bool useDirectLighting = false;
+    for (size_t i=0; i<brdfs.size(); i++)
+      useDirectLighting |= (brdfs[i]->type & directLightingBRDFTypes) != NONE;
+
+    /*! Direct lighting. Queue shadow rays to all light sources, together with the radiance they contribute if unoccluded. */
+    if (useDirectLighting)
+    {
+      for (size_t i=0; i<scene->allLights.size(); i++)
+      {
+        /*! Either use precomputed samples for the light or sample light now. */
+        LightSample ls;
+        if (scene->allLights[i]->precompute()) ls = path.sample.lightSamples[precomputedLightSampleID[i]];
+        else ls.L = scene->allLights[i]->sample(dg, ls.wi, ls.tMax, path.sample.samples2D[lightSampleID]);
+
+        /*! Ignore zero radiance or illumination from the back. */
+        if (ls.L == Col3f(zero) || ls.wi.pdf == 0.0f || dot(dg.Ns,Vec3f(ls.wi)) <= 0.0f) continue;
+
+        /*! Evaluate BRDF. */
+        const Col3f L = path.weight * ls.L * brdfs.eval(wo, dg, ls.wi, directLightingBRDFTypes) * rcp(ls.wi.pdf);
+        queues.shadowRays.push_back(Ray(dg.P, ls.wi, dg.error*epsilon, ls.tMax-dg.error*epsilon));
+        queues.shadowContribs.push_back(std::pair<size_t,Col3f>(pathID,L));
+      }
+    }
+
+    /*! Global illumination. Pick one BRDF component and sample it. */
+    Sample3f wi; BRDFType type;
+    Vec2f s  = path.sample.samples2D[firstScatterSampleID     + path.depth];
+    float ss = path.sample.samples1D[firstScatterTypeSampleID + path.depth];
+    Col3f c = brdfs.sample(wo, dg, wi, type, s, ss, giBRDFTypes);
+
+    /*! Continue only if we hit something valid. */
+    if (c == Col3f(zero) || wi.pdf <= 0.0f)
+      return false;
+
+    /*! Compute  simple volumetric effect. */
+    const Col3f& transmission = path.medium.transmission;
+    if (transmission != Col3f(one)) c *= pow(transmission,dg.t);
+
+    /*! Tracking medium if we hit a medium interface. */
+    if (type & TRANSMISSION) path.medium = dg.material->nextMedium(path.medium);
+
+    /*! Continue the path. */
+    const Ray nextRay(dg.P, wi, dg.error*epsilon, inf);
+    path.unbend = path.unbend && (nextRay.dir == path.ray.dir);
+    path.ray = nextRay;
+    path.depth++;
+    path.throughput *= c;
+    path.weight *= c * rcp(wi.pdf);
+    path.ignoreVisibleLights = (type & directLightingBRDFTypes) != NONE;
+    return true;
+  }
+
+  void WavefrontRenderer::renderTile(Queues& queues, const Vec2i& imageSize, size_t& numRays)
+  {
+    /*! all paths start active */
+    queues.active.resize(queues.paths.size());
+    for (size_t i=0; i<queues.paths.size(); i++) queues.active[i] = i;
+
+    for (int depth=0; !queues.active.empty(); depth++)
+    {
+      /*! Terminate paths that are too long or whose contribution is too low. */
+      size_t numActive = 0;
+      for (size_t i=0; i<queues.active.size(); i++) {
+        const Path& path = queues.paths[queues.active[i]];
+        if (path.depth >= maxDepth || reduce_max(path.throughput) < minContribution) continue;
+        queues.active[numActive++] = queues.active[i];
+      }
+      queues.active.resize(numActive);
+      if (numActive == 0) break;
+
+      /*! Extension stage. Trace the next rays of all active paths as one stream. */
+      queues.extensionRays.clear();
+      for (size_t i=0; i<numActive; i++) queues.extensionRays.push_back(queues.paths[queues.active[i]].ray);
+      queues.extensionHits.resize(numActive);
+      HitStreamSoA hits = queues.extensionHits.stream();
+      scene->accel->intersectN(queues.extensionRays.stream(),hits,numActive,depth);
+      numRays += numActive;
+
+      /*! Complete the hits and group them by material, such that paths with the same material get shaded together. */
+      queues.dgs.resize(numActive);
+      queues.order.resize(numActive);
+      for (size_t i=0; i<numActive; i++) {
+        Path& path = queues.paths[queues.active[i]];
+        DifferentialGeometry& dg = queues.dgs[i];
+        dg = DifferentialGeometry();
+        (Hit&)dg = queues.extensionHits.get(i);
+        scene->postIntersect(path.ray,dg);
+        queues.order[i] = std::pair<const Material*,size_t>(dg ? dg.material : NULL,i);
+      }
+      groupByMaterial(queues.order,queues.scratch);
+
+      /*! Shading stage. Queue shadow rays and the next extension rays. */
+      queues.shadowRays.clear();
+      queues.shadowContribs.clear();
+      size_t numContinued = 0;
+      for (size_t i=0; i<numActive; i++) {
+        const size_t j = queues.order[i].second;
+        const size_t pathID = queues.active[j];
+        if (shade(queues.paths[pathID],pathID,queues.dgs[j],imageSize,queues))
+          queues.order[numContinued++].second = pathID;
+      }
+
+      /*! Shadow stage. Trace all shadow rays as one stream and add the radiance of the unoccluded ones. */
+      const size_t numShadowRays = queues.shadowRays.size();
+      if (numShadowRays)
+      {
+        queues.occluded.resize(numShadowRays);
+        scene->accel->occludedN(queues.shadowRays.stream(),queues.occluded.begin(),numShadowRays,depth+1);
+        numRays += numShadowRays;
+        for (size_t i=0; i<numShadowRays; i++)
+          if (!queues.occluded[i]) queues.paths[queues.shadowContribs[i].first].L += queues.shadowContribs[i].second;
+      }
+
+      /*! continue with the paths that sampled a new ray */
+      queues.active.resize(numContinued);
+      for (size_t i=0; i<numContinued; i++) queues.active[i] = queues.order[i].second;
+    }
+  }
+
+  void WavefrontRenderer::renderThread()
+  {
+    /*! create a new sampler */
+    size_t numRays = 0;
+    Sampler* sampler = samplers->create();
+    Queues queues;
+
+    /*! rays are traced in streams, thus they cannot be attributed to single pixels */
+    setRayContext(RayContext());
+
+    /*! tile pick loop */
+    while (true)
+    {
+      /*! pick a new tile */
+      index_t tile = tileID++;
+      if (tile >= numTiles) break;
+
+      /*! compute tile pixel range */
+      Vec2i start((int(tile)%numTilesX)*TILE_SIZE_X,(int(tile)/numTilesX)*TILE_SIZE_Y);
+      Vec2i end (min(int(film->width),start.x+TILE_SIZE_X)-1,min(int(film->height),start.y+TILE_SIZE_Y)-1);
+
+      /*! configure the sampler with the tile pixels */
+      sampler->init(Vec2i((int)film->width, (int)film->height), start, end, iteration);
+      if (!accumulate) film->clear(start,end);
+
+      /*! generate the primary rays of all tile samples */
+      queues.paths.clear();
+      while (!sampler->finished()) {
+        Vec2f rasterPos = sampler->proceed();
+        Ray primary; camera->ray(rasterPos*Vec2f(rcpWidth,rcpHeight), sampler->getLens(), primary);
+        queues.paths.push_back(Path(primary,sampler->getSample()));
+      }
+
+      /*! trace all paths of the tile */
+      renderTile(queues,sampler->getImageSize(),numRays);
+
+      /*! accumulate the samples in the order they were generated */
+      for (size_t i=0; i<queues.paths.size(); i++) {
+        Col3f L = queues.paths[i].L;
+        if (!finite(L.r+L.g+L.b) || L.r < 0 || L.g < 0 || L.b < 0) L = zero;
+        film->accumulate(queues.paths[i].sample.integerRaster, start, end, L, 1.0f);
+      }
+      film->normalize(start,end);
+    }
+
+    /*! we access the atomic ray counter only once per tile */
+    atomicNumRays += numRays;
+    delete sampler;
+  }
+
+  void WavefrontRenderer::renderFrame(const Ref<Camera>& camera, const Ref<BackendScene>& scene, Ref<Film>& film)
+  {
+    /*! flush to zero and no denormals */
+    _mm_setcsr(_mm_getcsr() | /*FTZ:*/ (1<<15) | /*DAZ:*/ (1<<6));
+
+    /*! precompute some values */
+    numTilesX = ((int)film->width +TILE_SIZE_X-1)/TILE_SIZE_X;
+    numTilesY = ((int)film->height+TILE_SIZE_Y-1)/TILE_SIZE_Y;
+    numTiles = numTilesX * numTilesY;
+    rcpWidth  = 1.0f/float(film->width);
+    rcpHeight = 1.0f/float(film->height);
+    film->setGamma(gamma);
+    if (!accumulate) film->setIteration(0);
+    iteration = film->getIteration();
+
+    /*! render frame */
+    double t = getSeconds();
+    this->tileID = 0;
+    this->atomicNumRays = 0;
+    this->samplers->reset();
+    this->requestSamples(scene);
+    this->samplers->init(film->getIteration(), filter);
+    this->camera = camera;
+    this->scene = scene;
+    this->film = film;
+    scheduler->addTask((Task::runFunction)&run_renderThread,this,scheduler->getNumThreads());
+    scheduler->go();
+    film->incIteration();
+    this->camera = null;
+    this->scene = null;
+    this->film = null;
+    double dt = getSeconds()-t;
+
+    /*! print framerate */
+    std::cout << 1.0f/dt << " fps, " << dt*1000.0f << " ms, " << atomicNumRays/dt*1E-6 << " Mrps" << std::endl;
+  }
+}
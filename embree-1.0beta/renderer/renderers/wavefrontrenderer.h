@@ -0,0 +1,188 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#ifndef __EMBREE_WAVEFRONT_RENDERER_H__
+#define __EMBREE_WAVEFRONT_RENDERER_H__
+
+#include "renderers/renderer.h"
+#include "samplers/sampler.h"
+#include "filters/filter.h"
+#include "materials/material.h"
+#include "image/image.h"
+
+namespace embree
+{
+  /*! Wavefront path tracer. Computes the same estimator as the
+   *  PathTraceIntegrator, but instead of following one path at a time
+   *  the renderer keeps the paths of all samples of a tile in a queue
+   *  and advances them together in stages. The extension rays of all
+   *  paths are traced as one ray stream, the hits are sorted by
+   *  material and shaded, and the shadow rays generated by shading
+   *  are again traced as one stream. */
+  class WavefrontRenderer : public Renderer
+  {
+    /* tile configuration */
+    enum { TILE_SIZE_X = 16, TILE_SIZE_Y = 16 };
+
+    /*! Tracks the state of a path in the queue. */
+    class Path
+    {
+    public:
+
+      /*! Constructs a path for a sample from its primary ray. */
+      __forceinline Path (const Ray& ray, const PrecomputedSample& sample)
+        : ray(ray), medium(Medium::Vacuum()), depth(0), throughput(one), weight(one), L(zero),
+          ignoreVisibleLights(false), unbend(true), sample(sample) {}
+
+    public:
+      Ray ray;                     //!< Next ray of the path.
+      Medium medium;               //!< Medium the next ray travels inside.
+      uint32 depth;                //!< Number of rays traced so far.
+      Col3f throughput;            //!< Product of BRDF weights, decides about termination like in the PathTraceIntegrator.
+      Col3f weight;                //!< Product of BRDF weights divided by the sampling pdfs.
+      Col3f L;                     //!< Radiance gathered for the sample.
+      bool ignoreVisibleLights;    //!< Ignores the emission of geometrical lights that were sampled by shadow rays.
+      bool unbend;                 //!< True if the path is a straight line.
+      PrecomputedSample sample;    //!< Precomputed random numbers of the sample.
+    };
+
+    /*! Ray stream that owns its arrays. */
+    class RayQueue
+    {
+    public:
+
+      /*! Returns the number of queued rays. */
+      __forceinline size_t size() const { return tnear.size(); }
+
+      /*! Removes all rays. */
+      void clear();
+
+      /*! Appends a ray. */
+      void push_back(const Ray& ray);
+
+      /*! Returns the stream of the queued rays. */
+      RayStreamSoA stream() const;
+
+    private:
+      std::vector<float> orgx, orgy, orgz;   //!< Ray origins
+      std::vector<float> dirx, diry, dirz;   //!< Ray directions
+      std::vector<float> tnear, tfar;        //!< Ray segments
+    };
+
+    /*! Hit stream that owns its arrays. */
+    class HitQueue
+    {
+    public:
+
+      /*! Makes space for n hits. */
+      void resize(size_t n);
+
+      /*! Returns the stream of the hits. */
+      HitStreamSoA stream();
+
+      /*! Returns the i'th hit. */
+      __forceinline Hit get(size_t i) const {
+        Hit hit; hit.id0 = id0[i]; hit.id1 = id1[i]; hit.u = u[i]; hit.v = v[i]; hit.t = t[i];
+        return hit;
+      }
+
+    private:
+      std::vector<int> id0, id1;        //!< Primitive IDs
+      std::vector<float> u, v, t;       //!< Hit coordinates and distances
+    };
+
+    /*! Per thread queues, reused for all tiles the thread renders. */
+    class Queues
+    {
+    public:
+      std::vector<Path> paths;                  //!< Paths of all samples of the tile.
+      std::vector<size_t> active;               //!< Paths that trace another extension ray.
+      std::vector<DifferentialGeometry> dgs;    //!< Hits of the extension rays of the active paths.
+      std::vector<std::pair<const Material*,size_t> > order;    //!< Hits of the active paths grouped by material.
+      std::vector<std::pair<const Material*,size_t> > scratch;  //!< Temporary storage for grouping.
+      RayQueue extensionRays;                   //!< Extension rays of the active paths.
+      HitQueue extensionHits;                   //!< Hits of the extension rays.
+      RayQueue shadowRays;                      //!< Shadow rays generated by shading.
+      std::vector<std::pair<size_t,Col3f> > shadowContribs; //!< Path and radiance of each shadow ray if unoccluded.
+      vector_t<bool> occluded;                  //!< Occlusion of the shadow rays.
+    };
+
+  public:
+
+    /*! Construction from parameters. */
+    WavefrontRenderer (const Parms& parms);
+
+    /*! Renders a single frame. */
+    void renderFrame(const Ref<Camera>& camera, const Ref<BackendScene>& scene, Ref<Film>& film);
+
+  private:
+
+    /*! Render function called once for each thread and frame. */
+    void renderThread();
+    static void run_renderThread(size_t tid, WavefrontRenderer* This, size_t) { This->renderThread(); }
+
+    /*! Registers the samples the paths need at the sampler, same as the PathTraceIntegrator. */
+    void requestSamples(const Ref<BackendScene>& scene);
+
+    /*! Advances all paths of a tile until they terminated. */
+    void renderTile(Queues& queues, const Vec2i& imageSize, size_t& numRays);
+
+    /*! Shades the hit of a path, queues its shadow rays, and prepares
+     *  the next extension ray. Returns false if the path terminates. */
+    bool shade(Path& path, size_t pathID, DifferentialGeometry& dg, const Vec2i& imageSize, Queues& queues);
+
+    /*! Configuration */
+  private:
+    size_t maxDepth;               //!< Maximal recursion depth (1=primary ray only)
+    float minContribution;         //!< Minimal contribution of a path to the pixel.
+    float epsilon;                 //!< Epsilon to avoid self intersections.
+    Ref<Image> backplate;          //!< High resolution background.
+    bool accumulate;               //!< Whether to accumulate or overwrite the framebuffer.
+    float gamma;                   //!< Gamma to use for framebuffer writeback.
+
+  private:
+    Ref<SamplerFactory> samplers;  //!< Sampler to use.
+    Ref<Filter> filter;            //!< Pixel filter to use.
+
+    /*! Random variables. */
+  private:
+    int lightSampleID;            //!< 2D random variable to sample the light source.
+    int firstScatterSampleID;     //!< 2D random variable to sample the BRDF.
+    int firstScatterTypeSampleID; //!< 1D random variable to sample the BRDF type to choose.
+    std::vector<int> precomputedLightSampleID;  //!< ID of precomputed light samples for lights that need precomputations.
+
+    /*! Arguments of renderFrame function */
+  private:
+    Ref<Camera> camera;            //!< Camera to render from.
+    Ref<BackendScene> scene;       //!< Scene to render.
+    Ref<Film> film;                //!< Framebuffer to render into.
+
+    /*! Precomputations. */
+  private:
+    float rcpWidth;                //!< Reciprocal width of framebuffer.
+    float rcpHeight;               //!< Reciprocal height of framebuffer.
+    int numTiles;                  //!< Number of tiles of the framebuffer.
+    int numTilesX;                 //!< Number of tiles in x direction.
+    int numTilesY;                 //!< Number of tiles in y direction.
+    int iteration;                 //!< Accumulation iteration of framebuffer.
+
+  private:
+    Atomic tileID;                 //!< ID of current tile
+    Atomic atomicNumRays;          //!< for counting number of shoot rays
+  };
+}
+
+#endif
@@ -168,6 +168,7 @@ namespace embree
     sample.integerRaster = currentPixel;
     sample.raster.x = currentPixel.x + sample.pixel.x;
     sample.raster.y = currentPixel.y + sample.pixel.y;
+    sampleIndex = iteration*factory->samplesPerPixel + currentSample;
 
     ++currentSample;
     if (currentSample == factory->samplesPerPixel) {
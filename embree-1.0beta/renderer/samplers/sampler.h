@@ -69,6 +69,10 @@ namespace embree
     Vec2i getIntegerRaster()
     { return sample.integerRaster; }
 
+    /*! Get the index of the current sample in its pixel, counted over all iterations. */
+    int getSampleIndex()
+    { return sampleIndex; }
+
     /*! Get the current lens sample. */
     Vec2f getLens()
     { return sample.lens; }
@@ -85,6 +89,14 @@ namespace embree
     LightSample getLightSample(int lightSampleId)
     { return sample.lightSamples[lightSampleId]; }
 
+    /*! Get all precomputed values of the current sample. */
+    const PrecomputedSample& getSample() const
+    { return sample; }
+
+    /*! Make a sample returned by an earlier proceed the current one again. */
+    void setSample(const PrecomputedSample& sample, int sampleIndex)
+    { this->sample = sample; this->sampleIndex = sampleIndex; }
+
     /*! Has the tile been sampled completely? */
     bool finished() const
     { return done; }
@@ -114,6 +126,7 @@ namespace embree
     Vec2i currentPixel;           //!< Coordinates of the currently sampled pixel.
     int currentSample;            //!< Index of current sample in current pixel.
     int currentSet;               //!< Index of the precomputed sample set that is used for current pixel.
+    int sampleIndex;              //!< Index of the sample returned by the last proceed, counted over all iterations.
   };
 
   /*! The sampler factory precomputes samples for usage by multiple samlper threads. */
@@ -1,19 +1,23 @@
 #include "BVH2Printer.h"
+#include "bvh2/bvh2_importer.h"
+
+#include <algorithm>
+#include <cstdio>
 
 namespace embree{
 
 
   void BVH2Printer::printBVH2ToFile(Ref<BVH2<Triangle4> > bvh, FileName& bvhOutput)
   {
-      FILE* file = fopen(bvhOutput.c_str(), "wb");
-      printNode(bvh->root, Box(True), bvh, file);
+      // the nodes are written by the I/O thread of the writer while the traversal continues
+      Ref<AsyncWriter> out = new AsyncWriter(bvhOutput);
+      printNode(bvh->root, Box(True), bvh, *out.ptr);
       int end_sentinel = 9215;
-      fwrite(&end_sentinel,sizeof(int),1,file);
-      fclose(file);
+      out.ptr->write(&end_sentinel,sizeof(int));
   }
 
   
-  void BVH2Printer::printNode(int nodeNum, Box bbox, Ref<BVH2<Triangle4> > bvh, FILE* file)
+  void BVH2Printer::printNode(int nodeNum, Box bbox, Ref<BVH2<Triangle4> > bvh, AsyncWriter& out)
   {
       if(nodeNum >= 0)
       {
@@ -29,10 +33,10 @@ namespace embree{
         floats[4] = bbox.lower[2];
         floats[5] = bbox.upper[2];
         */
-        fwrite(&header,sizeof(int),1,file);
-        //fwrite(&floats,sizeof(float),6,file);
-        printNode(n.child[0], n.bounds(0), bvh, file);
-        printNode(n.child[1], n.bounds(1), bvh, file);
+        out.write(&header,sizeof(int));
+        //out.write(&floats,6*sizeof(float));
+        printNode(n.child[0], n.bounds(0), bvh, out);
+        printNode(n.child[1], n.bounds(1), bvh, out);
       }
       else
       {
@@ -42,44 +46,118 @@ namespace embree{
         const size_t ofs = size_t(leadID) >> 5;
         const size_t num = size_t(leadID) & 0x1F;
         
-        int totalTriangleCount = 0;
-        for (size_t i=ofs; i<ofs+num; i++) totalTriangleCount += bvh->triangles[i].size();
-        
-        int header[2];
-        header[0] = 1; //for leaf node
-        header[1] = totalTriangleCount;
-        float floats[9];
-        floats[0] = bbox.lower.v[0];
-        floats[1] = bbox.upper.v[0];
-        floats[2] = bbox.lower.v[1];
-        floats[3] = bbox.upper.v[1];
-        floats[4] = bbox.lower.v[2];
-        floats[5] = bbox.upper.v[2];
-        fwrite(&header,sizeof(int),2,file);
-        fwrite(&floats,sizeof(float),6,file);
+        printLeaf(bbox, &bvh->triangles[ofs], num, out);
+      }
+  }
 
-        //each triangle block could be up to 4 triangles
+  void BVH2Printer::printLeaf(const Box& bbox, const Triangle4* triangles, size_t num, AsyncWriter& out)
+  {
+      int totalTriangleCount = 0;
+      for (size_t i=0; i<num; i++) totalTriangleCount += triangles[i].size();
+      
+      int header[2];
+      header[0] = 1; //for leaf node
+      header[1] = totalTriangleCount;
+      float floats[9];
+      floats[0] = bbox.lower.v[0];
+      floats[1] = bbox.upper.v[0];
+      floats[2] = bbox.lower.v[1];
+      floats[3] = bbox.upper.v[1];
+      floats[4] = bbox.lower.v[2];
+      floats[5] = bbox.upper.v[2];
+      out.write(&header,2*sizeof(int));
+      out.write(&floats,6*sizeof(float));
+
+      //each triangle block could be up to 4 triangles
+      for (size_t i=0; i<num; i++)
+      {
+          Triangle4 t = triangles[i];
+          int size = t.size();
+          sse3f p1 = t.v0;
+          sse3f p2 = t.v0-t.e1;
+          sse3f p3 = t.v0+t.e2;
+          for(int j=0;j<size;j++)
+          {
+              floats[0] = p1.x.v[j];
+              floats[1] = p1.y.v[j];
+              floats[2] = p1.z.v[j];
+              floats[3] = p2.x.v[j];
+              floats[4] = p2.y.v[j];
+              floats[5] = p2.z.v[j];
+              floats[6] = p3.x.v[j];
+              floats[7] = p3.y.v[j];
+              floats[8] = p3.z.v[j];
+              out.write(&floats,9*sizeof(float));
+          }
+      }
+  }
+
+  static void printText(AsyncWriter& out, int value, char separator)
+  {
+      char str[16];
+      const int len = sprintf(str,"%d%c",value,separator);
+      out.write(str,len);
+  }
+
+  void BVH2Printer::printRNode(int nodeNum, const Ref<BVH2<Triangle4> >& bvh, const std::vector<TriangleRef>& refs, AsyncWriter& out)
+  {
+      if(nodeNum >= 0)
+      {
+        // BRANCH, the file stores no probabilities
+        const BVH2<Triangle4>::Node& n = bvh->node(nodeNum);
+        int kernel = BVH2Importer::frontToBack;
+        if (n.order != int32(BVH2<Triangle4>::closerFirst))
+          kernel = n.order == 0 ? BVH2Importer::leftFirst : BVH2Importer::rightFirst;
+        printText(out,BVH2Importer::branchID,' ');
+        printText(out,kernel,'\n');
+        printRNode(n.child[0], bvh, refs, out);
+        printRNode(n.child[1], bvh, refs, out);
+      }
+      else
+      {
+        // LEAF
+        int leafID = nodeNum ^ 0x80000000;
+        const size_t ofs = size_t(leafID) >> 5;
+        const size_t num = size_t(leafID) & 0x1F;
+
+        int totalTriangleCount = 0;
+        for (size_t i=ofs; i<ofs+num; i++) totalTriangleCount += bvh->triangles[i].size();
+        printText(out,BVH2Importer::leafID,' ');
+        printText(out,totalTriangleCount,totalTriangleCount ? ' ' : '\n');
+
+        int printed = 0;
         for (size_t i=ofs; i<ofs+num; i++)
         {
-            Triangle4 t = bvh->triangles[i];
-            int size = t.size();
-            sse3f p1 = t.v0;
-            sse3f p2 = t.v0-t.e1;
-            sse3f p3 = t.v0+t.e2;
-            for(int j=0;j<size;j++)
+            const Triangle4& t = bvh->triangles[i];
+            for (size_t j=0; j<t.size(); j++)
             {
-                floats[0] = p1.x.v[j];
-                floats[1] = p1.y.v[j];
-                floats[2] = p1.z.v[j];
-                floats[3] = p2.x.v[j];
-                floats[4] = p2.y.v[j];
-                floats[5] = p2.z.v[j];
-                floats[6] = p3.x.v[j];
-                floats[7] = p3.y.v[j];
-                floats[8] = p3.z.v[j];
-                fwrite(&floats,sizeof(float),9,file);
+                TriangleRef ref; ref.id0 = t.id0[j]; ref.id1 = t.id1[j];
+                std::vector<TriangleRef>::const_iterator found = std::lower_bound(refs.begin(),refs.end(),ref);
+                if (found == refs.end() || ref < *found)
+                    throw std::runtime_error("cannot print RBVH, a leaf holds an unknown triangle");
+                printText(out,found->index,++printed == totalTriangleCount ? '\n' : ' ');
             }
         }
-      }
-  }
+      }
+  }
+
+  void BVH2Printer::printRBVH2ToFile(Ref<BVH2<Triangle4> > bvh, const BuildTriangle* triangles, size_t numTriangles, FileName& bvhOutput)
+  {
+      // the leaves refer to the build triangles by their index, found through the triangle IDs
+      std::vector<TriangleRef> refs(numTriangles);
+      for (size_t i=0; i<numTriangles; i++) {
+          refs[i].id0 = triangles[i].id0;
+          refs[i].id1 = triangles[i].id1;
+          refs[i].index = int(i);
+      }
+      std::sort(refs.begin(),refs.end());
+      for (size_t i=1; i<numTriangles; i++)
+          if (!(refs[i-1] < refs[i])) throw std::runtime_error("cannot print RBVH, the triangle IDs are not unique");
+
+      Ref<AsyncWriter> out = new AsyncWriter(bvhOutput);
+      printText(*out.ptr,BVH2Importer::header,' ');
+      printText(*out.ptr,BVH2Importer::typeRBVH,'\n');
+      printRNode(bvh->root, bvh, refs, *out.ptr);
+      printText(*out.ptr,BVH2Importer::sentinel,'\n');
+  }
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 
 #include "bvh2/bvh2.h"
 #include "bvh4/triangle4.h"
+#include "trace/async_writer.h"
+
+#include <vector>
 
 namespace embree{
 
@@ -10,7 +13,23 @@ class BVH2Printer
 {
 public:
     static void printBVH2ToFile(Ref<BVH2<Triangle4> > bvh, FileName& bvhOutput);
-    static void printNode(int nodeNum, Box bbox, Ref<BVH2<Triangle4> > bvh, FILE* file);
+    static void printNode(int nodeNum, Box bbox, Ref<BVH2<Triangle4> > bvh, AsyncWriter& out);
+    // writes an explicit leaf (bounds plus triangles); shared with BVH4Printer
+    static void printLeaf(const Box& bbox, const Triangle4* triangles, size_t num, AsyncWriter& out);
+    // writes RBVHs in the text format the BVH2Importer reads: the traversal kernel of each
+    // branch (closer first branches use the front to back kernel) and the indices of the
+    // build triangles in the leaves
+    static void printRBVH2ToFile(Ref<BVH2<Triangle4> > bvh, const BuildTriangle* triangles, size_t numTriangles, FileName& bvhOutput);
+
+private:
+    // build triangle index of a pair of triangle IDs
+    struct TriangleRef
+    {
+        int id0, id1, index;
+        bool operator< (const TriangleRef& b) const { return id0 < b.id0 || (id0 == b.id0 && id1 < b.id1); }
+    };
+
+    static void printRNode(int nodeNum, const Ref<BVH2<Triangle4> >& bvh, const std::vector<TriangleRef>& refs, AsyncWriter& out);
 };
 
 }
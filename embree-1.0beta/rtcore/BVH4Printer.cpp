@@ -0,0 +1,53 @@
+#include "BVH4Printer.h"
+#include "BVH2Printer.h"
+
+namespace embree{
+
+
+  void BVH4Printer::printBVH4ToFile(Ref<BVH4<Triangle4> > bvh, FileName& bvhOutput)
+  {
+      Ref<AsyncWriter> out = new AsyncWriter(bvhOutput);
+      // header and 4-wide tree type, thus readers can tell BVH4 dumps from BVH2 dumps
+      int header[2] = { 267534, 203 };
+      out.ptr->write(&header,2*sizeof(int));
+      printNode(bvh->root, Box(True), bvh, *out.ptr);
+      int end_sentinel = 9215;
+      out.ptr->write(&end_sentinel,sizeof(int));
+  }
+
+
+  void BVH4Printer::printNode(int nodeNum, Box bbox, Ref<BVH4<Triangle4> > bvh, AsyncWriter& out)
+  {
+      if(nodeNum >= 0)
+      {
+        // BRANCH
+        const BVH4<Triangle4>::Node& n = bvh->node(nodeNum);
+
+        // empty slots of the node are not written
+        int header[2];
+        header[0] = 4; // for implicit 4-wide branch node
+        header[1] = 0;
+        for (int i=0; i<4; i++)
+            if (n.child[i] != int(BVH4<Triangle4>::emptyNode)) header[1]++;
+        out.write(&header,2*sizeof(int));
+
+        for (int i=0; i<4; i++)
+        {
+            if (n.child[i] == int(BVH4<Triangle4>::emptyNode)) continue;
+            Box childBounds(ssef(n.lower_x[i],n.lower_y[i],n.lower_z[i],0.0f),
+                            ssef(n.upper_x[i],n.upper_y[i],n.upper_z[i],0.0f));
+            printNode(n.child[i], childBounds, bvh, out);
+        }
+      }
+      else
+      {
+        // LEAF
+        int leafID = nodeNum ^ 0x80000000;
+
+        const size_t ofs = size_t(leafID) >> 5;
+        const size_t num = size_t(leafID) & 0x1F;
+
+        BVH2Printer::printLeaf(bbox, &bvh->triangles[ofs], num, out);
+      }
+  }
+}
@@ -0,0 +1,22 @@
+#ifndef __EMBREE_BVH4_PRINTER_H__
+#define __EMBREE_BVH4_PRINTER_H__
+
+#include "bvh4/bvh4.h"
+#include "bvh4/triangle4.h"
+#include "trace/async_writer.h"
+
+namespace embree{
+
+// Writes a BVH4 in the format of BVH2Printer. Branches become 4-wide
+// implicit branches (ID 4), leaves are written exactly as by BVH2Printer.
+class BVH4Printer
+{
+public:
+    static void printBVH4ToFile(Ref<BVH4<Triangle4> > bvh, FileName& bvhOutput);
+    static void printNode(int nodeNum, Box bbox, Ref<BVH4<Triangle4> > bvh, AsyncWriter& out);
+};
+
+}
+
+
+#endif
@@ -5,79 +5,58 @@ namespace embree{
 void PrintingTraverser::intersect(const Ray& ray, Hit& hit, int depth) const
 {
     subIntersector.ptr->intersect(ray,hit,depth);
-
-    int ints[2];
-    float floats[6];
-    if(hit) //they overrode boolean cast; how cute
-    {
-		ints[0] = 0;
-		ints[1] = depth;
-		floats[0] = ray.org.x;
-		floats[1] = ray.org.y;
-		floats[2] = ray.org.z;
-		floats[3] = ray.dir.x*hit.t;
-		floats[4] = ray.dir.y*hit.t;
-		floats[5] = ray.dir.z*hit.t;
-    }
-    else
-    {
-		ints[0] = 1;
-		ints[1] = depth;
-		floats[0] = ray.org.x;
-		floats[1] = ray.org.y;
-		floats[2] = ray.org.z;
-		floats[3] = ray.dir.x;
-		floats[4] = ray.dir.y;
-		floats[5] = ray.dir.z;
-    }
-    fwrite(&ints,sizeof(int),2,file);
-    fwrite(&floats,sizeof(float),6,file);
+    recordIntersect(ray,hit,depth,0);
 }
 
 bool PrintingTraverser::occluded (const Ray& ray, int depth) const
 {	
     bool res = subIntersector.ptr->occluded(ray, depth);
+    recordOccluded(ray,res,depth,0);
+    return res;
+}
 
-    int ints[2];
-    float floats[6];
-    if(res)
-    {
-		ints[0] = 3;
-		ints[1] = depth;
-		floats[0] = ray.org.x;
-		floats[1] = ray.org.y;
-		floats[2] = ray.org.z;
-		floats[3] = ray.dir.x;
-		floats[4] = ray.dir.y;
-		floats[5] = ray.dir.z;
-    }
-    else
-    {
-		ints[0] = 2;
-		ints[1] = depth;
-		floats[0] = ray.org.x;
-		floats[1] = ray.org.y;
-		floats[2] = ray.org.z;
-		floats[3] = ray.dir.x;
-		floats[4] = ray.dir.y;
-		floats[5] = ray.dir.z;
-    }
-    fwrite(&ints,sizeof(int),2,file);
-    fwrite(&floats,sizeof(float),6,file);
+// packets go to the packet path of the traverser; the rays are recorded in lane order
+void PrintingTraverser::intersect4(const sseb& valid, const Ray* rays, Hit* hits, int depth) const
+{
+    subIntersector.ptr->intersect4(valid,rays,hits,depth);
+    for (size_t i=0; i<4; i++)
+		if (valid[i]) recordIntersect(rays[i],hits[i],depth,i);
+}
+
+sseb PrintingTraverser::occluded4(const sseb& valid, const Ray* rays, int depth) const
+{
+    const sseb res = subIntersector.ptr->occluded4(valid,rays,depth);
+    for (size_t i=0; i<4; i++)
+		if (valid[i]) recordOccluded(rays[i],res[i] != 0,depth,i);
     return res;
 }
 
-PrintingTraverser::PrintingTraverser(const Ref<Intersector >& sub, const FileName& fileName) : subIntersector(sub)
+void PrintingTraverser::recordIntersect(const Ray& ray, Hit& hit, int depth, size_t lane) const
 {
-    file = fopen(fileName.c_str(), "wb");
-    if (!file) throw std::runtime_error("cannot open file " + fileName.str());
+    const TraceRecord record = hit //they overrode boolean cast; how cute
+		? TraceRecord(TraceRecord::FHIT, depth, ray.org, ray.dir*hit.t)
+		: TraceRecord(TraceRecord::FMIS, depth, ray.org, ray.dir);
+
+    // the extension and the ray context are only looked up if the writer stores them;
+    // misses keep the ids of the default Hit, i.e. -1
+    if (writer.ptr->extended())
+		writer.ptr->write(record, TraceRecordExt(getRayContext4(lane), hit.id0, hit.id1, ray.near, ray.far));
+    else
+		writer.ptr->write(record);
 }
 
-PrintingTraverser::~PrintingTraverser()
+void PrintingTraverser::recordOccluded(const Ray& ray, bool occluded, int depth, size_t lane) const
 {
-	int end_sentinel = 9215;
-    fwrite(&end_sentinel,sizeof(int),1,file);
-    fclose(file);
+    // the difference spans the tested segment; unbounded segments store the direction
+    Vec3f diff = ray.far < float(inf) ? ray.dir*ray.far : ray.dir;
+    const TraceRecord record(occluded ? TraceRecord::ABRK : TraceRecord::ACON, depth, ray.org, diff);
+    if (writer.ptr->extended())
+		writer.ptr->write(record, TraceRecordExt(getRayContext4(lane), -1, -1, ray.near, ray.far));
+    else
+		writer.ptr->write(record);
 }
 
-}
\ No newline at end of file
+PrintingTraverser::PrintingTraverser(const Ref<Intersector >& sub, const FileName& fileName, const std::string& format, const std::string& sampling)
+	: subIntersector(sub), writer(new TraceWriter(fileName, format, sampling)) {}
+
+}
@@ -1,8 +1,8 @@
-
 #ifndef __EMBREE_PRINTING_TRAVERSER_H__
 #define __EMBREE_PRINTING_TRAVERSER_H__
 
 #include "rtcore.h"
+#include "trace/trace_writer.h"
 
 namespace embree
 {
@@ -11,15 +11,20 @@ namespace embree
 		public Intersector
 	{
 	public:
-		PrintingTraverser(const Ref<Intersector >& sub, const FileName& file);
-		~PrintingTraverser();
+		PrintingTraverser(const Ref<Intersector >& sub, const FileName& file, const std::string& format = "v1", const std::string& sampling = "all");
 		void intersect(const Ray& ray, Hit& hit, int depth) const;
 		bool occluded (const Ray& ray, int depth) const;
+		void intersect4(const sseb& valid, const Ray* rays, Hit* hits, int depth) const;
+		sseb occluded4(const sseb& valid, const Ray* rays, int depth) const;
 	
 	private:
+		// writes the record of a ray, lane is the index of the ray in its packet
+		void recordIntersect(const Ray& ray, Hit& hit, int depth, size_t lane) const;
+		void recordOccluded(const Ray& ray, bool occluded, int depth, size_t lane) const;
+
 		Ref<Intersector> subIntersector;
-		FILE* file;
+		Ref<TraceWriter> writer;
 	};
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -19,6 +19,18 @@
 
 namespace embree
 {
+  /*! The destructor is not inline, such that objects compiled with AVX
+   *  do not carry their own copy of it. */
+  template<typename T>
+  BVH2<T>::~BVH2 ()
+  {
+    if (storage) return;
+    if (nodes) alignedFree(nodes);
+    nodes = NULL;
+    if (triangles) alignedFree(triangles);
+    triangles = NULL;
+  }
+
   template<typename T>
   int BVH2<T>::createLeaf(const Box* prims, const BuildTriangle* triangles_i, size_t nextTriangle, size_t start, size_t N)
   {
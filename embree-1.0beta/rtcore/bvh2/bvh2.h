@@ -28,7 +28,8 @@ namespace embree
    * byte offset of the child in the node array. If the topmost bit is
    * 1, the child is a leaf node. The lower 5 bits then determine the
    * number of primitives in the leaf, and the remaining bits the ID
-   * of the first primitive in the primitive array. */
+   * of the first primitive in the primitive array. Nodes of an RBVH
+   * additionally store which child occlusion rays visit first. */
 
   template<typename T>
     class BVH2 : public RefCount
@@ -36,9 +37,16 @@ namespace embree
     /*! Builders and traversers need direct access to the BVH structure. */
     friend class BVH2Builder;
     friend class BVH2BuilderSpatial;
+    friend class BVH2BuilderMorton;
+    friend class BVH2BuilderSRDH;
+    friend class BVH2Importer;
+    friend class BVH2Optimizer;
+    friend class BVH2Orderer;
     friend class BVH2ToBVH4;
+    friend class BVH2ToBVH8;
     friend class BVH2Traverser;
     friend class BVH2Printer;
+    friend class BVHCache;
 
   public:
 
@@ -52,7 +60,8 @@ namespace embree
       travCost     =  1,       //!< Cost of one traversal step.
       intCost      =  1,       //!< Cost of one primitive intersection.
       offsetFactor =  8,       //!< Factor to compute byte offset from offsets stored in nodes.
-      emptyNode = 0x80000000   //!< ID of an empty node.
+      emptyNode = 0x80000000,  //!< ID of an empty node.
+      closerFirst = 0x80000000 //!< Order of nodes whose closer child gets visited first.
     };
 
     /*! BVH2 Node. The nodes store for each dimension the lower and
@@ -67,7 +76,8 @@ namespace embree
       ssef lower_upper_y;     //!< left_lower_y, right_lower_y, left_upper_y, right_upper_y
       ssef lower_upper_z;     //!< left_lower_z, right_lower_z, left_upper_z, right_upper_z
       int32 child[2];         //!< Offset to both children.
-      int32 dummy[2];         //!< Padding to one cacheline (64 bytes)
+      int32 order;            //!< Child that occlusion rays visit first, or closerFirst to visit the closer child first.
+      float probability;      //!< Estimated probability that occlusion rays visiting both children find an occluder in the first one.
 
       /*! Clears the node. */
       __forceinline Node& clear()  {
@@ -75,10 +85,16 @@ namespace embree
         lower_upper_x = empty;
         lower_upper_y = empty;
         lower_upper_z = empty;
-        *(ssei*)child = (int)emptyNode;
+        *(ssei*)child = ssei((int)emptyNode,(int)emptyNode,(int)closerFirst,0);
         return *this;
       }
 
+      /*! Sets the child occlusion rays visit first (RBVH). */
+      __forceinline void setOrder(int32 first, float p) {
+        order = first;
+        probability = p;
+      }
+
       /*! Sets bounding box and ID of child. */
       __forceinline void set(size_t i, const Box& bounds, int32 childID) {
         lower_upper_x[i+0] = bounds.lower[0];
@@ -105,10 +121,7 @@ namespace embree
       modified(true), bvhSAH(0.0f), numNodes(0), numLeaves(0), numPrimBlocks(0), numPrims(0) {}
 
     /*! BVH2 destructor. */
-    ~BVH2 () {
-      if (nodes    ) alignedFree(nodes    ); nodes     = NULL;
-      if (triangles) alignedFree(triangles); triangles = NULL;
-    }
+    ~BVH2 ();
 
     /*! Compute the SAH cost of the BVH. */
     float getSAH()       { computeStatistics(); return bvhSAH; }
@@ -162,6 +175,7 @@ namespace embree
     size_t allocatedNodes;             //!< Number of allocated nodes.
     Triangle* triangles;               //!< Pointer to array of triangles.
     size_t allocatedTriangles;         //!< Number of allocated triangles.
+    Ref<RefCount> storage;             //!< Owner of nodes and triangles if the BVH did not allocate them.
 
     /*! Statistics about the BVH */
   private:
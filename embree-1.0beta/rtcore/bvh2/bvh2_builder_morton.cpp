@@ -0,0 +1,285 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "bvh2_builder_morton.h"
+#include "../common/compute_bounds.h"
+#include "sys/parallel.h"
+
+namespace embree
+{
+  Ref<BVH2<Triangle4> > BVH2BuilderMorton::build(const BuildTriangle* triangles, size_t numTriangles, size_t maxLeafTriangles)
+  {
+    Ref<BVH2<Triangle4> > bvh = new BVH2<Triangle4>;
+    double t0 = getSeconds();
+    BVH2BuilderMorton builder(triangles,numTriangles,maxLeafTriangles,bvh);
+    double t1 = getSeconds();
+    size_t bytesNodes = bvh->getNumNodes()*sizeof(BVH2<Triangle4>::Node);
+    size_t bytesTris = bvh->getNumPrimBlocks()*sizeof(BVH2<Triangle4>::Triangle);
+    std::cout <<
+      "triangles = " << numTriangles << ", " <<
+      "build time = " << (t1-t0)*1000.0f << "ms, " <<
+      "sah = " << bvh->getSAH() << ", " <<
+      "size = " << (bytesNodes+bytesTris)*1E-6 << " MB" << std::endl;
+    std::cout <<
+      "nodes = "  << bvh->getNumNodes()  << " (" << bytesNodes*1E-6 << " MB) (" << 100.0*(bvh->getNumNodes()-1+bvh->getNumLeaves())/(2.0*bvh->getNumNodes()     ) << "%), " <<
+      "leaves = " << bvh->getNumLeaves() << " (" << bytesTris*1E-6  << " MB) (" << 100.0*bvh->getNumPrims()                        /(4.0*bvh->getNumPrimBlocks()) << "%)" << std::endl;
+    return bvh;
+  }
+
+  BVH2BuilderMorton::BVH2BuilderMorton(const BuildTriangle* triangles, size_t numTriangles, size_t maxLeafTriangles, Ref<BVH2<Triangle4> > bvh)
+    : triangles(triangles), numTriangles(numTriangles), maxLeafTriangles(clamp(maxLeafTriangles,size_t(1),size_t(4*BVH2<Triangle4>::maxLeafSize))), numTopNodes(0), bvh(bvh)
+  {
+    if (numTriangles == 0) return;
+    size_t numThreads = scheduler->getNumThreads();
+
+    /*! Allocate storage for nodes. Each thread should at least be able to get one block. */
+    allocatedNodes = numTriangles+numThreads*allocBlockSize;
+    bvh->nodes = (BVH2<Triangle4>::Node*)alignedMalloc(allocatedNodes*sizeof(BVH2<Triangle4>::Node));
+
+    /*! Allocate storage for triangles. Each thread should at least be able to get one block. */
+    allocatedPrimitives = numTriangles+numThreads*allocBlockSize;
+    bvh->triangles      = (Triangle4*)alignedMalloc(allocatedPrimitives*sizeof(Triangle4));
+
+    /*! Allocate the boxes in input and in Morton order, and the two buffers of the radix sort. */
+    prims      = (Box*)alignedMalloc(2*numTriangles*sizeof(Box));
+    morton     = (MortonID*)alignedMalloc(numTriangles*sizeof(MortonID));
+    mortonTemp = (MortonID*)alignedMalloc(numTriangles*sizeof(MortonID));
+    numTasks   = numThreads;
+    radixCount = (size_t*)alignedMalloc(numTasks*radixBuckets*sizeof(size_t));
+
+    /*! The arrays are not first touched, the node and triangle arrays
+     *  are allocated for the worst case and touching all their pages
+     *  takes longer than the build. The tasks place the used pages
+     *  when they write them. */
+
+    /*! initiate parallel computation of bounds */
+    ComputeBoundsTask computeBounds(triangles,numTriangles,prims);
+    computeBounds.go();
+    centBounds = computeBounds.centBound;
+
+    /*! 30 bit codes resolve the centroids of most scenes, only very
+     *  large scenes use 63 bit codes which need twice the sort passes */
+    bitsPerAxis = numTriangles <= (1<<22) ? 10 : 21;
+    parallel_for(0,numTriangles,4096,ComputeCodes(this));
+    radixSort();
+    parallel_for(0,numTriangles,4096,Reorder(this));
+
+    /*! split the top of the tree and build the subtrees in parallel */
+    recurse(bvh->root,NULL,0,1,0,numTriangles);
+    numTopNodes = atomicNextNode;
+    scheduler->go();
+    if (bvh->root >= 0) refit(bvh->root);
+
+    /*! free temporary memory again */
+    bvh->nodes     = (BVH2<Triangle4>::Node*) alignedRealloc(bvh->nodes    ,atomicNextNode     *sizeof(BVH2<Triangle4>::Node));
+    bvh->triangles = (Triangle4*            ) alignedRealloc(bvh->triangles,atomicNextPrimitive*sizeof(Triangle4            ));
+    bvh->allocatedNodes     = atomicNextNode;
+    bvh->allocatedTriangles = atomicNextPrimitive;
+    alignedFree(radixCount); radixCount = NULL;
+    alignedFree(mortonTemp); mortonTemp = NULL;
+    alignedFree(morton); morton = NULL;
+    alignedFree(prims); prims = NULL;
+  }
+
+  /*! Spreads the lower 21 bits of x such that there are two zero bits between each bit. */
+  static __forceinline uint64 expandBits(uint64 x)
+  {
+    x &= 0x1fffffULL;
+    x = (x | x << 32) & 0x1f00000000ffffULL;
+    x = (x | x << 16) & 0x1f0000ff0000ffULL;
+    x = (x | x <<  8) & 0x100f00f00f00f00fULL;
+    x = (x | x <<  4) & 0x10c30c30c30c30c3ULL;
+    x = (x | x <<  2) & 0x1249249249249249ULL;
+    return x;
+  }
+
+  void BVH2BuilderMorton::ComputeCodes::operator() (size_t begin, size_t end) const
+  {
+    /*! map the centroid bounds to the grid, flat dimensions map to 0 */
+    const ssef cells = float((1 << parent->bitsPerAxis)-1);
+    const ssef extent = parent->centBounds.upper-parent->centBounds.lower;
+    const ssef scale = select(extent > ssef(zero),cells*rcp(extent),ssef(zero));
+
+    for (size_t i=begin; i<end; i++) {
+      const ssei cell = ssei(clamp((center2(parent->prims[i])-parent->centBounds.lower)*scale,ssef(zero),cells));
+      parent->morton[i].code = (expandBits(cell[0]) << 2) | (expandBits(cell[1]) << 1) | expandBits(cell[2]);
+      parent->morton[i].index = i;
+    }
+  }
+
+  void BVH2BuilderMorton::RadixCount::operator() (size_t begin, size_t end) const
+  {
+    for (size_t task=begin; task<end; task++)
+    {
+      size_t* count = &parent->radixCount[task*radixBuckets];
+      for (size_t i=0; i<radixBuckets; i++) count[i] = 0;
+      const size_t first = task*parent->numTriangles/parent->numTasks, last = (task+1)*parent->numTriangles/parent->numTasks;
+      for (size_t i=first; i<last; i++) count[(parent->morton[i].code >> shift) & (radixBuckets-1)]++;
+    }
+  }
+
+  void BVH2BuilderMorton::RadixScatter::operator() (size_t begin, size_t end) const
+  {
+    for (size_t task=begin; task<end; task++)
+    {
+      size_t* offset = &parent->radixCount[task*radixBuckets];
+      const size_t first = task*parent->numTriangles/parent->numTasks, last = (task+1)*parent->numTriangles/parent->numTasks;
+      for (size_t i=first; i<last; i++) {
+        const MortonID& m = parent->morton[i];
+        parent->mortonTemp[offset[(m.code >> shift) & (radixBuckets-1)]++] = m;
+      }
+    }
+  }
+
+  void BVH2BuilderMorton::radixSort()
+  {
+    /*! Each pass sorts by one digit, stable with respect to the
+     *  previous passes. A block of the input is handled per task and
+     *  every task scatters its elements to its own slice of each
+     *  bucket, thus the tasks do not have to synchronize. */
+    const size_t bits = 3*bitsPerAxis;
+    for (size_t shift=0; shift<bits; shift+=radixBits)
+    {
+      parallel_for(0,numTasks,1,RadixCount(this,shift));
+
+      /*! prefix sum over buckets and tasks, skip passes that put all codes into one bucket */
+      size_t offset = 0;
+      bool trivial = false;
+      for (size_t i=0; i<radixBuckets; i++) {
+        size_t bucket = 0;
+        for (size_t task=0; task<numTasks; task++) {
+          size_t count = radixCount[task*radixBuckets+i];
+          radixCount[task*radixBuckets+i] = offset+bucket;
+          bucket += count;
+        }
+        if (bucket == numTriangles) trivial = true;
+        offset += bucket;
+      }
+      if (trivial) continue;
+
+      parallel_for(0,numTasks,1,RadixScatter(this,shift));
+      std::swap(morton,mortonTemp);
+    }
+  }
+
+  void BVH2BuilderMorton::Reorder::operator() (size_t begin, size_t end) const
+  {
+    Box* sorted = parent->prims+parent->numTriangles;
+    for (size_t i=begin; i<end; i++) sorted[i] = parent->prims[parent->morton[i].index];
+  }
+
+  /*! Returns the index of the highest set bit. */
+  static __forceinline size_t highestBit(uint64 x) {
+    if (x >> 32) return 32+__bsr(int(x >> 32));
+    return __bsr(int(x));
+  }
+
+  size_t BVH2BuilderMorton::split(size_t begin, size_t end, size_t depth) const
+  {
+    /*! Split in the middle when all codes are equal, or when the
+     *  remaining depth would not suffice to reach small leaves with
+     *  middle splits. Otherwise split where the highest bit
+     *  that differs inside the range changes from 0 to 1. */
+    const uint64 first = morton[begin].code, last = morton[end-1].code;
+    size_t levels = 0; while ((maxLeafTriangles << levels) < end-begin) levels++;
+    if (first == last || depth+levels >= size_t(BVH2<Triangle4>::maxDepth))
+      return (begin+end)/2;
+
+    /*! binary search for the first code with the differing bit set */
+    const size_t bit = highestBit(first ^ last);
+    size_t lo = begin, hi = end-1;
+    while (lo+1 < hi) {
+      const size_t mid = (lo+hi)/2;
+      if ((morton[mid].code >> bit) & 1) hi = mid;
+      else lo = mid;
+    }
+    return hi;
+  }
+
+  void BVH2BuilderMorton::recurse(int& nodeID, BVH2<Triangle4>::Node* node, size_t slot, size_t depth, size_t begin, size_t end)
+  {
+    /*! use full single threaded build for small jobs */
+    if (end-begin < 4*1024) {
+      new BuildTask(this,nodeID,node,slot,depth,begin,end);
+      return;
+    }
+
+    /*! split large jobs in this thread, the bounds of the node get refitted after the build */
+    size_t center = split(begin,end,depth);
+    int id = (int)globalAllocNodes(1);
+    nodeID = BVH2<Triangle4>::id2offset(id);
+    BVH2<Triangle4>::Node& n = bvh->nodes[id].clear();
+    recurse(n.child[0],&n,0,depth+1,begin,center);
+    recurse(n.child[1],&n,1,depth+1,center,end);
+  }
+
+  Box BVH2BuilderMorton::refit(int nodeID)
+  {
+    BVH2<Triangle4>::Node& node = bvh->node(nodeID);
+    for (size_t i=0; i<2; i++) {
+      const int child = node.child[i];
+      if (child >= 0 && child < BVH2<Triangle4>::id2offset(int(numTopNodes)))
+        node.set(i,refit(child),child);
+    }
+    return merge(node.bounds(0),node.bounds(1));
+  }
+
+  /***********************************************************************************************************************
+   *                                         Full Recursive Build Task
+   **********************************************************************************************************************/
+
+  __forceinline BVH2BuilderMorton::BuildTask::BuildTask(BVH2BuilderMorton* parent, int& nodeID, BVH2<Triangle4>::Node* node, size_t slot, size_t depth, size_t begin, size_t end)
+    : parent(parent), tid(inf), nodeID(nodeID), node(node), slot(slot), depth(depth), begin(begin), end(end)
+  {
+    scheduler->addTask((Task::runFunction)&BuildTask::run,this);
+  }
+
+  void BVH2BuilderMorton::BuildTask::run(size_t tid, BuildTask* This, size_t elts)
+  {
+    This->tid = tid;
+    Box bounds;
+    int id = This->recurse(This->depth,This->begin,This->end,bounds);
+    This->parent->bvh->rotate(id,inf);
+    if (This->node) This->node->set(This->slot,bounds,id);
+    else This->nodeID = id;
+    delete This;
+  }
+
+  int BVH2BuilderMorton::BuildTask::recurse(size_t depth, size_t begin, size_t end, Box& bounds)
+  {
+    /*! make leaf node when the range is small enough or the maximal depth is reached */
+    size_t N = end-begin;
+    if (N <= parent->maxLeafTriangles || depth > BVH2<Triangle4>::maxDepth) {
+      const Box* sorted = parent->prims+parent->numTriangles;
+      bounds = empty;
+      for (size_t i=begin; i<end; i++) bounds = merge(bounds,sorted[i]);
+      return parent->bvh->createLeaf(sorted,parent->triangles,parent->threadAllocPrimitives(tid,blocks(N)),begin,N);
+    }
+
+    /*! create an inner node */
+    size_t center = parent->split(begin,end,depth);
+    Box lbounds, rbounds;
+    int nodeID = (int)parent->threadAllocNodes(tid,1);
+    int lchild = recurse(depth+1,begin,center,lbounds);
+    int rchild = recurse(depth+1,center,end,rbounds);
+    BVH2<Triangle4>::Node& node = parent->bvh->nodes[nodeID].clear();
+    node.set(0,lbounds,lchild);
+    node.set(1,rbounds,rchild);
+    bounds = merge(lbounds,rbounds);
+    return BVH2<Triangle4>::id2offset(nodeID);
+  }
+}
@@ -0,0 +1,140 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef __EMBREE_BVH2_BUILDER_MORTON_H__
+#define __EMBREE_BVH2_BUILDER_MORTON_H__
+
+#include "bvh2.h"
+#include "../bvh4/triangle4.h"
+#include "../common/builder.h"
+
+namespace embree
+{
+  /* Morton code (LBVH) builder for the BVH2. The builder quantizes
+   * the triangle centroids to a grid, sorts them along the Morton
+   * curve with a parallel radix sort and splits ranges of the sorted
+   * triangles at the highest differing bit of their codes. The
+   * hierarchy needs no SAH evaluation, thus the builder is much
+   * faster than the binned builders at the cost of a worse SAH. The
+   * top of the hierarchy is split in the calling thread, subtrees are
+   * built by parallel BuildTasks and the bounds of the top nodes are
+   * refitted afterwards. */
+
+  class BVH2BuilderMorton : private Builder
+  {
+  public:
+
+    /*! API entry function for the builder, ranges of up to maxLeafTriangles triangles become leaves */
+    static Ref<BVH2<Triangle4> > build(const BuildTriangle* triangles, size_t numTriangles, size_t maxLeafTriangles = 8);
+
+  public:
+
+    /*! Constructs the builder. */
+    BVH2BuilderMorton(const BuildTriangle* triangles, size_t numTriangles, size_t maxLeafTriangles, Ref<BVH2<Triangle4> > bvh);
+
+    /*! Morton code of a triangle together with the triangle ID. */
+    struct MortonID {
+      uint64 code;     //!< Morton code of the centroid.
+      size_t index;    //!< Index of the triangle.
+    };
+
+    /*! Computes the number of blocks of a number of triangles. */
+    static __forceinline size_t blocks(size_t x) { return (x+3)/4; }
+
+    /*! Sorts the Morton codes with a parallel LSD radix sort. */
+    void radixSort();
+
+    /*! Returns the index that splits the range [begin,end) of sorted triangles. */
+    size_t split(size_t begin, size_t end, size_t depth) const;
+
+    /*! Splits the top of the hierarchy and spawns build tasks for the subtrees. */
+    void recurse(int& nodeID, BVH2<Triangle4>::Node* node, size_t slot, size_t depth, size_t begin, size_t end);
+
+    /*! Computes the bounds of the top nodes after their subtrees got built. */
+    Box refit(int nodeID);
+
+    /*! Single-threaded task that builds a complete subtree. */
+    class BuildTask {
+      ALIGNED_CLASS
+    public:
+
+      /*! Default task construction. */
+      BuildTask(BVH2BuilderMorton* parent, int& nodeID, BVH2<Triangle4>::Node* node, size_t slot, size_t depth, size_t begin, size_t end);
+
+      /*! Task entry function. */
+      static void run(size_t tid, BuildTask* This, size_t elts);
+
+      /*! Recursively builds the subtree and returns its bounds. */
+      int recurse(size_t depth, size_t begin, size_t end, Box& bounds);
+
+    private:
+      BVH2BuilderMorton* parent;       //!< Pointer to parent task.
+      size_t tid;                      //!< Task ID for fast thread local storage.
+      int& nodeID;                     //!< Reference to output the node ID.
+      BVH2<Triangle4>::Node* node;     //!< Node to store the bounds of the subtree in, NULL for the root.
+      size_t slot;                     //!< Child slot of the subtree in that node.
+      size_t depth;                    //!< Recursion depth of the root of this subtree.
+      size_t begin, end;               //!< Range of sorted triangles of this subtree.
+    };
+
+    /*! Computes the Morton codes of a range of triangles. */
+    struct ComputeCodes {
+      ComputeCodes (BVH2BuilderMorton* parent) : parent(parent) {}
+      void operator() (size_t begin, size_t end) const;
+      BVH2BuilderMorton* parent;
+    };
+
+    /*! Counts the digits of the radix sort pass in the blocks of a range of tasks. */
+    struct RadixCount {
+      RadixCount (BVH2BuilderMorton* parent, size_t shift) : parent(parent), shift(shift) {}
+      void operator() (size_t begin, size_t end) const;
+      BVH2BuilderMorton* parent; size_t shift;
+    };
+
+    /*! Scatters the blocks of a range of tasks to the sorted locations of the radix sort pass. */
+    struct RadixScatter {
+      RadixScatter (BVH2BuilderMorton* parent, size_t shift) : parent(parent), shift(shift) {}
+      void operator() (size_t begin, size_t end) const;
+      BVH2BuilderMorton* parent; size_t shift;
+    };
+
+    /*! Reorders the primitive boxes along the Morton curve. */
+    struct Reorder {
+      Reorder (BVH2BuilderMorton* parent) : parent(parent) {}
+      void operator() (size_t begin, size_t end) const;
+      BVH2BuilderMorton* parent;
+    };
+
+  public:
+    enum { radixBits = 11, radixBuckets = 1 << radixBits };  //!< 3 passes sort 30 bit codes.
+
+    const BuildTriangle* triangles;     //!< Source triangle array
+    size_t numTriangles;                //!< Number of triangles
+    size_t maxLeafTriangles;            //!< Ranges up to this size become leaves.
+    Box* prims;                         //!< Primitive boxes, the first half in input order, the second half in Morton order.
+    Box centBounds;                     //!< Bounds of the doubled centroids.
+    size_t bitsPerAxis;                 //!< Bits of the Morton codes per axis, 10 or 21.
+    MortonID* morton;                   //!< Sorted Morton codes.
+    MortonID* mortonTemp;               //!< Second buffer of the radix sort.
+    size_t numTasks;                    //!< Number of blocks of the radix sort.
+    size_t* radixCount;                 //!< Digit counts, then scatter offsets, radixBuckets per block.
+    size_t numTopNodes;                 //!< Number of nodes created by the top level split.
+    Ref<BVH2<Triangle4> > bvh;          //!< BVH to overwrite
+  };
+}
+
+#endif
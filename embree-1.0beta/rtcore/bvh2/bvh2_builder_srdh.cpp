@@ -0,0 +1,517 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "bvh2_builder_srdh.h"
+#include "bvh2_builder.h"
+#include "../common/compute_bounds.h"
+#include "../trace/trace_reader.h"
+#include "../trace/trace_replay.h"
+#include "sys/parallel.h"
+
+namespace embree
+{
+  Ref<BVH2<Triangle4> > BVH2BuilderSRDH::build(const BuildTriangle* triangles, size_t numTriangles, const std::vector<ShadowRay>& rays)
+  {
+    Ref<BVH2<Triangle4> > bvh = new BVH2<Triangle4>;
+    double t0 = getSeconds();
+    BVH2BuilderSRDH builder(triangles,numTriangles,rays,bvh);
+    double t1 = getSeconds();
+    size_t bytesNodes = bvh->getNumNodes()*sizeof(BVH2<Triangle4>::Node);
+    size_t bytesTris = bvh->getNumPrimBlocks()*sizeof(BVH2<Triangle4>::Triangle);
+    std::cout <<
+      "triangles = " << numTriangles << ", " <<
+      "rays = " << rays.size() << ", " <<
+      "build time = " << (t1-t0)*1000.0f << "ms, " <<
+      "sah = " << bvh->getSAH() << ", " <<
+      "size = " << (bytesNodes+bytesTris)*1E-6 << " MB" << std::endl;
+    std::cout <<
+      "nodes = "  << bvh->getNumNodes()  << " (" << bytesNodes*1E-6 << " MB) (" << 100.0*(bvh->getNumNodes()-1+bvh->getNumLeaves())/(2.0*bvh->getNumNodes()     ) << "%), " <<
+      "leaves = " << bvh->getNumLeaves() << " (" << bytesTris*1E-6  << " MB) (" << 100.0*bvh->getNumPrims()                        /(4.0*bvh->getNumPrimBlocks()) << "%)" << std::endl;
+    return bvh;
+  }
+
+  void BVH2BuilderSRDH::loadRays(const FileName& fileName, std::vector<ShadowRay>& rays, size_t maxRays)
+  {
+    Ref<TraceReader> trace = new TraceReader(fileName);
+    std::vector<char> buffer;
+
+    /*! count the AnyHit records to compute the sampling stride */
+    size_t numAnyHit = 0;
+    for (size_t c=0; c<trace->numChunks(); c++) {
+      const TraceView view = trace->chunk(c,buffer);
+      for (size_t i=0; i<view.num; i++)
+        if (view.type[i] == TraceRecord::ABRK || view.type[i] == TraceRecord::ACON) numAnyHit++;
+    }
+    const size_t stride = max(size_t(1),(numAnyHit+maxRays-1)/max(size_t(1),maxRays));
+
+    /*! take every stride'th AnyHit record */
+    rays.clear();
+    size_t k = 0;
+    for (size_t c=0; c<trace->numChunks(); c++) {
+      const TraceView view = trace->chunk(c,buffer);
+      for (size_t i=0; i<view.num; i++) {
+        if (view.type[i] != TraceRecord::ABRK && view.type[i] != TraceRecord::ACON) continue;
+        if (k++ % stride != 0) continue;
+        const float weight = view.weighted() ? view.weight[i] : 1.0f;
+        rays.push_back(ShadowRay(TraceReplay::ray(view,i,128.0f*float(ulp)),float(stride)*weight,view.type[i] == TraceRecord::ABRK));
+      }
+    }
+    std::cout << "loaded " << rays.size() << " of " << numAnyHit << " AnyHit rays from " << fileName.str() << std::endl;
+  }
+
+  BVH2BuilderSRDH::BVH2BuilderSRDH(const BuildTriangle* triangles, size_t numTriangles, const std::vector<ShadowRay>& rays_i, Ref<BVH2<Triangle4> > bvh)
+    : triangles(triangles), numTriangles(numTriangles), prims(NULL), centers(NULL), side(NULL), rays(NULL), numRays(rays_i.size()), bvh(bvh)
+  {
+    size_t numThreads = scheduler->getNumThreads();
+
+    /*! Allocate storage for nodes. Each thread should at least be able to get one block. */
+    allocatedNodes = numTriangles+numThreads*allocBlockSize;
+    bvh->nodes = (BVH2<Triangle4>::Node*)alignedMalloc(allocatedNodes*sizeof(BVH2<Triangle4>::Node));
+
+    /*! Allocate storage for triangles. Each thread should at least be able to get one block. */
+    allocatedPrimitives = numTriangles+numThreads*allocBlockSize;
+    bvh->triangles      = (Triangle4*)alignedMalloc(allocatedPrimitives*sizeof(Triangle4));
+
+    /*! Allocate array for splitting primitive lists and the per triangle data. */
+    prims   = (Box*)alignedMalloc(numTriangles*sizeof(Box));
+    centers = (ssef*)alignedMalloc(numTriangles*sizeof(ssef));
+    side    = (unsigned char*)alignedMalloc(numTriangles*sizeof(unsigned char));
+
+    /*! spread the pages of the arrays over the NUMA nodes of the build threads */
+    firstTouch(bvh->nodes,allocatedNodes*sizeof(BVH2<Triangle4>::Node));
+    firstTouch(bvh->triangles,allocatedPrimitives*sizeof(Triangle4));
+    firstTouch(prims,numTriangles*sizeof(Box));
+
+    /*! initiate parallel computation of bounds */
+    ComputeBoundsTask computeBounds(triangles,numTriangles,prims);
+    computeBounds.go();
+    for (size_t i=0; i<numTriangles; i++) centers[i] = center2(prims[i]);
+
+    /*! find the occluders of the broken rays in a temporary BVH whose first IDs are the triangle indices */
+    rays = (SampleRay*)alignedMalloc(numRays*sizeof(SampleRay));
+    std::vector<int32> hits(max(size_t(1),numRays*maxOccluders));
+    Ref<BVH2<Triangle4> > temp = new BVH2<Triangle4>;
+    bool broken = false;
+    for (size_t i=0; i<numRays; i++) broken |= rays_i[i].broken;
+    if (broken) {
+      std::vector<BuildTriangle> indexed(triangles,triangles+numTriangles);
+      for (size_t i=0; i<numTriangles; i++) indexed[i].id0 = (int)i;
+      BVH2Builder builder(&indexed[0],numTriangles,temp);
+    }
+    parallel_for(0,numRays,256,FindOccluders(this,temp.ptr,rays_i,&hits[0]));
+    for (size_t i=0; i<numRays; i++) {
+      rays[i].firstOccluder = (int32)occluders.size();
+      occluders.insert(occluders.end(),hits.begin()+i*maxOccluders,hits.begin()+i*maxOccluders+rays[i].numOccluders);
+    }
+    temp = null;
+
+    /*! the root job holds all rays that reach the scene */
+    Job job(BuildRange(0,numTriangles,computeBounds.geomBound,computeBounds.centBound));
+    for (size_t i=0; i<numRays; i++) {
+      if (rays[i].numOccluders == 0 && entry(rays[i],job.geomBounds) == float(pos_inf)) continue;
+      job.rays.push_back(RayRef((int32)i,(int32)job.occluders.size(),rays[i].numOccluders));
+      job.occluders.insert(job.occluders.end(),occluders.begin()+rays[i].firstOccluder,occluders.begin()+rays[i].firstOccluder+rays[i].numOccluders);
+    }
+
+    /*! start build */
+    recurse(bvh->root,1,job);
+    scheduler->go();
+
+    /*! free temporary memory again */
+    bvh->nodes     = (BVH2<Triangle4>::Node*) alignedRealloc(bvh->nodes    ,atomicNextNode     *sizeof(BVH2<Triangle4>::Node));
+    bvh->triangles = (Triangle4*            ) alignedRealloc(bvh->triangles,atomicNextPrimitive*sizeof(Triangle4            ));
+    bvh->allocatedNodes     = atomicNextNode;
+    bvh->allocatedTriangles = atomicNextPrimitive;
+  }
+
+  BVH2BuilderSRDH::~BVH2BuilderSRDH()
+  {
+    alignedFree(prims);   prims = NULL;
+    alignedFree(centers); centers = NULL;
+    alignedFree(side);    side = NULL;
+    alignedFree(rays);    rays = NULL;
+  }
+
+  /***********************************************************************************************************************
+   *                                                Occluder Search
+   **********************************************************************************************************************/
+
+  void BVH2BuilderSRDH::FindOccluders::operator() (size_t begin, size_t end) const
+  {
+    for (size_t i=begin; i<end; i++)
+    {
+      const Ray& ray = rays[i].ray;
+      SampleRay& sample = parent->rays[i];
+      sample.org  = ssef(ray.org.x,ray.org.y,ray.org.z,0.0f);
+      sample.rdir = ssef(ray.rdir.x,ray.rdir.y,ray.rdir.z,0.0f);
+      sample.near = ray.near;
+      sample.far  = ray.far;
+      sample.weight = rays[i].weight;
+      sample.firstOccluder = 0;
+      sample.numOccluders = rays[i].broken ? (int32)intersectAll(bvh,ray,occluders+i*maxOccluders) : 0;
+    }
+  }
+
+  size_t BVH2BuilderSRDH::intersectAll(BVH2<Triangle4>* bvh, const Ray& ray, int32* occluders)
+  {
+    const ssef org (ray.org.x ,ray.org.y ,ray.org.z ,0.0f);
+    const ssef rdir(ray.rdir.x,ray.rdir.y,ray.rdir.z,0.0f);
+    int stack[1+BVH2<Triangle4>::maxDepth];
+    int stackPtr = 0;
+    int cur = bvh->root;
+    size_t num = 0;
+
+    while (true)
+    {
+      /*! descend into all children the segment intersects */
+      while (cur >= 0) {
+        BVH2<Triangle4>::Node& node = bvh->node(cur);
+        const bool hit0 = embree::entry(org,rdir,ray.near,ray.far,node.bounds(0)) != float(pos_inf);
+        const bool hit1 = embree::entry(org,rdir,ray.near,ray.far,node.bounds(1)) != float(pos_inf);
+        if      (hit0 && hit1) { stack[stackPtr++] = node.child[1]; cur = node.child[0]; }
+        else if (hit0        ) cur = node.child[0];
+        else if (hit1        ) cur = node.child[1];
+        else goto pop_node;
+      }
+
+      /*! collect the indices of all intersected triangles of the leaf */
+      {
+        cur ^= 0x80000000;
+        const size_t ofs = size_t(cur) >> 5;
+        const size_t numBlocks = size_t(cur) & 0x1F;
+        for (size_t i=ofs; i<ofs+numBlocks; i++) {
+          const Triangle4& tri = bvh->triangles[i];
+          const int mask = movemask(tri.hits(ray));
+          for (size_t j=0; j<4; j++) {
+            if ((mask & (1 << j)) == 0) continue;
+            occluders[num++] = tri.id0[j];
+            if (num == maxOccluders) return num;
+          }
+        }
+      }
+
+pop_node:
+      if (stackPtr == 0) break;
+      cur = stack[--stackPtr];
+    }
+    return num;
+  }
+
+  /***********************************************************************************************************************
+   *                                                Split Selection
+   **********************************************************************************************************************/
+
+  BVH2BuilderSRDH::Binning::Binning(const BVH2BuilderSRDH* parent, const Job& job)
+  {
+    /*! compute number of bins to use and precompute scaling factor for binning */
+    numBins = min(size_t(maxBins),size_t(4.0f + 0.05f*job.size()));
+    centLower = job.centBounds.lower;
+    scale = rcp(embree::size(job.centBounds)) * ssef((float)numBins);
+    for (size_t d=0; d<3; d++) valid[d] = embree::size(job.centBounds)[d] > 0.0f;
+
+    /*! map geometry to bins */
+    Box binBounds[maxBins][3];
+    size_t binCount[maxBins][3];
+    for (size_t i=0; i<numBins; i++)
+      for (size_t d=0; d<3; d++) {
+        binBounds[i][d] = empty;
+        binCount[i][d] = 0;
+      }
+    for (size_t i=job.start(); i<job.end(); i++) {
+      const Box& prim = parent->prims[i];
+      const ssei bin = getBin(center2(prim));
+      for (size_t d=0; d<3; d++) {
+        binCount[bin[d]][d]++;
+        binBounds[bin[d]][d].grow(prim);
+      }
+    }
+
+    /*! sweep from left to right and from right to left to get the bounds of all partitionings */
+    for (size_t d=0; d<3; d++)
+    {
+      Box bounds = empty; size_t count = 0;
+      for (size_t i=1; i<numBins; i++) {
+        bounds.grow(binBounds[i-1][d]); count += binCount[i-1][d];
+        lBounds[d][i] = bounds; lBlocks[d][i] = blocks(count);
+      }
+      bounds = empty; count = 0;
+      for (size_t i=numBins-1; i>0; i--) {
+        bounds.grow(binBounds[i][d]); count += binCount[i][d];
+        rBounds[d][i] = bounds; rBlocks[d][i] = blocks(count);
+      }
+    }
+  }
+
+  BVH2BuilderSRDH::Visits::Visits() : weight(0.0f)
+  {
+    for (size_t d=0; d<3; d++)
+      for (size_t i=0; i<maxBins; i++)
+        left[d][i] = right[d][i] = 0.0f;
+  }
+
+  BVH2BuilderSRDH::Visits::Visits(const Visits& a, const Visits& b) : weight(a.weight+b.weight)
+  {
+    for (size_t d=0; d<3; d++)
+      for (size_t i=0; i<maxBins; i++) {
+        left [d][i] = a.left [d][i]+b.left [d][i];
+        right[d][i] = a.right[d][i]+b.right[d][i];
+      }
+  }
+
+  BVH2BuilderSRDH::Visits BVH2BuilderSRDH::CountVisits::operator() (size_t begin, size_t end) const
+  {
+    Visits visits;
+    for (size_t r=begin; r<end; r++)
+    {
+      const RayRef& ref = job.rays[r];
+      const SampleRay& ray = parent->rays[ref.ray];
+      visits.weight += ray.weight;
+
+      /*! bin range of the occluders inside the node, empty for connected rays */
+      ssei minBin = int(maxBins), maxBin = -1;
+      for (int32 i=0; i<ref.num; i++) {
+        const ssei bin = binning.getBin(parent->centers[job.occluders[ref.first+i]]);
+        minBin = min(minBin,bin);
+        maxBin = max(maxBin,bin);
+      }
+
+      for (size_t d=0; d<3; d++)
+      {
+        if (!binning.valid[d]) continue;
+        for (size_t i=1; i<binning.numBins; i++)
+        {
+          /*! a child holding an occluder is always hit, even if the box test misses due to rounding */
+          const bool occL = minBin[d] <  int(i);
+          const bool occR = maxBin[d] >= int(i);
+          float tL = entry(ray,binning.lBounds[d][i]); if (occL && tL == float(pos_inf)) tL = ray.near;
+          float tR = entry(ray,binning.rBounds[d][i]); if (occR && tR == float(pos_inf)) tR = ray.near;
+
+          /*! the closer child gets traversed first, an occluder in there ends the ray */
+          const bool hitL = tL != float(pos_inf), hitR = tR != float(pos_inf);
+          const bool leftFirst = hitL && (!hitR || tL < tR);
+          const bool rightFirst = hitR && !leftFirst;
+          if (hitL && !(rightFirst && occR)) visits.left [d][i] += ray.weight;
+          if (hitR && !(leftFirst  && occL)) visits.right[d][i] += ray.weight;
+        }
+      }
+    }
+    return visits;
+  }
+
+  void BVH2BuilderSRDH::findSplit(const Job& job, const Binning& binning, Split& split, bool parallel) const
+  {
+    /*! count the visits of the children of each partitioning */
+    const size_t numJobRays = job.rays.size();
+    Visits visits = parallel ?
+      parallel_reduce(0,numJobRays,1024,Visits(),CountVisits(this,job,binning),MergeVisits()) :
+      CountVisits(this,job,binning)(0,numJobRays);
+
+    /*! blend the ray and surface area estimates of the visit probabilities */
+    const float area = halfArea(job.geomBounds);
+    const float rayShare  = float(numJobRays)/float(numJobRays+priorRays);
+    const float areaShare = 1.0f-rayShare;
+    const float rayScale  = visits.weight > 0.0f ? rayShare/visits.weight : 0.0f;
+    const float areaScale = area > 0.0f ? (visits.weight > 0.0f ? areaShare : 1.0f)/area : 0.0f;
+
+    split.dim = -1; split.pos = 0; split.cost = inf;
+    split.leafCost = BVH2<Triangle4>::intCost*float(blocks(job.size()));
+    for (size_t d=0; d<3; d++)
+    {
+      if (!binning.valid[d]) continue;
+      for (size_t i=1; i<binning.numBins; i++)
+      {
+        if (binning.lBlocks[d][i] == 0 || binning.rBlocks[d][i] == 0) continue;
+        const float pL = rayScale*visits.left [d][i] + areaScale*halfArea(binning.lBounds[d][i]);
+        const float pR = rayScale*visits.right[d][i] + areaScale*halfArea(binning.rBounds[d][i]);
+        const float cost = BVH2<Triangle4>::travCost + BVH2<Triangle4>::intCost*(pL*float(binning.lBlocks[d][i]) + pR*float(binning.rBlocks[d][i]));
+        if (cost < split.cost) { split.dim = (int)d; split.pos = (int)i; split.cost = cost; }
+      }
+    }
+  }
+
+  /***********************************************************************************************************************
+   *                                                   Splitting
+   **********************************************************************************************************************/
+
+  void BVH2BuilderSRDH::split(const Job& job, const Binning& binning, const Split& split, Job& left, Job& right) const
+  {
+    const size_t N = job.size();
+    Box lgeomBounds = empty; Box lcentBounds = empty;
+    Box rgeomBounds = empty; Box rcentBounds = empty;
+
+    /*! partition the primitives at the split location */
+    index_t l = 0, r = N-1;
+    while (split.dim >= 0 && l <= r) {
+      Box prim = prims[job.start()+l];
+      ssef center = center2(prim);
+      if (binning.getBin(center)[split.dim] < split.pos) {
+        lgeomBounds.grow(prim);
+        lcentBounds.grow(center);
+        l++;
+      }
+      else {
+        rgeomBounds.grow(prim);
+        rcentBounds.grow(center);
+        std::swap(prims[job.start()+l],prims[job.start()+r]);
+        r--;
+      }
+    }
+    size_t numLeft = l;
+
+    /*! object median split if we did not make progress, can happen when all primitives have same centroid */
+    if (split.dim < 0 || numLeft == 0 || numLeft == N)
+    {
+      numLeft = N/2;
+      lgeomBounds = empty; lcentBounds = empty;
+      rgeomBounds = empty; rcentBounds = empty;
+      for (size_t i=0; i<numLeft; i++) {
+        lgeomBounds.grow(prims[job.start()+i]);
+        lcentBounds.grow(center2(prims[job.start()+i]));
+      }
+      for (size_t i=numLeft; i<N; i++) {
+        rgeomBounds.grow(prims[job.start()+i]);
+        rcentBounds.grow(center2(prims[job.start()+i]));
+      }
+    }
+    for (size_t i=0; i<N; i++) side[prims[job.start()+i].lower.i[3]] = i >= numLeft;
+    left  = Job(BuildRange(job.start()        ,numLeft  ,lgeomBounds,lcentBounds));
+    right = Job(BuildRange(job.start()+numLeft,N-numLeft,rgeomBounds,rcentBounds));
+
+    /*! pass the rays on to the children they visit, together with the occluders inside these children */
+    for (size_t k=0; k<job.rays.size(); k++)
+    {
+      const RayRef& ref = job.rays[k];
+      const SampleRay& ray = rays[ref.ray];
+      int32 numOccL = 0, numOccR = 0;
+      for (int32 i=0; i<ref.num; i++) {
+        if (side[job.occluders[ref.first+i]]) numOccR++;
+        else                                  numOccL++;
+      }
+      float tL = entry(ray,left .geomBounds); if (numOccL && tL == float(pos_inf)) tL = ray.near;
+      float tR = entry(ray,right.geomBounds); if (numOccR && tR == float(pos_inf)) tR = ray.near;
+      const bool hitL = tL != float(pos_inf), hitR = tR != float(pos_inf);
+      const bool leftFirst = hitL && (!hitR || tL < tR);
+      const bool rightFirst = hitR && !leftFirst;
+
+      if (hitL && !(rightFirst && numOccR)) {
+        left.rays.push_back(RayRef(ref.ray,(int32)left.occluders.size(),numOccL));
+        for (int32 i=0; i<ref.num; i++)
+          if (!side[job.occluders[ref.first+i]]) left.occluders.push_back(job.occluders[ref.first+i]);
+      }
+      if (hitR && !(leftFirst && numOccL)) {
+        right.rays.push_back(RayRef(ref.ray,(int32)right.occluders.size(),numOccR));
+        for (int32 i=0; i<ref.num; i++)
+          if (side[job.occluders[ref.first+i]]) right.occluders.push_back(job.occluders[ref.first+i]);
+      }
+    }
+  }
+
+  bool BVH2BuilderSRDH::splitJob(const Job& job, size_t depth, Job& left, Job& right, bool parallel) const
+  {
+    /*! make leaf node when threshold reached or the expected cost tells us */
+    const size_t N = job.size();
+    if (N <= 1 || depth > BVH2<Triangle4>::maxDepth) return false;
+    Binning binning(this,job);
+    Split best; findSplit(job,binning,best,parallel);
+    if (N <= BVH2<Triangle4>::maxLeafSize && best.leafCost < best.cost) return false;
+
+    /*! perform split */
+    split(job,binning,best,left,right);
+    return true;
+  }
+
+  void BVH2BuilderSRDH::recurse(int& nodeID, size_t depth, Job& job)
+  {
+    /*! use full single threaded build for small jobs */
+    if (job.size() < 4*1024) new BuildTask(this,nodeID,depth,job);
+
+    /*! use single theaded split task to create subjobs */
+    else new SplitTask(this,nodeID,depth,job);
+  }
+
+  /***********************************************************************************************************************
+   *                                         Full Recursive Build Task
+   **********************************************************************************************************************/
+
+  __forceinline BVH2BuilderSRDH::BuildTask::BuildTask(BVH2BuilderSRDH* parent, int& nodeID, size_t depth, Job& job_i)
+    : parent(parent), tid(inf), nodeID(nodeID), depth(depth), job((const BuildRange&)job_i)
+  {
+    job.rays.swap(job_i.rays);
+    job.occluders.swap(job_i.occluders);
+    scheduler->addTask((Task::runFunction)&BuildTask::run,this);
+  }
+
+  void BVH2BuilderSRDH::BuildTask::run(size_t tid, BuildTask* This, size_t elts)
+  {
+    This->tid = tid;
+    This->nodeID = This->recurse(This->depth,This->job);
+    delete This;
+  }
+
+  int BVH2BuilderSRDH::BuildTask::recurse(size_t depth, Job& job)
+  {
+    /*! create a leaf if the job should not get split */
+    size_t N = job.size();
+    Job left,right;
+    if (!parent->splitJob(job,depth,left,right,false))
+      return parent->bvh->createLeaf(parent->prims,parent->triangles,parent->threadAllocPrimitives(tid,blocks(N)),job.start(),N);
+
+    /*! the rays of the job are not needed anymore */
+    std::vector<RayRef>().swap(job.rays);
+    std::vector<int32>().swap(job.occluders);
+
+    /*! create an inner node */
+    int nodeID = (int)parent->threadAllocNodes(tid,1);
+    BVH2<Triangle4>::Node& node = parent->bvh->nodes[nodeID].clear();
+    node.set(0,left .geomBounds,recurse(depth+1,left ));
+    node.set(1,right.geomBounds,recurse(depth+1,right));
+    return BVH2<Triangle4>::id2offset(nodeID);
+  }
+
+  /***********************************************************************************************************************
+   *                                      Single Threaded Split Task
+   **********************************************************************************************************************/
+
+  __forceinline BVH2BuilderSRDH::SplitTask::SplitTask(BVH2BuilderSRDH* parent, int& nodeID, size_t depth, Job& job_i)
+    : parent(parent), nodeID(nodeID), depth(depth), job((const BuildRange&)job_i)
+  {
+    job.rays.swap(job_i.rays);
+    job.occluders.swap(job_i.occluders);
+    scheduler->addTask((Task::runFunction)_split,this);
+  }
+
+  void BVH2BuilderSRDH::SplitTask::split()
+  {
+    /*! create a leaf if the job should not get split */
+    size_t N = job.size();
+    Job left,right;
+    if (!parent->splitJob(job,depth,left,right,true)) {
+      this->nodeID = parent->bvh->createLeaf(parent->prims,parent->triangles,parent->globalAllocPrimitives(blocks(N)),job.start(),N);
+      delete this;
+      return;
+    }
+
+    /*! create an inner node */
+    int nodeID = (int)parent->globalAllocNodes(1);
+    this->nodeID = BVH2<Triangle4>::id2offset(nodeID);
+    BVH2<Triangle4>::Node& node = parent->bvh->nodes[nodeID].clear();
+    node.set(0,left .geomBounds,0);
+    node.set(1,right.geomBounds,0);
+    parent->recurse(node.child[0],depth+1,left );
+    parent->recurse(node.child[1],depth+1,right);
+    delete this;
+  }
+}
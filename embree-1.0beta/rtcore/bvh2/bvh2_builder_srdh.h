@@ -0,0 +1,235 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#ifndef __EMBREE_BVH2_BUILDER_SRDH_H__
+#define __EMBREE_BVH2_BUILDER_SRDH_H__
+
+#include "bvh2.h"
+#include "shadow_ray.h"
+#include "../bvh4/triangle4.h"
+#include "../common/builder.h"
+#include "../common/build_range.h"
+#include "../ray.h"
+#include "sys/filename.h"
+
+#include <vector>
+
+namespace embree
+{
+  /* BVH2 builder driven by the shadow ray distribution heuristic
+   * (SRDH). Splits are binned like in the ObjectBinning, but the
+   * children of a split are weighted by the fraction of a sample of
+   * recorded AnyHit rays that visits them instead of their relative
+   * surface area. The visits are modeled after the occlusion test of
+   * the BVH2Traverser: a ray visits each child whose box it
+   * intersects, the closer child first, and a broken ray that finds
+   * one of its occluders in the first child never visits the second
+   * one. The occluders of the broken rays are found once in a
+   * temporary BVH before the build. The ray estimate of a node is
+   * blended with the surface area estimate, weighted by the number of
+   * rays reaching the node, thus the builder degrades to the SAH in
+   * regions without rays. Like in BVH2Builder, small subtrees are
+   * finished by single-threaded tasks and large nodes are split by
+   * tasks that spawn tasks for their children, the rays of large
+   * nodes are evaluated in parallel. */
+
+  class BVH2BuilderSRDH : private Builder
+  {
+  public:
+
+    /*! API entry function for the builder */
+    static Ref<BVH2<Triangle4> > build(const BuildTriangle* triangles, size_t numTriangles, const std::vector<ShadowRay>& rays);
+
+    /*! Loads a sample of up to maxRays AnyHit rays from a recorded
+     *  trace. Every k'th AnyHit record is taken and weighted by k
+     *  times its recorded weight. */
+    static void loadRays(const FileName& fileName, std::vector<ShadowRay>& rays, size_t maxRays = defaultMaxRays);
+
+  public:
+
+    enum { defaultMaxRays = 64*1024 };   //!< Default size of the ray sample.
+    enum { maxOccluders = 32 };          //!< Maximal number of occluders stored per broken ray.
+    enum { maxBins = 32 };               //!< Maximal number of bins per dimension.
+    enum { priorRays = 4096 };           //!< Number of rays the surface area estimate of a node counts as.
+
+    /*! Constructs the builder. */
+    BVH2BuilderSRDH(const BuildTriangle* triangles, size_t numTriangles, const std::vector<ShadowRay>& rays, Ref<BVH2<Triangle4> > bvh);
+
+    /*! Frees the ray sample. */
+    ~BVH2BuilderSRDH();
+
+    /*! Computes the number of blocks of a number of triangles. */
+    static __forceinline size_t blocks(size_t x) { return (x+3)/4; }
+
+    /*! Sampled ray prepared for the box tests. */
+    struct SampleRay {
+      ssef org;                //!< Ray origin, zero in the last component.
+      ssef rdir;               //!< Reciprocal ray direction, zero in the last component.
+      float near, far;         //!< Ray segment.
+      float weight;            //!< Number of rays this sample stands for.
+      int32 firstOccluder;     //!< First occluder of the ray in the occluder array.
+      int32 numOccluders;      //!< Number of occluders, zero for connected rays.
+    };
+
+    /*! Ray reaching a node together with its occluders inside the node. */
+    struct RayRef {
+      RayRef () {}
+      RayRef (int32 ray, int32 first, int32 num) : ray(ray), first(first), num(num) {}
+    public:
+      int32 ray;      //!< Index of the sample ray.
+      int32 first;    //!< First occluder in the occluder list of the job.
+      int32 num;      //!< Number of occluders inside the node.
+    };
+
+    /*! Build job, a range of primitives and the rays that reach them. */
+    struct Job : public BuildRange {
+      Job () {}
+      Job (const BuildRange& range) : BuildRange(range) {}
+    public:
+      std::vector<RayRef> rays;        //!< Rays reaching the node.
+      std::vector<int32> occluders;    //!< Occluders of the broken rays inside the node.
+    };
+
+    /*! Best split of a job. */
+    struct Split {
+      int dim;          //!< Split dimension, -1 if no valid split was found.
+      int pos;          //!< Split position in bins.
+      float cost;       //!< Expected cost of the split relative to a visit of the node.
+      float leafCost;   //!< Expected cost of a leaf relative to a visit of the node.
+    };
+
+    /*! Bins of a job and the merged bounds of all partitionings. */
+    struct Binning {
+      Binning (const BVH2BuilderSRDH* parent, const Job& job);
+
+      /*! Computes the bin numbers for each dimension for a centroid. */
+      __forceinline ssei getBin(const ssef& c) const { return clamp(ssei((c-centLower)*scale-0.5f),ssei(0),ssei((int)numBins-1)); }
+
+    public:
+      size_t numBins;                     //!< Actual number of bins to use.
+      ssef centLower;                     //!< Lower bound of the doubled centroids.
+      ssef scale;                         //!< Scaling factor to compute bin.
+      bool valid[3];                      //!< False for dimensions without extent.
+      Box  lBounds[3][maxBins];           //!< Bounds of the bins left of each position.
+      Box  rBounds[3][maxBins];           //!< Bounds of the bins right of each position.
+      size_t lBlocks[3][maxBins];         //!< Blocks left of each position.
+      size_t rBlocks[3][maxBins];         //!< Blocks right of each position.
+    };
+
+    /*! Weighted number of rays that visit the children of each partitioning. */
+    struct Visits {
+      Visits ();
+      Visits (const Visits& a, const Visits& b);
+    public:
+      float left [3][maxBins];   //!< Weight of the rays visiting the left child.
+      float right[3][maxBins];   //!< Weight of the rays visiting the right child.
+      float weight;              //!< Weight of all rays reaching the node.
+    };
+
+    /*! Accumulates the visits of a range of rays of a job. */
+    struct CountVisits {
+      CountVisits (const BVH2BuilderSRDH* parent, const Job& job, const Binning& binning) : parent(parent), job(job), binning(binning) {}
+      Visits operator() (size_t begin, size_t end) const;
+      const BVH2BuilderSRDH* parent; const Job& job; const Binning& binning;
+    };
+
+    /*! Combines the visits of two ranges of rays. */
+    struct MergeVisits {
+      Visits operator() (const Visits& a, const Visits& b) const { return Visits(a,b); }
+    };
+
+    /*! Finds the occluders of a range of broken rays. */
+    struct FindOccluders {
+      FindOccluders (BVH2BuilderSRDH* parent, BVH2<Triangle4>* bvh, const std::vector<ShadowRay>& rays, int32* occluders)
+        : parent(parent), bvh(bvh), rays(rays), occluders(occluders) {}
+      void operator() (size_t begin, size_t end) const;
+      BVH2BuilderSRDH* parent; BVH2<Triangle4>* bvh; const std::vector<ShadowRay>& rays; int32* occluders;
+    };
+
+    /*! Intersects a sample ray with a box. */
+    static __forceinline float entry(const SampleRay& ray, const Box& box) {
+      return embree::entry(ray.org,ray.rdir,ray.near,ray.far,box);
+    }
+
+    /*! Stores the indices of up to maxOccluders triangles intersected by the ray, returns their number. */
+    static size_t intersectAll(BVH2<Triangle4>* bvh, const Ray& ray, int32* occluders);
+
+    /*! Finds the split of lowest expected cost, evaluating the rays in parallel if parallel is set. */
+    void findSplit(const Job& job, const Binning& binning, Split& split, bool parallel) const;
+
+    /*! Partitions the primitives and the rays of a job. */
+    void split(const Job& job, const Binning& binning, const Split& split, Job& left, Job& right) const;
+
+    /*! Splits a job into two, returns false if the job should become a leaf instead. */
+    bool splitJob(const Job& job, size_t depth, Job& left, Job& right, bool parallel) const;
+
+    /*! Selects between full build and single-threaded split strategy. */
+    void recurse(int& nodeID, size_t depth, Job& job);
+
+    /*! Single-threaded task that builds a complete BVH. */
+    class BuildTask {
+      ALIGNED_CLASS
+    public:
+
+      /*! Default task construction. */
+      BuildTask(BVH2BuilderSRDH* parent, int& nodeID, size_t depth, Job& job);
+
+      /*! Task entry function. */
+      static void run(size_t tid, BuildTask* This, size_t elts);
+
+      /*! Recursively finishes the BVH construction. */
+      int recurse(size_t depth, Job& job);
+
+    private:
+      BVH2BuilderSRDH* parent;   //!< Pointer to parent task.
+      size_t       tid;          //!< Task ID for fast thread local storage.
+      int&         nodeID;       //!< Reference to output the node ID.
+      size_t       depth;        //!< Recursion depth of the root of this subtree.
+      Job          job;          //!< Primitives and rays of the subtree.
+    };
+
+    /*! Single-threaded task that builds a single node and creates subtasks for the children. */
+    class SplitTask {
+      ALIGNED_CLASS
+    public:
+
+      /*! Default task construction. */
+      SplitTask(BVH2BuilderSRDH* parent, int& nodeID, size_t depth, Job& job);
+
+      /*! Task entry function. */
+      void split(); static void _split(size_t tid, SplitTask* This, size_t elts) { This->split(); }
+
+    private:
+      BVH2BuilderSRDH* parent;   //!< Pointer to parent task.
+      int&         nodeID;       //!< Reference to output the node ID.
+      size_t       depth;        //!< Recursion depth of this node.
+      Job          job;          //!< Primitives and rays of the node.
+    };
+
+  public:
+    const BuildTriangle* triangles;     //!< Source triangle array
+    size_t numTriangles;                //!< Number of triangles
+    Box* prims;                         //!< Working array. Build tasks operate on ranges in this array. */
+    ssef* centers;                      //!< Doubled centroids of the triangles in input order.
+    unsigned char* side;                //!< Child a triangle went to in the last split of its node, 0 left, 1 right.
+    SampleRay* rays;                    //!< Sample rays prepared for the box tests.
+    size_t numRays;                     //!< Number of sample rays.
+    std::vector<int32> occluders;       //!< Occluders of all broken rays.
+    Ref<BVH2<Triangle4> > bvh;          //!< BVH to overwrite
+  };
+}
+
+#endif
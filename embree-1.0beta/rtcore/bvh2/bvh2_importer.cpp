@@ -0,0 +1,247 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "bvh2_importer.h"
+#include "../common/compute_bounds.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace embree
+{
+  Ref<BVH2<Triangle4> > BVH2Importer::import(const FileName& fileName, const BuildTriangle* triangles, size_t numTriangles)
+  {
+    Ref<BVH2<Triangle4> > bvh = new BVH2<Triangle4>;
+    double t0 = getSeconds();
+    BVH2Importer importer(triangles,numTriangles,bvh);
+    importer.parse(fileName);
+    double t1 = getSeconds();
+    size_t bytesNodes = bvh->getNumNodes()*sizeof(BVH2<Triangle4>::Node);
+    size_t bytesTris = bvh->getNumPrimBlocks()*sizeof(BVH2<Triangle4>::Triangle);
+    std::cout <<
+      "triangles = " << numTriangles << ", " <<
+      "import time = " << (t1-t0)*1000.0f << "ms, " <<
+      "sah = " << bvh->getSAH() << ", " <<
+      "size = " << (bytesNodes+bytesTris)*1E-6 << " MB" << std::endl;
+    std::cout <<
+      "nodes = "  << bvh->getNumNodes()  << " (" << bytesNodes*1E-6 << " MB) (" << 100.0*(bvh->getNumNodes()-1+bvh->getNumLeaves())/(2.0*bvh->getNumNodes()     ) << "%), " <<
+      "leaves = " << bvh->getNumLeaves() << " (" << bytesTris*1E-6  << " MB) (" << 100.0*bvh->getNumPrims()                        /(4.0*bvh->getNumPrimBlocks()) << "%)" << std::endl;
+    if (importer.rbvh) std::cout << "fixed order nodes = " << importer.numFixed << std::endl;
+    if (importer.numBackToFront)
+      std::cout << "Warning: " << importer.numBackToFront << " back to front nodes of " << fileName.str() << " visit the closer child first" << std::endl;
+    return bvh;
+  }
+
+  BVH2Importer::BVH2Importer(const BuildTriangle* triangles, size_t numTriangles, Ref<BVH2<Triangle4> > bvh)
+    : mapping(NULL), cur(NULL), end(NULL), triangles(triangles), numTriangles(numTriangles), rbvh(false),
+      prims(NULL), referenced(NULL), numReferenced(0), nextNode(0), nextTriangle(0), maxDepth(0), numFixed(0), numBackToFront(0), bvh(bvh) {}
+
+  BVH2Importer::~BVH2Importer()
+  {
+    if (prims) alignedFree(prims);
+    prims = NULL;
+    if (referenced) delete[] referenced;
+    referenced = NULL;
+    if (mapping) unmapFile(mapping);
+    mapping = NULL;
+  }
+
+  void BVH2Importer::parse(const FileName& fileName)
+  {
+    this->fileName = fileName;
+    mapping = mapFile(fileName);
+    cur = mappedData(mapping);
+    end = cur+mappedSize(mapping);
+
+    if (readInt() != header) error("bad header");
+    const int type = readInt();
+    if (type != typeBVH && type != typeRBVH) error("only BVHs and RBVHs of OBJ triangles are supported");
+    rbvh = type == typeRBVH;
+
+    /*! Allocate the primitive boxes in input and in leaf order. */
+    prims = (Box*)alignedMalloc(max(2*numTriangles,size_t(1))*sizeof(Box));
+    referenced = new bool[numTriangles+1];
+    for (size_t i=0; i<numTriangles; i++) referenced[i] = false;
+    if (numTriangles) {
+      ComputeBoundsTask computeBounds(triangles,numTriangles,prims);
+      computeBounds.go();
+    }
+
+    /*! Every triangle is referenced at most once, thus no leaf needs
+     *  more blocks than it has triangles. The node array grows while
+     *  the nodes are read. */
+    bvh->allocatedNodes     = max(numTriangles/2,size_t(64));
+    bvh->allocatedTriangles = max(numTriangles,size_t(1));
+    bvh->nodes     = (BVH2<Triangle4>::Node*)alignedMalloc(bvh->allocatedNodes    *sizeof(BVH2<Triangle4>::Node));
+    bvh->triangles = (Triangle4*            )alignedMalloc(bvh->allocatedTriangles*sizeof(Triangle4            ));
+
+    Box bounds;
+    int root = parseNode(1,bounds);
+    if (readInt() != sentinel) error("bad sentinel");
+
+    /*! put the triangles the file does not reference next to the imported tree */
+    const size_t numImported = numReferenced;
+    for (size_t i=0; i<numTriangles; i++)
+      if (!referenced[i]) prims[numTriangles+numReferenced++] = prims[i];
+    if (numReferenced > numImported)
+    {
+      std::cout << "Warning: " << numReferenced-numImported << " triangles are not referenced by " << fileName.str() << std::endl;
+      const size_t importedDepth = maxDepth+1;
+      const size_t nodeID = allocNode();
+      Box rbounds;
+      const int rchild = createLeaf(2,numImported,numReferenced,rbounds);
+      BVH2<Triangle4>::Node& node = bvh->nodes[nodeID].clear();
+      node.set(0,bounds,root);
+      node.set(1,rbounds,rchild);
+      root = BVH2<Triangle4>::id2offset(int(nodeID));
+      maxDepth = max(maxDepth,importedDepth);
+    }
+
+    /*! the traversal stacks hold one node per level */
+    if (maxDepth > size_t(BVH2<Triangle4>::maxDepth)) error("tree is deeper than the traversal stack");
+
+    bvh->root = root;
+    bvh->nodes     = (BVH2<Triangle4>::Node*) alignedRealloc(bvh->nodes    ,nextNode    *sizeof(BVH2<Triangle4>::Node));
+    bvh->triangles = (Triangle4*            ) alignedRealloc(bvh->triangles,nextTriangle*sizeof(Triangle4            ));
+    bvh->allocatedNodes     = nextNode;
+    bvh->allocatedTriangles = nextTriangle;
+  }
+
+  void BVH2Importer::error(const std::string& reason) const {
+    throw std::runtime_error("invalid bvh file " + fileName.str() + ": " + reason);
+  }
+
+  int BVH2Importer::readInt()
+  {
+    while (cur < end && isspace(*cur)) cur++;
+    if (cur == end) error("unexpected end of file");
+    const bool negative = *cur == '-';
+    if (negative) cur++;
+    if (cur == end || !isdigit(*cur)) error("number expected");
+    int64 value = 0;
+    while (cur < end && isdigit(*cur)) {
+      value = 10*value + (*cur++ - '0');
+      if (value > 0x7FFFFFFF) error("number too large");
+    }
+    return int(negative ? -value : value);
+  }
+
+  int BVH2Importer::parseNode(size_t depth, Box& bounds)
+  {
+    const int type = readInt();
+
+    /*! the children of branches follow in pre-order */
+    if (type == branchID)
+    {
+      const int kernel = rbvh ? readInt() : int(frontToBack);
+      if (depth > size_t(BVH2<Triangle4>::maxDepth)) error("tree is deeper than the traversal stack");
+      maxDepth = max(maxDepth,depth);
+      const size_t nodeID = allocNode();
+      Box lbounds, rbounds;
+      const int lchild = parseNode(depth+1,lbounds);
+      const int rchild = parseNode(depth+1,rbounds);
+      BVH2<Triangle4>::Node& node = bvh->nodes[nodeID].clear();
+      node.set(0,lbounds,lchild);
+      node.set(1,rbounds,rchild);
+
+      /*! the file stores no probabilities, random kernels visit the closer child first */
+      switch (kernel) {
+      case leftFirst    : node.setOrder(0,0.0f); numFixed++; break;
+      case rightFirst   : node.setOrder(1,0.0f); numFixed++; break;
+      case uniformRandom: break;
+      case frontToBack  : break;
+      case backToFront  : numBackToFront++; break;
+      default           : error("unknown traversal kernel");
+      }
+      bounds = merge(lbounds,rbounds);
+      return BVH2<Triangle4>::id2offset(int(nodeID));
+    }
+
+    /*! leaves list the OBJ indices of their triangles */
+    else if (type == leafID)
+    {
+      const int count = readInt();
+      if (count < 0) error("negative leaf size");
+      const size_t begin = numReferenced;
+      for (int k=0; k<count; k++) {
+        const int i = readInt();
+        if (i < 0 || size_t(i) >= numTriangles) error("triangle index out of range");
+        if (referenced[i]) error("triangle referenced twice");
+        referenced[i] = true;
+        prims[numTriangles+numReferenced++] = prims[i];
+      }
+      return createLeaf(depth,begin,numReferenced,bounds);
+    }
+
+    else {
+      error("only implicit branches and leaves are supported");
+      return 0;
+    }
+  }
+
+  /*! Orders primitive boxes by their center in one dimension. */
+  struct CompareCenter {
+    CompareCenter (size_t dim) : dim(dim) {}
+    bool operator() (const Box& a, const Box& b) const { return a.lower[dim]+a.upper[dim] < b.lower[dim]+b.upper[dim]; }
+    size_t dim;
+  };
+
+  int BVH2Importer::createLeaf(size_t depth, size_t begin, size_t end, Box& bounds)
+  {
+    Box* sorted = prims+numTriangles;
+    bounds = empty;
+    for (size_t i=begin; i<end; i++) bounds = merge(bounds,sorted[i]);
+
+    /*! make a leaf node when the triangles fit */
+    const size_t N = end-begin;
+    if (blocks(N) <= size_t(BVH2<Triangle4>::maxLeafSize)) {
+      const int leaf = bvh->createLeaf(sorted,triangles,nextTriangle,begin,N);
+      nextTriangle += blocks(N);
+      return leaf;
+    }
+
+    /*! otherwise split at the median center in the dimension of largest extent */
+    ssef lower = pos_inf, upper = neg_inf;
+    for (size_t i=begin; i<end; i++) {
+      const ssef c = center(sorted[i]);
+      lower = min(lower,c); upper = max(upper,c);
+    }
+    const ssef size = upper-lower;
+    const size_t dim = size[0] >= size[1] && size[0] >= size[2] ? 0 : size[1] >= size[2] ? 1 : 2;
+    const size_t median = begin+N/2;
+    std::nth_element(sorted+begin,sorted+median,sorted+end,CompareCenter(dim));
+
+    maxDepth = max(maxDepth,depth);
+    const size_t nodeID = allocNode();
+    Box lbounds, rbounds;
+    const int lchild = createLeaf(depth+1,begin,median,lbounds);
+    const int rchild = createLeaf(depth+1,median,end,rbounds);
+    BVH2<Triangle4>::Node& node = bvh->nodes[nodeID].clear();
+    node.set(0,lbounds,lchild);
+    node.set(1,rbounds,rchild);
+    return BVH2<Triangle4>::id2offset(int(nodeID));
+  }
+
+  size_t BVH2Importer::allocNode()
+  {
+    if (nextNode == bvh->allocatedNodes) {
+      bvh->allocatedNodes *= 2;
+      bvh->nodes = (BVH2<Triangle4>::Node*)alignedRealloc(bvh->nodes,bvh->allocatedNodes*sizeof(BVH2<Triangle4>::Node));
+    }
+    return nextNode++;
+  }
+}
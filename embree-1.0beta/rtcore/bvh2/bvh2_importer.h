@@ -0,0 +1,117 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef __EMBREE_BVH2_IMPORTER_H__
+#define __EMBREE_BVH2_IMPORTER_H__
+
+#include "bvh2.h"
+#include "../bvh4/triangle4.h"
+#include "sys/mapping.h"
+
+namespace embree
+{
+  /* Imports a BVH2 from a BVH file in the text format written by
+   * Topaz and TopazML, thus BVHs and RBVHs built offline by their
+   * heuristics can be rendered. The file holds the header, the tree
+   * type 201 (BVH) or 202 (RBVH), the nodes in pre-order and the
+   * sentinel. Only implicit nodes are supported: a branch (ID 2) is
+   * followed by the traversal kernel of the node for RBVHs and by its
+   * two children, a leaf (ID 3) by the number of its triangles and
+   * their OBJ indices. The OBJ indices refer to the triangles in the
+   * order they are handed to the importer, which is the face order of
+   * an OBJ file with triangle faces and a single material when it is
+   * the first object of the scene. Triangles the file does not
+   * reference (e.g. area lights) are put into a median split subtree
+   * next to the imported tree, leaves with too many triangles get
+   * split the same way. */
+
+  class BVH2Importer
+  {
+  public:
+
+    /*! API entry function for the importer */
+    static Ref<BVH2<Triangle4> > import(const FileName& fileName, const BuildTriangle* triangles, size_t numTriangles);
+
+  public:
+
+    /*! Constructs the importer. */
+    BVH2Importer(const BuildTriangle* triangles, size_t numTriangles, Ref<BVH2<Triangle4> > bvh);
+
+    /*! Frees the temporary memory and the mapping of the file. */
+    ~BVH2Importer();
+
+    /*! Overwrites the BVH with the nodes of the file. */
+    void parse(const FileName& fileName);
+
+    /*! Constants of the file format. */
+    enum {
+      header = 267534,         //!< First number of the file.
+      typeBVH = 201,           //!< BVH with OBJ triangle indices.
+      typeRBVH = 202,          //!< RBVH with OBJ triangle indices.
+      branchID = 2,            //!< Implicit branch.
+      leafID = 3,              //!< Implicit leaf.
+      sentinel = 9215          //!< Last number of the file.
+    };
+
+    /*! Traversal kernels of RBVH branches. */
+    enum {
+      leftFirst = 11,          //!< Visits the left child first.
+      rightFirst = 12,         //!< Visits the right child first.
+      uniformRandom = 13,      //!< Visits a random child first.
+      frontToBack = 14,        //!< Visits the closer child first.
+      backToFront = 15         //!< Visits the farther child first.
+    };
+
+    /*! Computes the number of blocks of a number of triangles. */
+    static __forceinline size_t blocks(size_t x) { return (x+3)/4; }
+
+    /*! Throws an exception for an invalid file. */
+    void error(const std::string& reason) const;
+
+    /*! Reads the next number of the file. */
+    int readInt();
+
+    /*! Parses a node and its subtree, returns its ID and bounds. */
+    int parseNode(size_t depth, Box& bounds);
+
+    /*! Creates a leaf for a range of triangles, splits the range at the median if it does not fit into one leaf. */
+    int createLeaf(size_t depth, size_t begin, size_t end, Box& bounds);
+
+    /*! Allocates a node, grows the node array if needed. */
+    size_t allocNode();
+
+  public:
+    FileName fileName;                  //!< Name of the file.
+    mapping_t mapping;                  //!< Mapping of the file.
+    const char* cur;                    //!< Current position in the file.
+    const char* end;                    //!< End of the file.
+    const BuildTriangle* triangles;     //!< Source triangle array
+    size_t numTriangles;                //!< Number of triangles
+    bool rbvh;                          //!< True if the branches store a traversal kernel.
+    Box* prims;                         //!< Primitive boxes, the first half in input order, the second half in leaf order.
+    bool* referenced;                   //!< Marks triangles referenced by a leaf.
+    size_t numReferenced;               //!< Number of triangles in leaf order.
+    size_t nextNode;                    //!< Next free node.
+    size_t nextTriangle;                //!< Next free triangle block.
+    size_t maxDepth;                    //!< Maximal depth of the inner nodes.
+    size_t numFixed;                    //!< Number of branches with a fixed child order.
+    size_t numBackToFront;              //!< Number of back to front branches, they visit the closer child first.
+    Ref<BVH2<Triangle4> > bvh;          //!< BVH to overwrite
+  };
+}
+
+#endif
@@ -0,0 +1,344 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "bvh2_optimizer.h"
+#include "sys/parallel.h"
+
+namespace embree
+{
+  void BVH2Optimizer::optimize(Ref<BVH2<Triangle4> >& bvh, size_t iterations)
+  {
+    float sah = bvh->getSAH();
+    double t0 = getSeconds();
+    BVH2Optimizer optimizer(bvh,iterations);
+    double t1 = getSeconds();
+    size_t bytesNodes = bvh->getNumNodes()*sizeof(BVH2<Triangle4>::Node);
+    size_t bytesTris = bvh->getNumPrimBlocks()*sizeof(BVH2<Triangle4>::Triangle);
+    std::cout <<
+      "iterations = " << iterations << ", " <<
+      "optimization time = " << (t1-t0)*1000.0f << "ms, " <<
+      "sah = " << sah << " -> " << bvh->getSAH() << ", " <<
+      "size = " << (bytesNodes+bytesTris)*1E-6 << " MB" << std::endl;
+  }
+
+  BVH2Optimizer::BVH2Optimizer(Ref<BVH2<Triangle4> >& bvh, size_t iterations)
+    : bvh(bvh), infos(NULL), blockEnd(NULL), subtreeNodes(0)
+  {
+    if (bvh->root < 0) return;
+    infos = (NodeInfo*)alignedMalloc(bvh->allocatedNodes*sizeof(NodeInfo));
+    blockEnd = (uint32*)alignedMalloc(bvh->allocatedTriangles*sizeof(uint32));
+    memset(blockEnd,0,bvh->allocatedTriangles*sizeof(uint32));
+
+    /*! A few subtrees per thread balance the load. The subtrees only
+     *  change which thread optimizes a treelet, not the order of the
+     *  treelets inside a subtree, thus the result is the same for any
+     *  number of threads. */
+    subtreeNodes = max(size_t(minSubtreeNodes),bvh->getNumNodes()/(4*scheduler->getNumThreads()));
+
+    for (size_t i=0; i<iterations; i++)
+    {
+      subtrees.clear();
+      topNodes.clear();
+      if (collect(bvh->root,0) <= subtreeNodes) subtrees.push_back(NodeRef(bvh->root,0));
+      parallel_for(0,subtrees.size(),1,OptimizeSubtrees(this));
+      for (size_t j=0; j<topNodes.size(); j++)
+        optimizeTreelet(topNodes[j].nodeID,topNodes[j].depth);
+    }
+    bvh->modified = true;
+    alignedFree(blockEnd); blockEnd = NULL;
+    alignedFree(infos); infos = NULL;
+
+    /*! compact the arrays, this drops the inner nodes and triangle blocks that collapses freed */
+    size_t numNodes = bvh->getNumNodes(), nextNode = 0;
+    size_t numBlocks = bvh->getNumPrimBlocks(), nextTriangle = 0;
+    BVH2<Triangle4>::Node* nodes = (BVH2<Triangle4>::Node*)alignedMalloc(numNodes*sizeof(BVH2<Triangle4>::Node));
+    Triangle4* triangles = (Triangle4*)alignedMalloc(numBlocks*sizeof(Triangle4));
+    bvh->root = compact(bvh->root,nodes,nextNode,triangles,nextTriangle);
+    alignedFree(bvh->nodes); bvh->nodes = nodes; bvh->allocatedNodes = numNodes;
+    alignedFree(bvh->triangles); bvh->triangles = triangles; bvh->allocatedTriangles = numBlocks;
+  }
+
+  size_t BVH2Optimizer::collect(int nodeID, size_t depth)
+  {
+    if (nodeID < 0) {
+      size_t ofs = size_t(nodeID & 0x7FFFFFFF) >> 5, num = size_t(nodeID) & 0x1F;
+      if (num) blockEnd[ofs] = max(blockEnd[ofs],uint32(ofs+num));
+      return 0;
+    }
+    const BVH2<Triangle4>::Node& node = bvh->node(nodeID);
+    size_t num0 = collect(node.child[0],depth+1);
+    size_t num1 = collect(node.child[1],depth+1);
+    size_t num = 1+num0+num1;
+
+    /*! nodes of too large subtrees are optimized after their children */
+    if (num > subtreeNodes) {
+      if (num0 && num0 <= subtreeNodes) subtrees.push_back(NodeRef(node.child[0],depth+1));
+      if (num1 && num1 <= subtreeNodes) subtrees.push_back(NodeRef(node.child[1],depth+1));
+      topNodes.push_back(NodeRef(nodeID,depth));
+    }
+    return num;
+  }
+
+  void BVH2Optimizer::OptimizeSubtrees::operator() (size_t begin, size_t end) const
+  {
+    for (size_t i=begin; i<end; i++)
+      parent->optimizeSubtree(parent->subtrees[i].nodeID,parent->subtrees[i].depth);
+  }
+
+  void BVH2Optimizer::optimizeSubtree(int nodeID, size_t depth)
+  {
+    if (nodeID < 0) return;
+    const BVH2<Triangle4>::Node& node = bvh->node(nodeID);
+    optimizeSubtree(node.child[0],depth+1);
+    optimizeSubtree(node.child[1],depth+1);
+    optimizeTreelet(nodeID,depth);
+  }
+
+  void BVH2Optimizer::optimizeTreelet(int nodeID, size_t depth)
+  {
+    typedef BVH2<Triangle4> BVH;
+    BVH::Node& root = bvh->node(nodeID);
+
+    /*! grow the treelet by expanding the inner leaf of largest surface area */
+    int leafID[treeletLeaves], innerID[treeletLeaves-2];
+    Box leafBox[treeletLeaves];
+    size_t numLeaves = 2, numInner = 0;
+    for (size_t i=0; i<2; i++) { leafID[i] = root.child[i]; leafBox[i] = root.bounds(i); }
+    const float rootArea = halfArea(merge(leafBox[0],leafBox[1]));
+    while (numLeaves < treeletLeaves)
+    {
+      size_t best = size_t(-1); float bestArea = neg_inf;
+      for (size_t i=0; i<numLeaves; i++) {
+        if (leafID[i] < 0) continue;
+        float area = halfArea(leafBox[i]);
+        if (area > bestArea) { best = i; bestArea = area; }
+      }
+      if (best == size_t(-1)) break;
+
+      BVH::Node& node = bvh->node(leafID[best]);
+      innerID[numInner++] = leafID[best];
+      leafID[best]      = node.child[0]; leafBox[best]        = node.bounds(0);
+      leafID[numLeaves] = node.child[1]; leafBox[numLeaves++] = node.bounds(1);
+    }
+
+    /*! Cost and height of the treelet leaves. For leaf nodes also
+     *  the number of triangles and the range of blocks they own,
+     *  treelets with empty leaves are not rebuilt. */
+    float leafCost[treeletLeaves];
+    int leafHeight[treeletLeaves];
+    size_t leafTris[treeletLeaves], leafBegin[treeletLeaves], leafEnd[treeletLeaves];
+    size_t primLeaves = 0;
+    bool emptyLeaf = false;
+    for (size_t i=0; i<numLeaves; i++)
+    {
+      if (leafID[i] >= 0) {
+        leafCost[i] = info(leafID[i]).cost;
+        leafHeight[i] = info(leafID[i]).height;
+        continue;
+      }
+      size_t ofs = size_t(leafID[i] & 0x7FFFFFFF) >> 5, numBlocks = size_t(leafID[i]) & 0x1F;
+      leafCost[i] = float(BVH::intCost)*float(numBlocks)*halfArea(leafBox[i]);
+      leafHeight[i] = 0;
+      if (numBlocks == 0) { emptyLeaf = true; continue; }
+      leafTris[i] = 0;
+      for (size_t j=ofs; j<ofs+numBlocks; j++) leafTris[i] += __popcnt(movemask(bvh->triangles[j].valid()));
+      leafBegin[i] = ofs;
+      leafEnd[i] = blockEnd[ofs];
+      primLeaves |= size_t(1) << i;
+    }
+
+    /*! cost of the current treelet, the children of the root are its leaves or inner nodes */
+    const float travCost = float(BVH::travCost);
+    NodeInfo current; current.cost = travCost*rootArea; current.height = 0;
+    for (size_t i=0; i<2; i++) {
+      if (root.child[i] >= 0) {
+        current.cost += info(root.child[i]).cost;
+        current.height = max(current.height,info(root.child[i]).height);
+      } else
+        current.cost += float(BVH::intCost)*float(size_t(root.child[i]) & 0x1F)*halfArea(root.bounds(i));
+    }
+    current.height++;
+    info(nodeID) = current;
+    if (numLeaves < 3 || emptyLeaf) return;
+
+    /*! Find the optimal topology for each subset of the leaves in
+     *  order of increasing set index, thus the subsets of a set are
+     *  processed before the set. The partitions of a set are
+     *  enumerated with the lowest leaf always on the same side. A
+     *  set of leaf nodes may also become a single leaf if its packed
+     *  triangles fit into the longest run of adjacent blocks the
+     *  leaves own, this is marked by split 0. The root stays an inner
+     *  node as its parent is not part of the treelet. */
+    Box    box    [1 << treeletLeaves];
+    float  cost   [1 << treeletLeaves];
+    int    height [1 << treeletLeaves];
+    size_t split  [1 << treeletLeaves];
+    size_t numTris[1 << treeletLeaves];
+    const size_t all = (size_t(1) << numLeaves)-1;
+    for (size_t s=1; s<=all; s++)
+    {
+      size_t lowest = s & (0-s);
+      if (s == lowest) {
+        size_t i = __bsf(s);
+        box[s] = leafBox[i]; cost[s] = leafCost[i]; height[s] = leafHeight[i];
+        if (s & primLeaves) numTris[s] = leafTris[i];
+        continue;
+      }
+      box[s] = merge(box[s^lowest],box[lowest]);
+
+      float bestCost = pos_inf; size_t bestSplit = 0;
+      const size_t rest = s^lowest;
+      for (size_t q=(rest-1)&rest; ; q=(q-1)&rest) {
+        const size_t p = q|lowest;
+        float c = cost[p]+cost[s^p];
+        if (c < bestCost) { bestCost = c; bestSplit = p; }
+        if (!q) break;
+      }
+      cost[s] = travCost*halfArea(box[s]) + bestCost;
+      height[s] = 1+max(height[bestSplit],height[s^bestSplit]);
+      split[s] = bestSplit;
+
+      if ((s & primLeaves) != s) continue;
+      numTris[s] = numTris[rest]+numTris[lowest];
+      const size_t numBlocks = (numTris[s]+3)/4;
+      if (s == all || numBlocks > size_t(BVH::maxLeafSize)) continue;
+
+      float c = float(BVH::intCost)*float(numBlocks)*halfArea(box[s]);
+      if (c >= cost[s]) continue;
+      size_t runBegin, first[treeletLeaves], last[treeletLeaves], num = 0;
+      for (size_t i=0; i<numLeaves; i++)
+        if (s & (size_t(1) << i)) { first[num] = leafBegin[i]; last[num++] = leafEnd[i]; }
+      if (longestRun(first,last,num,runBegin) < numBlocks) continue;
+      cost[s] = c; height[s] = 0; split[s] = 0;
+    }
+
+    /*! keep the treelet if the gain is within rounding or the tree would get too deep */
+    if (cost[all] >= current.cost*(1.0f-1E-6f) || depth+size_t(height[all]) > size_t(BVH::maxDepth))
+      return;
+
+    /*! rebuild the treelet top down, reusing its inner nodes */
+    size_t stackSet[treeletLeaves]; int stackNode[treeletLeaves];
+    size_t stackPtr = 0, nextInner = 0;
+    stackSet[stackPtr] = all; stackNode[stackPtr++] = nodeID;
+    while (stackPtr)
+    {
+      --stackPtr;
+      BVH::Node& node = bvh->node(stackNode[stackPtr]);
+      const size_t s = stackSet[stackPtr];
+      const size_t sides[2] = { split[s], s^split[s] };
+      for (size_t i=0; i<2; i++)
+      {
+        const size_t q = sides[i];
+        if (!(q & (q-1))) {
+          size_t leaf = __bsf(q);
+          node.set(i,leafBox[leaf],leafID[leaf]);
+        }
+        else if (split[q] == 0) {
+          int leaves[treeletLeaves]; size_t num = 0;
+          for (size_t j=0; j<numLeaves; j++) if (q & (size_t(1) << j)) leaves[num++] = leafID[j];
+          node.set(i,box[q],collapse(leaves,num));
+        }
+        else {
+          int child = innerID[nextInner++];
+          node.set(i,box[q],child);
+          info(child).cost = cost[q];
+          info(child).height = height[q];
+          stackSet[stackPtr] = q; stackNode[stackPtr++] = child;
+        }
+      }
+    }
+    info(nodeID).cost = cost[all];
+    info(nodeID).height = height[all];
+  }
+
+  size_t BVH2Optimizer::longestRun(size_t* first, size_t* last, size_t num, size_t& runBegin)
+  {
+    /*! sort the ranges, they do not overlap */
+    for (size_t i=1; i<num; i++)
+      for (size_t j=i; j>0 && first[j-1] > first[j]; j--) {
+        std::swap(first[j-1],first[j]);
+        std::swap(last[j-1],last[j]);
+      }
+
+    size_t longest = 0, begin = first[0];
+    runBegin = first[0];
+    for (size_t i=0; i<num; i++) {
+      if (i > 0 && first[i] != last[i-1]) begin = first[i];
+      if (last[i]-begin > longest) { longest = last[i]-begin; runBegin = begin; }
+    }
+    return longest;
+  }
+
+  int BVH2Optimizer::collapse(const int* leafIDs, size_t numLeaves)
+  {
+    /*! the new leaf owns the longest run of adjacent blocks of the leaves, the other blocks are unused afterwards */
+    size_t first[BVH2Optimizer::treeletLeaves], last[BVH2Optimizer::treeletLeaves], runBegin;
+    for (size_t i=0; i<numLeaves; i++) {
+      first[i] = size_t(leafIDs[i] & 0x7FFFFFFF) >> 5;
+      last[i] = blockEnd[first[i]];
+    }
+    const size_t runEnd = runBegin+longestRun(first,last,numLeaves,runBegin);
+
+    /*! gather the triangles into full blocks */
+    const sse3f zero3 = zero;
+    Triangle4 packed[BVH2<Triangle4>::maxLeafSize];
+    size_t slot = 0;
+    for (size_t i=0; i<numLeaves; i++)
+    {
+      const size_t ofs = size_t(leafIDs[i] & 0x7FFFFFFF) >> 5, num = size_t(leafIDs[i]) & 0x1F;
+      for (size_t b=ofs; b<ofs+num; b++)
+      {
+        const Triangle4& src = bvh->triangles[b];
+        for (size_t k=0; k<4; k++)
+        {
+          if (src.id0[k] == -1) continue;
+          Triangle4& dst = packed[slot/4];
+          const size_t l = slot%4;
+          if (l == 0) dst = Triangle4(zero3,zero3,zero3,ssei(-1),ssei(-1));
+          dst.v0.x[l] = src.v0.x[k]; dst.v0.y[l] = src.v0.y[k]; dst.v0.z[l] = src.v0.z[k];
+          dst.e1.x[l] = src.e1.x[k]; dst.e1.y[l] = src.e1.y[k]; dst.e1.z[l] = src.e1.z[k];
+          dst.e2.x[l] = src.e2.x[k]; dst.e2.y[l] = src.e2.y[k]; dst.e2.z[l] = src.e2.z[k];
+          dst.Ng.x[l] = src.Ng.x[k]; dst.Ng.y[l] = src.Ng.y[k]; dst.Ng.z[l] = src.Ng.z[k];
+          dst.id0[l] = src.id0[k]; dst.id1[l] = src.id1[k];
+          slot++;
+        }
+      }
+    }
+
+    const size_t numBlocks = (slot+3)/4;
+    for (size_t i=0; i<numBlocks; i++) bvh->triangles[runBegin+i] = packed[i];
+    blockEnd[runBegin] = uint32(runEnd);
+    return int(BVH2<Triangle4>::emptyNode) | 32*int(runBegin) | int(numBlocks);
+  }
+
+  int BVH2Optimizer::compact(int nodeID, BVH2<Triangle4>::Node* nodes, size_t& nextNode, Triangle4* triangles, size_t& nextTriangle)
+  {
+    if (nodeID < 0) {
+      size_t ofs = size_t(nodeID & 0x7FFFFFFF) >> 5, num = size_t(nodeID) & 0x1F;
+      if (num == 0) return nodeID;
+      for (size_t i=0; i<num; i++) triangles[nextTriangle+i] = bvh->triangles[ofs+i];
+      nextTriangle += num;
+      return int(BVH2<Triangle4>::emptyNode) | 32*int(nextTriangle-num) | int(num);
+    }
+    size_t id = nextNode++;
+    BVH2<Triangle4>::Node& node = nodes[id];
+    node = bvh->node(nodeID);
+    for (size_t i=0; i<2; i++)
+      node.child[i] = compact(node.child[i],nodes,nextNode,triangles,nextTriangle);
+    return BVH2<Triangle4>::id2offset(int(id));
+  }
+}
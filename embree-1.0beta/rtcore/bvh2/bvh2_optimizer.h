@@ -0,0 +1,108 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef __EMBREE_BVH2_OPTIMIZER_H__
+#define __EMBREE_BVH2_OPTIMIZER_H__
+
+#include "bvh2.h"
+#include "../bvh4/triangle4.h"
+
+#include <vector>
+
+namespace embree
+{
+  /* Treelet restructuring pass over a built BVH2. For every inner
+   * node in post order the pass grows a treelet of up to 7 leaves by
+   * repeatedly expanding the treelet leaf of largest surface area,
+   * finds the topology of minimal SAH cost over these leaves by
+   * dynamic programming over all subsets and rebuilds the treelet
+   * in place when this lowers the cost. Subsets of leaf nodes may
+   * also collapse into a single leaf, their triangles get repacked
+   * into the blocks the leaves own. The inner nodes of the treelet
+   * are reused, thus the pass needs no allocation until it compacts
+   * the node and triangle arrays at the end. Subtrees are optimized
+   * by parallel tasks and the nodes above them in the calling thread
+   * afterwards, thus the result for a given BVH does not depend on
+   * the number of threads. */
+
+  class BVH2Optimizer
+  {
+  public:
+
+    /*! API entry function for the optimizer */
+    static void optimize(Ref<BVH2<Triangle4> >& bvh, size_t iterations = 2);
+
+  public:
+
+    /*! Optimizes the BVH in place. */
+    BVH2Optimizer(Ref<BVH2<Triangle4> >& bvh, size_t iterations);
+
+    /*! Inner node together with its number of ancestors. */
+    struct NodeRef {
+      NodeRef (int nodeID, size_t depth) : nodeID(nodeID), depth(depth) {}
+      int nodeID;        //!< Node offset.
+      size_t depth;      //!< Number of ancestors of the node.
+    };
+
+    /*! SAH cost and height of the subtree of an inner node. */
+    struct NodeInfo {
+      float cost;        //!< SAH cost of the subtree, relative to half surface areas.
+      int height;        //!< Maximal number of inner nodes on a path to a leaf.
+    };
+
+    /*! Sorts the inner nodes into subtrees for the tasks and top nodes, returns the number of inner nodes below nodeID. */
+    size_t collect(int nodeID, size_t depth);
+
+    /*! Optimizes all treelets of a subtree in post order. */
+    void optimizeSubtree(int nodeID, size_t depth);
+
+    /*! Optimizes the treelet rooted at an inner node whose subtrees are already optimized. */
+    void optimizeTreelet(int nodeID, size_t depth);
+
+    /*! Sorts disjoint block ranges and returns the longest run of adjacent ranges. */
+    static size_t longestRun(size_t* first, size_t* last, size_t num, size_t& runBegin);
+
+    /*! Moves the triangles of a number of leaves into one leaf, returns the new leaf. */
+    int collapse(const int* leafIDs, size_t numLeaves);
+
+    /*! Copies the subtree into new node and triangle arrays in depth first order. */
+    int compact(int nodeID, BVH2<Triangle4>::Node* nodes, size_t& nextNode, Triangle4* triangles, size_t& nextTriangle);
+
+    /*! Returns the info of an inner node. */
+    __forceinline NodeInfo& info(int nodeID) { return infos[size_t(nodeID)/(sizeof(BVH2<Triangle4>::Node)/BVH2<Triangle4>::offsetFactor)]; }
+
+    /*! Optimizes a range of the subtrees. */
+    struct OptimizeSubtrees {
+      OptimizeSubtrees (BVH2Optimizer* parent) : parent(parent) {}
+      void operator() (size_t begin, size_t end) const;
+      BVH2Optimizer* parent;
+    };
+
+  public:
+    enum { treeletLeaves = 7 };        //!< Maximal number of leaves of a treelet.
+    enum { minSubtreeNodes = 1024 };   //!< Subtrees of the tasks have at least about this many inner nodes.
+
+    Ref<BVH2<Triangle4> > bvh;         //!< BVH to optimize.
+    NodeInfo* infos;                   //!< Cost and height per inner node.
+    uint32* blockEnd;                  //!< End of the blocks owned by the leaf that starts at a block, larger than the leaf after a collapse.
+    size_t subtreeNodes;               //!< Subtrees with up to this many inner nodes get optimized by one task.
+    std::vector<NodeRef> subtrees;     //!< Roots of the subtrees of the tasks.
+    std::vector<NodeRef> topNodes;     //!< Inner nodes above the subtrees in post order.
+  };
+}
+
+#endif
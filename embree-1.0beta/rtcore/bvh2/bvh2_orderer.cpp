@@ -0,0 +1,96 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "bvh2_orderer.h"
+
+namespace embree
+{
+  void BVH2Orderer::order(Ref<BVH2<Triangle4> >& bvh, const std::vector<ShadowRay>& rays)
+  {
+    double t0 = getSeconds();
+    BVH2Orderer orderer(bvh,rays);
+    double t1 = getSeconds();
+    std::cout <<
+      "rays = " << rays.size() << ", " <<
+      "order time = " << (t1-t0)*1000.0f << "ms, " <<
+      "fixed order nodes = " << orderer.numFixed << " of " << orderer.numSampled << std::endl;
+  }
+
+  BVH2Orderer::BVH2Orderer(Ref<BVH2<Triangle4> >& bvh, const std::vector<ShadowRay>& rays)
+    : bvh(bvh), costs(bvh->allocatedNodes), numSampled(0), numFixed(0)
+  {
+    /*! accumulate the costs of all orders */
+    for (size_t i=0; i<rays.size(); i++) {
+      const Ray& ray = rays[i].ray;
+      const ssef org (ray.org.x ,ray.org.y ,ray.org.z ,0.0f);
+      const ssef rdir(ray.rdir.x,ray.rdir.y,ray.rdir.z,0.0f);
+      float cost = 0.0f;
+      traverse(bvh->root,ray,org,rdir,rays[i].weight,cost);
+    }
+
+    /*! keep the closer child first unless a fixed order is cheaper */
+    for (size_t i=0; i<costs.size(); i++)
+    {
+      const NodeCosts& c = costs[i];
+      BVH2<Triangle4>::Node& node = bvh->nodes[i];
+      if (c.weight == 0.0f) continue;
+      numSampled++;
+      if      (c.leftFirst  < c.closerFirst && c.leftFirst  <= c.rightFirst) { node.setOrder(0,c.occludedLeft /c.weight); numFixed++; }
+      else if (c.rightFirst < c.closerFirst && c.rightFirst <  c.leftFirst ) { node.setOrder(1,c.occludedRight/c.weight); numFixed++; }
+      else node.setOrder(BVH2<Triangle4>::closerFirst,c.occludedCloser/c.weight);
+    }
+  }
+
+  bool BVH2Orderer::traverse(int nodeID, const Ray& ray, const ssef& org, const ssef& rdir, float weight, float& cost)
+  {
+    /*! a leaf intersects all its triangles */
+    if (nodeID < 0) {
+      nodeID ^= 0x80000000;
+      const size_t ofs = size_t(nodeID) >> 5;
+      const size_t num = size_t(nodeID) & 0x1F;
+      bool occluded = false;
+      for (size_t i=ofs; i<ofs+num; i++) occluded |= bvh->triangles[i].occluded(ray);
+      cost = float(BVH2<Triangle4>::intCost*num);
+      return occluded;
+    }
+
+    /*! descend into the children the ray hits */
+    BVH2<Triangle4>::Node& node = bvh->node(nodeID);
+    const float tNear0 = entry(org,rdir,ray.near,ray.far,node.bounds(0));
+    const float tNear1 = entry(org,rdir,ray.near,ray.far,node.bounds(1));
+    float cost0 = 0.0f, cost1 = 0.0f;
+    const bool occluded0 = tNear0 != float(pos_inf) && traverse(node.child[0],ray,org,rdir,weight,cost0);
+    const bool occluded1 = tNear1 != float(pos_inf) && traverse(node.child[1],ray,org,rdir,weight,cost1);
+    cost = float(BVH2<Triangle4>::travCost)+cost0+cost1;
+
+    /*! the order only matters for rays hitting both children */
+    if (tNear0 != float(pos_inf) && tNear1 != float(pos_inf))
+    {
+      const float leftFirst  = cost0 + (occluded0 ? 0.0f : cost1);
+      const float rightFirst = cost1 + (occluded1 ? 0.0f : cost0);
+      const bool closerLeft = tNear0 < tNear1;
+      NodeCosts& c = costs[size_t(nodeID)*BVH2<Triangle4>::offsetFactor/sizeof(BVH2<Triangle4>::Node)];
+      c.leftFirst   += weight*leftFirst;
+      c.rightFirst  += weight*rightFirst;
+      c.closerFirst += weight*(closerLeft ? leftFirst : rightFirst);
+      c.weight += weight;
+      if (occluded0) c.occludedLeft  += weight;
+      if (occluded1) c.occludedRight += weight;
+      if (closerLeft ? occluded0 : occluded1) c.occludedCloser += weight;
+    }
+    return occluded0 || occluded1;
+  }
+}
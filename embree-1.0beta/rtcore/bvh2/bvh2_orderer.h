@@ -0,0 +1,78 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#ifndef __EMBREE_BVH2_ORDERER_H__
+#define __EMBREE_BVH2_ORDERER_H__
+
+#include "bvh2.h"
+#include "shadow_ray.h"
+#include "../bvh4/triangle4.h"
+
+#include <vector>
+
+namespace embree
+{
+  /* Turns a BVH2 into an RBVH by choosing for each inner node which
+   * child occlusion rays visit first. A sample of recorded AnyHit
+   * rays is traversed through the whole BVH without early
+   * termination. At each node where a ray hits both children, the
+   * pass accumulates the cost the ray would have had when visiting
+   * the left child first, the right child first, or the closer child
+   * first, i.e. the cost of the first child plus the cost of the
+   * second child if the first holds no occluder. Nodes keep the
+   * closer child first unless a fixed order is cheaper for the
+   * sample. The BVH2Traverser follows the stored order in occluded
+   * queries. */
+
+  class BVH2Orderer
+  {
+  public:
+
+    /*! API entry function for the orderer */
+    static void order(Ref<BVH2<Triangle4> >& bvh, const std::vector<ShadowRay>& rays);
+
+  public:
+
+    /*! Orders the children of the nodes of the BVH. */
+    BVH2Orderer(Ref<BVH2<Triangle4> >& bvh, const std::vector<ShadowRay>& rays);
+
+    /*! Costs of the children visiting orders of one node, summed over the rays that hit both children. */
+    struct NodeCosts
+    {
+      NodeCosts () : leftFirst(0.0f), rightFirst(0.0f), closerFirst(0.0f), weight(0.0f), occludedLeft(0.0f), occludedRight(0.0f), occludedCloser(0.0f) {}
+    public:
+      float leftFirst;        //!< Cost when visiting the left child first.
+      float rightFirst;       //!< Cost when visiting the right child first.
+      float closerFirst;      //!< Cost when visiting the closer child first.
+      float weight;           //!< Weight of the rays hitting both children.
+      float occludedLeft;     //!< Weight of these rays with an occluder in the left child.
+      float occludedRight;    //!< Weight of these rays with an occluder in the right child.
+      float occludedCloser;   //!< Weight of these rays with an occluder in the closer child.
+    };
+
+    /*! Traverses a subtree without early termination, accumulates the
+     *  node costs and returns whether the subtree holds an occluder. */
+    bool traverse(int nodeID, const Ray& ray, const ssef& org, const ssef& rdir, float weight, float& cost);
+
+  public:
+    Ref<BVH2<Triangle4> > bvh;        //!< BVH to order.
+    std::vector<NodeCosts> costs;     //!< Costs per node ID.
+    size_t numSampled;                //!< Number of nodes with a sampled ray hitting both children.
+    size_t numFixed;                  //!< Number of these nodes that got a fixed order.
+  };
+}
+
+#endif
@@ -0,0 +1,175 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "bvh2_to_bvh8.h"
+
+#if defined(__AVX__)
+
+namespace embree
+{
+  Ref<BVH8<Triangle8> > BVH2ToBVH8::convert(const Ref<BVH2<Triangle4> >& bvh2)
+  {
+    Ref<BVH8<Triangle8> > bvh8 = new BVH8<Triangle8>;
+    double t0 = getSeconds();
+    BVH2ToBVH8 builder(bvh2,bvh8);
+    double t1 = getSeconds();
+    size_t bytesNodes = bvh8->getNumNodes()*sizeof(BVH8<Triangle8>::Node);
+    size_t bytesTris = bvh8->getNumPrimBlocks()*sizeof(BVH8<Triangle8>::Triangle);
+    /*! std::endl would instantiate the inline ctype<char>::do_widen with AVX here */
+    std::cout <<
+      "build time = " << (t1-t0)*1000.0f << "ms, " <<
+      "sah = " << bvh8->getSAH() << ", " <<
+      "size = " << (bytesNodes+bytesTris)*1E-6 << " MB\n";
+    std::cout <<
+      "nodes = "  << bvh8->getNumNodes()  << " (" << bytesNodes*1E-6 << " MB) (" << 100.0*(bvh8->getNumNodes()-1+bvh8->getNumLeaves())/(8.0*bvh8->getNumNodes()     ) << "%), " <<
+      "leaves = " << bvh8->getNumLeaves() << " (" << bytesTris*1E-6  << " MB) (" << 100.0*bvh8->getNumPrims()                         /(8.0*bvh8->getNumPrimBlocks()) << "%)\n" << std::flush;
+    return bvh8;
+  }
+
+  BVH2ToBVH8::BVH2ToBVH8(const Ref<BVH2<Triangle4> >& bvh2, Ref<BVH8<Triangle8> >& bvh8)
+    : bvh2(bvh2), bvh8(bvh8), nextNode(0), nextTriangle(0)
+  {
+    /*! Allocate storage for the nodes and triangles. The BVH2 might
+     *  come from the cache, which does not know the allocated sizes,
+     *  thus we count them. */
+    size_t numNodes = 0, numBlocks = 0;
+    count(bvh2->root,numNodes,numBlocks);
+    bvh8->nodes     = (BVH8<Triangle8>::Node*)alignedMalloc(max(numNodes,size_t(1))*sizeof(BVH8<Triangle8>::Node));
+    bvh8->triangles = (Triangle8*)alignedMalloc(max(numBlocks,size_t(1))*sizeof(Triangle8));
+
+    /*! recursively convert tree */
+    bvh8->root = recurse(bvh2->root);
+
+    /*! shrink node array to the used size */
+    bvh8->nodes = (BVH8<Triangle8>::Node*)alignedRealloc(bvh8->nodes,max(nextNode,size_t(1))*sizeof(BVH8<Triangle8>::Node));
+  }
+
+  void BVH2ToBVH8::count(int nodeID, size_t& numNodes, size_t& numBlocks)
+  {
+    if (nodeID >= 0) {
+      numNodes++;
+      count(bvh2->node(nodeID).child[0],numNodes,numBlocks);
+      count(bvh2->node(nodeID).child[1],numNodes,numBlocks);
+    }
+    else {
+      nodeID ^= 0x80000000;
+      size_t ofs = size_t(nodeID) >> 5;
+      size_t num = size_t(nodeID) & 0x1F;
+      size_t numTris = 0;
+      for (size_t i=ofs; i<ofs+num; i++) numTris += bvh2->triangles[i].size();
+      numBlocks += (numTris+7)/8;
+    }
+  }
+
+  /*! clears a block of 8 triangles, empty slots have an ID of -1 */
+  static __forceinline void clear(Triangle8& tri) {
+    tri.v0 = tri.e1 = tri.e2 = tri.Ng = avx3f(zero);
+    tri.id0 = tri.id1 = -1;
+  }
+
+  int BVH2ToBVH8::createLeaf(int leaf)
+  {
+    leaf ^= 0x80000000;
+    size_t ofs = size_t(leaf) >> 5;
+    size_t num = size_t(leaf) & 0x1F;
+    if (!num) return int(BVH8<Triangle8>::emptyNode);
+
+    /*! We copy the precomputed edges and normals, thus a triangle is
+     *  intersected with exactly the same arithmetic as in the BVH2. */
+    Triangle8 block; clear(block);
+
+    size_t slot = 0, numBlocks = 0;
+    for (size_t i=ofs; i<ofs+num; i++)
+    {
+      const Triangle4& tri = bvh2->triangles[i];
+      for (size_t j=0; j<4; j++)
+      {
+        if (tri.id0[j] == -1) continue;
+        block.id0 [slot] = tri.id0[j];
+        block.id1 [slot] = tri.id1[j];
+        block.v0.x[slot] = tri.v0.x[j]; block.v0.y[slot] = tri.v0.y[j]; block.v0.z[slot] = tri.v0.z[j];
+        block.e1.x[slot] = tri.e1.x[j]; block.e1.y[slot] = tri.e1.y[j]; block.e1.z[slot] = tri.e1.z[j];
+        block.e2.x[slot] = tri.e2.x[j]; block.e2.y[slot] = tri.e2.y[j]; block.e2.z[slot] = tri.e2.z[j];
+        block.Ng.x[slot] = tri.Ng.x[j]; block.Ng.y[slot] = tri.Ng.y[j]; block.Ng.z[slot] = tri.Ng.z[j];
+        if (++slot < 8) continue;
+        bvh8->triangles[nextTriangle+numBlocks++] = block;
+        clear(block);
+        slot = 0;
+      }
+    }
+    if (slot) bvh8->triangles[nextTriangle+numBlocks++] = block;
+    if (!numBlocks) return int(BVH8<Triangle8>::emptyNode);
+
+    int leafID = int(BVH8<Triangle8>::emptyNode) | 32*int(nextTriangle) | int(numBlocks);
+    nextTriangle += numBlocks;
+    return leafID;
+  }
+
+  /*! recursively converts BVH2 into BVH8 */
+  int BVH2ToBVH8::recurse(int parent)
+  {
+    /*! repack leaf nodes */
+    if (parent < 0) return createLeaf(parent);
+
+    /*! initialize first two nodes */
+    int nodes[8];
+    Box bounds[8];
+    size_t numChildren = 2;
+    nodes [0] = bvh2->node(parent).child[0];
+    bounds[0] = bvh2->node(parent).bounds(0);
+    nodes [1] = bvh2->node(parent).child[1];
+    bounds[1] = bvh2->node(parent).bounds(1);
+
+    /*! open the inner node with largest bounding box */
+    while (numChildren < 8)
+    {
+      index_t bestIdx = -1;
+      float bestArea = neg_inf;
+      for (size_t i=0; i<numChildren; i++)
+      {
+        /*! skip leaf nodes */
+        if (nodes[i] < 0) continue;
+
+        /*! find largest bounding */
+        float A = halfArea(bounds[i]);
+        if (A > bestArea) {
+          bestArea = A;
+          bestIdx = i;
+        }
+      }
+      if (bestIdx<0) break;
+
+      /*! recurse into best candidate */
+      int bestNode = nodes[bestIdx];
+      nodes [bestIdx]     = bvh2->node(bestNode).child[0];
+      bounds[bestIdx]     = bvh2->node(bestNode).bounds(0);
+      nodes [numChildren] = bvh2->node(bestNode).child[1];
+      bounds[numChildren] = bvh2->node(bestNode).bounds(1);
+      numChildren++;
+    }
+
+    /*! encode BVH8 node and recurse, the node is filled after its children are converted */
+    size_t nodeID = nextNode++;
+    int children[8];
+    for (size_t i=0; i<numChildren; i++) children[i] = recurse(nodes[i]);
+    BVH8<Triangle8>::Node& node = bvh8->nodes[nodeID].clear();
+    for (size_t i=0; i<numChildren; i++) node.set(i,bounds[i],children[i]);
+    return BVH8<Triangle8>::id2offset(int(nodeID));
+  }
+}
+
+#endif
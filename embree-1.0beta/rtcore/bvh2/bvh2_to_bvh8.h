@@ -0,0 +1,65 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef __EMBREE_BVH2_TO_BVH8_H__
+#define __EMBREE_BVH2_TO_BVH8_H__
+
+#include "bvh2.h"
+#include "../bvh4/triangle4.h"
+#include "../bvh8/bvh8.h"
+#include "../bvh8/triangle8.h"
+
+#if defined(__AVX__)
+
+namespace embree
+{
+  /* Converts a BVH2 into a BVH8 by collapsing 3 levels of the BVH2
+   * into one node, like BVH2ToBVH4 does for 2 levels. The triangles
+   * of each leaf are repacked into blocks of 8. The BVH2 is left
+   * untouched. */
+  class BVH2ToBVH8
+  {
+  public:
+
+    /*! API entry function for the converter */
+    static Ref<BVH8<Triangle8> > convert(const Ref<BVH2<Triangle4> >& bvh2);
+
+  public:
+
+    /*! Construction. */
+    BVH2ToBVH8(const Ref<BVH2<Triangle4> >& bvh2, Ref<BVH8<Triangle8> >& bvh8);
+
+    /*! counts the nodes and triangle blocks the BVH8 requires at most */
+    void count(int nodeID, size_t& numNodes, size_t& numBlocks);
+
+    /*! recursively converts BVH2 into BVH8 */
+    int recurse(int parent);
+
+    /*! repacks the triangles of a BVH2 leaf into a BVH8 leaf */
+    int createLeaf(int leaf);
+
+  public:
+    Ref<BVH2<Triangle4> > bvh2;   //!< source BVH2
+    Ref<BVH8<Triangle8> > bvh8;   //!< target BVH8
+    size_t nextNode;              //!< next free node of the BVH8
+    size_t nextTriangle;          //!< next free triangle block of the BVH8
+  };
+}
+
+#endif
+
+#endif
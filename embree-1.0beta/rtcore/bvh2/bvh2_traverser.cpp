@@ -18,20 +18,27 @@
 
 namespace embree
 {
-  void BVH2Traverser::intersect(const Ray& ray, Hit& hit, int depth) const
+  /*! precomputed shuffles, to switch lower and upper bounds depending on ray direction */
+  __forceinline BVH2Traverser::Octant::Octant (size_t octant)
+  {
+    const ssei identity = _mm_set_epi8(15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1, 0);
+    const ssei swap     = _mm_set_epi8( 7,  6,  5,  4,  3,  2,  1,  0, 15, 14, 13, 12, 11, 10,  9, 8);
+    shuffleX = octant & 1 ? swap : identity;
+    shuffleY = octant & 2 ? swap : identity;
+    shuffleZ = octant & 4 ? swap : identity;
+  }
+
+  __forceinline void BVH2Traverser::intersectRay(const Ray& ray, Hit& hit, const Octant& octant, int* stack, float* dist) const
   {
     /*! stack state */
     int stackPtr = 0;                        //!< current stack pointer
-    int stack[1+BVH2<Triangle4>::maxDepth];  //!< stack of nodes that still need to get traversed
-    float dist[1+BVH2<Triangle4>::maxDepth]; //!< distance of nodes on the stack
     int cur = bvh->root;                     //!< in cur we track the ID of the current node
 
-    /*! precomputed shuffles, to switch lower and upper bounds depending on ray direction */
-    const ssei identity = _mm_set_epi8(15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1, 0);
+    /*! shuffles of the octant, swap also orders the near and far distances */
     const ssei swap     = _mm_set_epi8( 7,  6,  5,  4,  3,  2,  1,  0, 15, 14, 13, 12, 11, 10,  9, 8);
-    const ssei shuffleX = ray.dir.x >= 0 ? identity : swap;
-    const ssei shuffleY = ray.dir.y >= 0 ? identity : swap;
-    const ssei shuffleZ = ray.dir.z >= 0 ? identity : swap;
+    const ssei shuffleX = octant.shuffleX;
+    const ssei shuffleY = octant.shuffleY;
+    const ssei shuffleZ = octant.shuffleZ;
 
     /*! load the ray into SIMD registers */
     const ssei pn = ssei(0x00000000,0x00000000,0x80000000,0x80000000);
@@ -85,19 +92,17 @@ pop_node:
     }
   }
 
-  bool BVH2Traverser::occluded(const Ray& ray, int depth) const
+  __forceinline bool BVH2Traverser::occludedRay(const Ray& ray, const Octant& octant, int* stack) const
   {
     /*! stack state */
     int stackPtr = 0;                         //!< current stack pointer
-    int stack[1+BVH2<Triangle4>::maxDepth];   //!< stack of nodes that still need to get traversed
     int cur = bvh->root;                      //!< in cur we track the ID of the current node
 
-    /*! precomputed shuffles, to switch lower and upper bounds depending on ray direction */
-    const ssei identity = _mm_set_epi8(15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1, 0);
+    /*! shuffles of the octant, swap also orders the near and far distances */
     const ssei swap     = _mm_set_epi8( 7,  6,  5,  4,  3,  2,  1,  0, 15, 14, 13, 12, 11, 10,  9, 8);
-    const ssei shuffleX = ray.dir.x >= 0 ? identity : swap;
-    const ssei shuffleY = ray.dir.y >= 0 ? identity : swap;
-    const ssei shuffleZ = ray.dir.z >= 0 ? identity : swap;
+    const ssei shuffleX = octant.shuffleX;
+    const ssei shuffleY = octant.shuffleY;
+    const ssei shuffleZ = octant.shuffleZ;
 
     /*! load the ray into SIMD registers */
     const ssei pn = ssei(0x00000000,0x00000000,0x80000000,0x80000000);
@@ -119,10 +124,11 @@ pop_node:
         const ssef tNearFar = max(tNearFarX,tNearFarY,tNearFarZ,nearFar) ^ pn;
         const sseb lrhit = tNearFar <= shuffle8(tNearFar,swap);
 
-        /*! if two children hit, push far node onto stack and continue with closer node */
+        /*! if two children hit, push the other node onto stack and continue with the RBVH order or the closer node */
         if (__builtin_expect(lrhit[0] != 0 && lrhit[1] != 0, true)) {
-          if (tNearFar[0] < tNearFar[1]) { stack[stackPtr++] = node.child[1]; cur = node.child[0]; }
-          else                           { stack[stackPtr++] = node.child[0]; cur = node.child[1]; }
+          const bool leftFirst = node.order == int32(BVH2<Triangle4>::closerFirst) ? tNearFar[0] < tNearFar[1] : node.order == 0;
+          if (leftFirst) { stack[stackPtr++] = node.child[1]; cur = node.child[0]; }
+          else           { stack[stackPtr++] = node.child[0]; cur = node.child[1]; }
         }
 
         /*! if one child hit, continue with that child */
@@ -150,4 +156,45 @@ pop_node:
     }
     return false;
   }
+
+  void BVH2Traverser::intersect(const Ray& ray, Hit& hit, int depth) const
+  {
+    int stack[1+BVH2<Triangle4>::maxDepth];  //!< stack of nodes that still need to get traversed
+    float dist[1+BVH2<Triangle4>::maxDepth]; //!< distance of nodes on the stack
+    intersectRay(ray,hit,Octant(dirOctant(ray.dir)),stack,dist);
+  }
+
+  bool BVH2Traverser::occluded(const Ray& ray, int depth) const
+  {
+    int stack[1+BVH2<Triangle4>::maxDepth];  //!< stack of nodes that still need to get traversed
+    return occludedRay(ray,Octant(dirOctant(ray.dir)),stack);
+  }
+
+  void BVH2Traverser::intersectRun(size_t octant, const RayStreamSoA& rays, const size_t* order, size_t num, HitStreamSoA& hits) const
+  {
+    int stack[1+BVH2<Triangle4>::maxDepth];  //!< stack of nodes that still need to get traversed
+    float dist[1+BVH2<Triangle4>::maxDepth]; //!< distance of nodes on the stack
+    const Octant setup(octant);
+    for (size_t i=0; i<num; i++) {
+      Hit hit; hit.u = hit.v = 0.0f;
+      intersectRay(rays.get(order[i]),hit,setup,stack,dist);
+      hits.set(order[i],hit);
+    }
+  }
+
+  void BVH2Traverser::occludedRun(size_t octant, const RayStreamSoA& rays, const size_t* order, size_t num, bool* occluded) const
+  {
+    int stack[1+BVH2<Triangle4>::maxDepth];  //!< stack of nodes that still need to get traversed
+    const Octant setup(octant);
+    for (size_t i=0; i<num; i++)
+      occluded[order[i]] = occludedRay(rays.get(order[i]),setup,stack);
+  }
+
+  void BVH2Traverser::intersectN(const RayStreamSoA& rays, HitStreamSoA& hits, size_t n, int depth) const {
+    intersectStream(*this,rays,hits,n);
+  }
+
+  void BVH2Traverser::occludedN(const RayStreamSoA& rays, bool* occluded, size_t n, int depth) const {
+    occludedStream(*this,rays,occluded,n);
+  }
 }
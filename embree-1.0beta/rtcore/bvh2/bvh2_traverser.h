@@ -22,7 +22,8 @@
 
 namespace embree
 {
-  /*! BVH2 Traverser. Single ray traversal implementation for a binary BVH. */
+  /*! BVH2 Traverser. Single ray and ray stream traversal implementation
+   *  for a binary BVH. */
   class BVH2Traverser : public Intersector
   {
   public:
@@ -32,8 +33,28 @@ namespace embree
 
     void intersect(const Ray& ray, Hit& hit, int depth) const;
     bool occluded (const Ray& ray, int depth) const;
+    void intersectN(const RayStreamSoA& rays, HitStreamSoA& hits, size_t n, int depth) const;
+    void occludedN(const RayStreamSoA& rays, bool* occluded, size_t n, int depth) const;
+
+    /*! Stream kernels for a run of rays that all point into the given
+     *  octant. The rays are selected by their indices in order. */
+    void intersectRun(size_t octant, const RayStreamSoA& rays, const size_t* order, size_t num, HitStreamSoA& hits) const;
+    void occludedRun (size_t octant, const RayStreamSoA& rays, const size_t* order, size_t num, bool* occluded) const;
 
   private:
+
+    /*! Direction dependent setup, shared by all rays of an octant. */
+    struct Octant
+    {
+      Octant (size_t octant);
+      ssei shuffleX, shuffleY, shuffleZ;  //!< shuffles to switch lower and upper bounds
+    };
+
+    /*! Single ray kernels, shared by the single ray and the stream
+     *  queries. The caller provides the octant setup and the stack. */
+    void intersectRay(const Ray& ray, Hit& hit, const Octant& octant, int* stack, float* dist) const;
+    bool occludedRay(const Ray& ray, const Octant& octant, int* stack) const;
+
     Ref<BVH2<Triangle4> > bvh;  //!< BVH to traverse
   };
 }
@@ -0,0 +1,48 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef __EMBREE_SHADOW_RAY_H__
+#define __EMBREE_SHADOW_RAY_H__
+
+#include "../ray.h"
+
+namespace embree
+{
+  /*! Recorded AnyHit ray, used by the SRDH builder and the RBVH
+   *  orderer to estimate how often occlusion rays visit nodes. */
+  struct ShadowRay {
+    ShadowRay () {}
+    ShadowRay (const Ray& ray, float weight, bool broken) : ray(ray), weight(weight), broken(broken) {}
+  public:
+    Ray ray;          //!< Segment that got tested for occlusion.
+    float weight;     //!< Number of rays this sample stands for.
+    bool broken;      //!< True for ABrk rays, false for ACon rays.
+  };
+
+  /*! Intersects a ray given by its origin and reciprocal direction
+   *  with a box, returns the entry distance or infinity for a miss. */
+  __forceinline float entry(const ssef& org, const ssef& rdir, float near, float far, const Box& box)
+  {
+    const ssef t0 = (box.lower-org)*rdir;
+    const ssef t1 = (box.upper-org)*rdir;
+    const float tNear = extract<0>(reduce_max(insert<3>(min(t0,t1),near)));
+    const float tFar  = extract<0>(reduce_min(insert<3>(max(t0,t1),far)));
+    return tNear <= tFar ? tNear : float(pos_inf);
+  }
+}
+
+#endif
@@ -38,6 +38,9 @@ namespace embree
     friend class BVH4BuilderSpatial;
     friend class BVH2ToBVH4;
     friend class BVH4Traverser;
+    friend class BVH4PacketTraverser;
+    friend class BVH4Printer;
+    friend class BVHCache;
 
   public:
 
@@ -89,6 +92,7 @@ namespace embree
 
     /*! BVH4 destructor. */
     ~BVH4 () {
+      if (storage) return;
       if (nodes    ) alignedFree(nodes    ); nodes     = NULL;
       if (triangles) alignedFree(triangles); triangles = NULL;
     }
@@ -143,6 +147,7 @@ namespace embree
     int root;                          //!< Root node ID (can also be a leaf).
     Node* nodes;                       //!< Pointer to array of nodes.
     Triangle* triangles;               //!< Pointer to array of triangles.
+    Ref<RefCount> storage;             //!< Owner of nodes and triangles if the BVH did not allocate them.
 
     /*! Statistics about the BVH */
   private:
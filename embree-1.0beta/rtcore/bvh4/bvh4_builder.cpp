@@ -16,6 +16,7 @@
 
 #include "bvh4_builder.h"
 #include "../common/compute_bounds.h"
+#include "sys/parallel.h"
 
 namespace embree
 {
@@ -54,6 +55,11 @@ namespace embree
     /*! Allocate array for splitting primitive lists. 2*N required for parallel splits. */
     prims = (Box*)alignedMalloc(2*numTriangles*sizeof(Box));
 
+    /*! spread the pages of the arrays over the NUMA nodes of the build threads */
+    firstTouch(bvh->nodes,allocatedNodes*sizeof(BVH4<Triangle4>::Node));
+    firstTouch(bvh->triangles,allocatedPrimitives*sizeof(Triangle4));
+    firstTouch(prims,2*numTriangles*sizeof(Box));
+
     /*! initiate parallel computation of bounds */
     ComputeBoundsTask computeBounds(triangles,numTriangles,prims);
     computeBounds.go();
@@ -0,0 +1,254 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "bvh4_packet_traverser.h"
+
+namespace embree
+{
+  /*! Hit information of a packet in structure of arrays layout. */
+  struct Hit4
+  {
+    ssei id0;     //!< 1st primitive IDs
+    ssei id1;     //!< 2nd primitive IDs
+    ssef u;       //!< Barycentric u coordinates of hits
+    ssef v;       //!< Barycentric v coordinates of hits
+    ssef t;       //!< Distances of hits
+  };
+
+  /*! Intersects the active rays of a packet with the triangles of a
+   *  block. Each triangle is tested against all rays, with the same
+   *  arithmetic and tie breaking as Triangle4::intersect, thus a
+   *  packet finds the same hits as its rays traced one by one. */
+  static __forceinline void intersectTriangles(const sseb& active, const Ray4& ray, Hit4& hit, const Triangle4& tri)
+  {
+    const ssef tPrev = hit.t;
+    ssef bestT = zero, bestU = zero, bestV = zero;
+    ssei bestID0 = -1, bestID1 = -1;
+    sseb found = false;
+
+    for (size_t j=0; j<4; j++)
+    {
+      if (tri.id0[j] == -1) continue;
+      const sse3f v0(tri.v0.x[j],tri.v0.y[j],tri.v0.z[j]);
+      const sse3f e1(tri.e1.x[j],tri.e1.y[j],tri.e1.z[j]);
+      const sse3f e2(tri.e2.x[j],tri.e2.y[j],tri.e2.z[j]);
+      const sse3f Ng(tri.Ng.x[j],tri.Ng.y[j],tri.Ng.z[j]);
+
+      sse3f C = v0 - ray.org;
+      sse3f R = cross(ray.dir,C);
+      ssef det = dot(Ng,ray.dir);
+      ssef T = dot(Ng,C);
+      ssef U = dot(R,e2);
+      ssef V = dot(R,e1);
+      ssef absDet = abs(det);
+      ssei signDet = _mm_castps_si128(det) & ssei(0x80000000);
+      ssef _t = _mm_castsi128_ps(ssei(_mm_castps_si128(T)) ^ signDet);
+      ssef _u = _mm_castsi128_ps(ssei(_mm_castps_si128(U)) ^ signDet);
+      ssef _v = _mm_castsi128_ps(ssei(_mm_castps_si128(V)) ^ signDet);
+      ssef _w = absDet-_u-_v;
+      sseb mask = active & (det != ssef(zero)) & (_t >= absDet*ray.near) & (absDet*tPrev >= _t) & (min(_u,_v,_w) >= ssef(zero));
+      if (none(mask)) continue;
+
+      ssef rcpAbsDet = rcp(absDet);
+      ssef t = _t * rcpAbsDet;
+      mask &= (!found) | (t < bestT);
+      bestT = select(mask,t,bestT);
+      bestU = select(mask,_u * rcpAbsDet,bestU);
+      bestV = select(mask,_v * rcpAbsDet,bestV);
+      bestID0 = select(mask,ssei(tri.id0[j]),bestID0);
+      bestID1 = select(mask,ssei(tri.id1[j]),bestID1);
+      found |= mask;
+    }
+
+    if (none(found)) return;
+    hit.t   = select(found,bestT,hit.t);
+    hit.u   = select(found,bestU,hit.u);
+    hit.v   = select(found,bestV,hit.v);
+    hit.id0 = select(found,bestID0,hit.id0);
+    hit.id1 = select(found,bestID1,hit.id1);
+  }
+
+  /*! Tests the active rays of a packet for occlusion by the triangles of a block. */
+  static __forceinline sseb occludedTriangles(const sseb& active, const Ray4& ray, const Triangle4& tri)
+  {
+    sseb occluded = false;
+    for (size_t j=0; j<4; j++)
+    {
+      if (tri.id0[j] == -1) continue;
+      const sse3f v0(tri.v0.x[j],tri.v0.y[j],tri.v0.z[j]);
+      const sse3f e1(tri.e1.x[j],tri.e1.y[j],tri.e1.z[j]);
+      const sse3f e2(tri.e2.x[j],tri.e2.y[j],tri.e2.z[j]);
+      const sse3f Ng(tri.Ng.x[j],tri.Ng.y[j],tri.Ng.z[j]);
+
+      sse3f C = v0 - ray.org;
+      sse3f R = cross(ray.dir,C);
+      ssef det = dot(Ng,ray.dir);
+      ssef T = dot(Ng,C);
+      ssef U = dot(R,e2);
+      ssef V = dot(R,e1);
+      ssef absDet = abs(det);
+      ssei signDet = _mm_castps_si128(det) & ssei(0x80000000);
+      ssef _t = _mm_castsi128_ps(ssei(_mm_castps_si128(T)) ^ signDet);
+      ssef _u = _mm_castsi128_ps(ssei(_mm_castps_si128(U)) ^ signDet);
+      ssef _v = _mm_castsi128_ps(ssei(_mm_castps_si128(V)) ^ signDet);
+      ssef _w = absDet-_u-_v;
+      occluded |= active & (det != ssef(zero)) & (_t >= absDet*ray.near) & (absDet*ray.far >= _t) & (min(_u,_v,_w) >= ssef(zero));
+    }
+    return occluded;
+  }
+
+  /*! Intersects the rays of a packet with the box of the i'th child
+   *  of a node. Like the single ray traverser the near and far planes
+   *  are selected by the direction signs, so both agree on rays that
+   *  start on a box plane. Returns the mask of hitting rays and their
+   *  entry distances. */
+  static __forceinline sseb intersectBox(const BVH4<Triangle4>::Node& node, size_t i, const Ray4& ray, const ssef& rayFar, ssef& tNear)
+  {
+    const sseb posX = ray.dir.x >= ssef(zero), posY = ray.dir.y >= ssef(zero), posZ = ray.dir.z >= ssef(zero);
+    const ssef lowerX = (ssef(node.lower_x[i]) - ray.org.x) * ray.rdir.x;
+    const ssef upperX = (ssef(node.upper_x[i]) - ray.org.x) * ray.rdir.x;
+    const ssef lowerY = (ssef(node.lower_y[i]) - ray.org.y) * ray.rdir.y;
+    const ssef upperY = (ssef(node.upper_y[i]) - ray.org.y) * ray.rdir.y;
+    const ssef lowerZ = (ssef(node.lower_z[i]) - ray.org.z) * ray.rdir.z;
+    const ssef upperZ = (ssef(node.upper_z[i]) - ray.org.z) * ray.rdir.z;
+    tNear = max(select(posX,lowerX,upperX),select(posY,lowerY,upperY),select(posZ,lowerZ,upperZ),ray.near);
+    const ssef tFar = min(select(posX,upperX,lowerX),select(posY,upperY,lowerY),select(posZ,upperZ,lowerZ),rayFar);
+    return tNear <= tFar;
+  }
+
+  void BVH4PacketTraverser::intersect4(const sseb& valid, const Ray* rays, Hit* hits, int depth) const
+  {
+    /*! load the rays */
+    const Ray4 ray(rays);
+    Hit4 hit;
+    hit.t = ray.far;
+    hit.u = hit.v = zero;
+    hit.id0 = hit.id1 = -1;
+
+    /*! stack state, every node is stored with the rays that hit it and their entry distances */
+    size_t stackPtr = 1;                               //!< current stack pointer
+    int32 stackNode[1+3*BVH4<Triangle4>::maxDepth];    //!< stack of nodes that still need to get traversed
+    sseb stackMask[1+3*BVH4<Triangle4>::maxDepth];     //!< rays that hit the stacked nodes
+    ssef stackNear[1+3*BVH4<Triangle4>::maxDepth];     //!< entry distances of the rays into the stacked nodes
+    stackNode[0] = bvh->root;
+    stackMask[0] = valid;
+    stackNear[0] = ray.near;
+    const BVH4<Triangle4>::Node* nodes = bvh->nodes;
+
+    while (stackPtr)
+    {
+      /*! pop next node, rays that hit something closer in the meantime become inactive */
+      stackPtr--;
+      int32 cur = stackNode[stackPtr];
+      sseb active = stackMask[stackPtr] & (stackNear[stackPtr] <= hit.t);
+      if (none(active)) continue;
+
+      /*! descend into the closest child as long as some ray hits one */
+      while (cur >= 0)
+      {
+        const BVH4<Triangle4>::Node& node = bvh->node(nodes,cur);
+        int32 next = BVH4<Triangle4>::emptyNode;
+        sseb nextMask = false;
+        ssef nextNear = zero;
+        float nextDist = 0.0f;
+
+        for (size_t i=0; i<4; i++)
+        {
+          const int32 child = node.child[i];
+          if (child == int32(BVH4<Triangle4>::emptyNode)) continue;
+          ssef tNear; const sseb mask = active & intersectBox(node,i,ray,hit.t,tNear);
+          if (none(mask)) continue;
+          const size_t m = movemask(mask);
+          float dist = tNear[__bsf(m)];
+          for (size_t k=0; k<4; k++) if ((m >> k) & 1) dist = std::min(dist,tNear[k]);
+
+          /*! keep the closest child, push the others */
+          if (next == int32(BVH4<Triangle4>::emptyNode) || dist < nextDist) {
+            if (next != int32(BVH4<Triangle4>::emptyNode)) {
+              stackNode[stackPtr] = next; stackMask[stackPtr] = nextMask; stackNear[stackPtr] = nextNear; stackPtr++;
+            }
+            next = child; nextMask = mask; nextNear = tNear; nextDist = dist;
+          }
+          else {
+            stackNode[stackPtr] = child; stackMask[stackPtr] = mask; stackNear[stackPtr] = tNear; stackPtr++;
+          }
+        }
+        if (next == int32(BVH4<Triangle4>::emptyNode)) break;
+        cur = next;
+        active = nextMask;
+      }
+      if (cur >= 0) continue;
+
+      /*! this is a leaf node */
+      cur ^= 0x80000000;
+      const size_t ofs = size_t(cur) >> 5;
+      const size_t num = size_t(cur) & 0x1F;
+      for (size_t i=ofs; i<ofs+num; i++) intersectTriangles(active,ray,hit,bvh->triangles[i]);
+    }
+
+    /*! store the hits of the valid rays */
+    for (size_t i=0; i<4; i++) {
+      if (!valid[i]) continue;
+      hits[i].t = hit.t[i];
+      if (hit.id0[i] == -1) continue;
+      hits[i].u = hit.u[i];
+      hits[i].v = hit.v[i];
+      hits[i].id0 = hit.id0[i];
+      hits[i].id1 = hit.id1[i];
+    }
+  }
+
+  sseb BVH4PacketTraverser::occluded4(const sseb& valid, const Ray* rays, int depth) const
+  {
+    /*! load the rays, invalid rays count as terminated */
+    const Ray4 ray(rays);
+    sseb terminated = !valid;
+
+    /*! stack state */
+    size_t stackPtr = 1;                               //!< current stack pointer
+    int32 stack[1+3*BVH4<Triangle4>::maxDepth];        //!< stack of nodes that still need to get traversed
+    stack[0] = bvh->root;
+    const BVH4<Triangle4>::Node* nodes = bvh->nodes;
+
+    while (stackPtr--)
+    {
+      int32 cur = stack[stackPtr];
+
+      /*! this is an inner node, push all children hit by an active ray */
+      if (__builtin_expect(cur >= 0, true))
+      {
+        const BVH4<Triangle4>::Node& node = bvh->node(nodes,cur);
+        for (size_t i=0; i<4; i++) {
+          const int32 child = node.child[i];
+          if (child == int32(BVH4<Triangle4>::emptyNode)) continue;
+          ssef tNear; if (any((!terminated) & intersectBox(node,i,ray,ray.far,tNear))) stack[stackPtr++] = child;
+        }
+      }
+
+      /*! this is a leaf node */
+      else {
+        cur ^= 0x80000000;
+        const size_t ofs = size_t(cur) >> 5;
+        const size_t num = size_t(cur) & 0x1F;
+        for (size_t i=ofs; i<ofs+num; i++) {
+          terminated |= occludedTriangles(!terminated,ray,bvh->triangles[i]);
+          if (all(terminated)) return valid;
+        }
+      }
+    }
+    return valid & terminated;
+  }
+}
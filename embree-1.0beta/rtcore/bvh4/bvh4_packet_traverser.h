@@ -0,0 +1,42 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#ifndef __EMBREE_BVH4_PACKET_TRAVERSER_H__
+#define __EMBREE_BVH4_PACKET_TRAVERSER_H__
+
+#include "bvh4_traverser.h"
+#include "../ray4.h"
+
+namespace embree
+{
+  /*! BVH4 Packet Traverser. Traverses packets of 4 rays through a
+   *  Quad BVH. The rays of a packet test the children of a node
+   *  together and descend as long as one ray is active, thus coherent
+   *  rays like primary rays or shadow rays towards a light share the
+   *  node fetches. Single rays use the BVH4Traverser. */
+  class BVH4PacketTraverser : public BVH4Traverser
+  {
+  public:
+
+    /*! Constructs the traverser from a BVH. */
+    BVH4PacketTraverser (const Ref<BVH4<Triangle4> >& bvh) : BVH4Traverser(bvh) {}
+
+    void intersect4(const sseb& valid, const Ray* rays, Hit* hits, int depth) const;
+    sseb occluded4(const sseb& valid, const Ray* rays, int depth) const;
+  };
+}
+
+#endif
@@ -15,25 +15,31 @@
 // ======================================================================== //
 
 #include "bvh4_traverser.h"
-#include "../common/stack_item.h"
 
 namespace embree
 {
-  void BVH4Traverser::intersect(const Ray& ray, Hit& hit, int depth) const
+  /*! offsets to select the side that becomes the lower or upper bound */
+  __forceinline BVH4Traverser::Octant::Octant (size_t octant)
+  {
+    nearX = octant & 1 ? 1*sizeof(ssef) : 0*sizeof(ssef);
+    nearY = octant & 2 ? 3*sizeof(ssef) : 2*sizeof(ssef);
+    nearZ = octant & 4 ? 5*sizeof(ssef) : 4*sizeof(ssef);
+    farX  = nearX ^ 16;
+    farY  = nearY ^ 16;
+    farZ  = nearZ ^ 16;
+  }
+
+  __forceinline void BVH4Traverser::intersectRay(const Ray& ray, Hit& hit, const Octant& octant, StackItem* stack) const
   {
     /*! stack state */
     size_t stackPtr = 1;                             //!< current stack pointer
     int32 popCur  = bvh->root;                       //!< pre-popped top node from the stack
     float popDist = neg_inf;                         //!< pre-popped distance of top node from the stack
-    StackItem stack[1+3*BVH4<Triangle4>::maxDepth];  //!< stack of nodes that still need to get traversed
 
-    /*! offsets to select the side that becomes the lower or upper bound */
-    const size_t nearX = ray.dir.x >= 0 ? 0*sizeof(ssef) : 1*sizeof(ssef);
-    const size_t nearY = ray.dir.y >= 0 ? 2*sizeof(ssef) : 3*sizeof(ssef);
-    const size_t nearZ = ray.dir.z >= 0 ? 4*sizeof(ssef) : 5*sizeof(ssef);
-    const size_t farX  = nearX ^ 16;
-    const size_t farY  = nearY ^ 16;
-    const size_t farZ  = nearZ ^ 16;
+    /*! offsets of the octant */
+    const size_t nearX = octant.nearX, farX = octant.farX;
+    const size_t nearY = octant.nearY, farY = octant.farY;
+    const size_t nearZ = octant.nearZ, farZ = octant.farZ;
 
     /*! load the ray into SIMD registers */
     const sse3f norg(-ray.org.x,-ray.org.y,-ray.org.z);
@@ -131,20 +137,16 @@ namespace embree
     }
   }
 
-  bool BVH4Traverser::occluded(const Ray& ray, int depth) const
+  __forceinline bool BVH4Traverser::occludedRay(const Ray& ray, const Octant& octant, int* stack) const
   {
     /*! stack state */
     size_t stackPtr = 1;                       //!< current stack pointer
-    int stack[1+3*BVH4<Triangle4>::maxDepth];  //!< stack of nodes that still need to get traversed
     stack[0] = bvh->root;                      //!< push first node onto stack
 
-    /*! offsets to select the side that becomes the lower or upper bound */
-    const size_t nearX = (ray.dir.x >= 0) ? 0*sizeof(ssef) : 1*sizeof(ssef);
-    const size_t nearY = (ray.dir.y >= 0) ? 2*sizeof(ssef) : 3*sizeof(ssef);
-    const size_t nearZ = (ray.dir.z >= 0) ? 4*sizeof(ssef) : 5*sizeof(ssef);
-    const size_t farX  = nearX ^ 16;
-    const size_t farY  = nearY ^ 16;
-    const size_t farZ  = nearZ ^ 16;
+    /*! offsets of the octant */
+    const size_t nearX = octant.nearX, farX = octant.farX;
+    const size_t nearY = octant.nearY, farY = octant.farY;
+    const size_t nearZ = octant.nearZ, farZ = octant.farZ;
 
     /*! load the ray into SIMD registers */
     const sse3f norg(-ray.org.x,-ray.org.y,-ray.org.z);
@@ -200,4 +202,43 @@ namespace embree
     }
     return false;
   }
+
+  void BVH4Traverser::intersect(const Ray& ray, Hit& hit, int depth) const
+  {
+    StackItem stack[1+3*BVH4<Triangle4>::maxDepth];  //!< stack of nodes that still need to get traversed
+    intersectRay(ray,hit,Octant(dirOctant(ray.dir)),stack);
+  }
+
+  bool BVH4Traverser::occluded(const Ray& ray, int depth) const
+  {
+    int stack[1+3*BVH4<Triangle4>::maxDepth];  //!< stack of nodes that still need to get traversed
+    return occludedRay(ray,Octant(dirOctant(ray.dir)),stack);
+  }
+
+  void BVH4Traverser::intersectRun(size_t octant, const RayStreamSoA& rays, const size_t* order, size_t num, HitStreamSoA& hits) const
+  {
+    StackItem stack[1+3*BVH4<Triangle4>::maxDepth];  //!< stack of nodes that still need to get traversed
+    const Octant setup(octant);
+    for (size_t i=0; i<num; i++) {
+      Hit hit; hit.u = hit.v = 0.0f;
+      intersectRay(rays.get(order[i]),hit,setup,stack);
+      hits.set(order[i],hit);
+    }
+  }
+
+  void BVH4Traverser::occludedRun(size_t octant, const RayStreamSoA& rays, const size_t* order, size_t num, bool* occluded) const
+  {
+    int stack[1+3*BVH4<Triangle4>::maxDepth];  //!< stack of nodes that still need to get traversed
+    const Octant setup(octant);
+    for (size_t i=0; i<num; i++)
+      occluded[order[i]] = occludedRay(rays.get(order[i]),setup,stack);
+  }
+
+  void BVH4Traverser::intersectN(const RayStreamSoA& rays, HitStreamSoA& hits, size_t n, int depth) const {
+    intersectStream(*this,rays,hits,n);
+  }
+
+  void BVH4Traverser::occludedN(const RayStreamSoA& rays, bool* occluded, size_t n, int depth) const {
+    occludedStream(*this,rays,occluded,n);
+  }
 }
@@ -74,8 +74,8 @@ namespace embree
       hit.id1 = id1[tri];
     }
 
-    /*! Test if the ray is occluded by one of the triangles. */
-    __forceinline bool occluded(const Ray& ray) const
+    /*! Returns the mask of the triangles that intersect the ray segment. */
+    __forceinline sseb hits(const Ray& ray) const
     {
       sse3f O = sse3f(ray.org);
       sse3f D = sse3f(ray.dir);
@@ -91,8 +91,12 @@ namespace embree
       ssef _u = _mm_castsi128_ps(ssei(_mm_castps_si128(U)) ^ signDet);
       ssef _v = _mm_castsi128_ps(ssei(_mm_castps_si128(V)) ^ signDet);
       ssef _w = absDet-_u-_v;
-      sseb hit = valid() & (det != ssef(zero)) & (_t >= absDet*ssef(ray.near)) & (absDet*ssef(ray.far) >= _t) & (min(_u,_v,_w) >= ssef(zero));
-      return any(hit);
+      return valid() & (det != ssef(zero)) & (_t >= absDet*ssef(ray.near)) & (absDet*ssef(ray.far) >= _t) & (min(_u,_v,_w) >= ssef(zero));
+    }
+
+    /*! Test if the ray is occluded by one of the triangles. */
+    __forceinline bool occluded(const Ray& ray) const {
+      return any(hits(ray));
     }
 
   public:
@@ -0,0 +1,69 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "bvh8.h"
+#include "triangle8.h"
+
+#if defined(__AVX__)
+
+namespace embree
+{
+  template<typename T>
+  void BVH8<T>::computeStatistics()
+  {
+    if (modified) {
+      numNodes = 0;
+      numLeaves = 0;
+      numPrimBlocks = 0;
+      numPrims = 0;
+      bvhSAH = computeStatistics(root,0.0f);
+      modified = false;
+    }
+  }
+
+  template<typename T>
+  float BVH8<T>::computeStatistics(int nodeID, float ap)
+  {
+    if (nodeID >= 0)
+    {
+      numNodes++;
+      const Node& n = node(nodeID);
+      avxf ac = 2.0f*((n.upper_x-n.lower_x)*(n.upper_y-n.lower_y+n.upper_z-n.lower_z)+(n.upper_y-n.lower_y)*(n.upper_z-n.lower_z));
+      float sah = ap*travCost;
+      for (size_t i=0; i<8; i++) sah += computeStatistics(n.child[i],ac[i]);
+      return sah;
+    }
+    else
+    {
+      nodeID ^= 0x80000000;
+      size_t ofs = size_t(nodeID) >> 5;
+      size_t num = size_t(nodeID) & 0x1F;
+      if (!num) return 0.0f;
+
+      numLeaves++;
+      numPrimBlocks += num;
+      for (size_t i=ofs; i<ofs+num; i++)
+        numPrims += triangles[i].size();
+      return intCost * ap * num;
+    }
+  }
+
+  /*! explicit template instantiations */
+  template class BVH8<Triangle8>;
+}
+
+#endif
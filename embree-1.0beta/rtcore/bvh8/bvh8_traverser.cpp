@@ -0,0 +1,216 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "bvh8_traverser.h"
+#include "../bvh2/bvh2_to_bvh8.h"
+#include "../common/stack_item.h"
+
+#if defined(__AVX__)
+
+namespace embree
+{
+  /*! Sorts the last n stack items such that the closest one is on top. */
+  static __forceinline void sort(StackItem* begin, size_t n)
+  {
+    for (size_t i=1; i<n; i++) {
+      StackItem item = begin[i];
+      size_t j = i;
+      for (; j>0 && begin[j-1].all < item.all; j--) begin[j] = begin[j-1];
+      begin[j] = item;
+    }
+  }
+
+  void BVH8Traverser::intersect(const Ray& ray, Hit& hit, int depth) const
+  {
+    /*! stack state */
+    size_t stackPtr = 1;                             //!< current stack pointer
+    int32 popCur  = bvh->root;                       //!< pre-popped top node from the stack
+    float popDist = neg_inf;                         //!< pre-popped distance of top node from the stack
+    StackItem stack[1+7*BVH8<Triangle8>::maxDepth];  //!< stack of nodes that still need to get traversed
+
+    /*! offsets to select the side that becomes the lower or upper bound */
+    const size_t nearX = ray.dir.x >= 0 ? 0*sizeof(avxf) : 1*sizeof(avxf);
+    const size_t nearY = ray.dir.y >= 0 ? 2*sizeof(avxf) : 3*sizeof(avxf);
+    const size_t nearZ = ray.dir.z >= 0 ? 4*sizeof(avxf) : 5*sizeof(avxf);
+    const size_t farX  = nearX ^ sizeof(avxf);
+    const size_t farY  = nearY ^ sizeof(avxf);
+    const size_t farZ  = nearZ ^ sizeof(avxf);
+
+    /*! load the ray into SIMD registers */
+    const avx3f norg(-ray.org.x,-ray.org.y,-ray.org.z);
+    const avx3f rdir(ray.rdir.x,ray.rdir.y,ray.rdir.z);
+    const avxf rayNear(ray.near);
+    avxf rayFar(ray.far);
+    hit.t = ray.far;
+    const BVH8<Triangle8>::Node* nodes = bvh->nodes;
+
+    while (true)
+    {
+      /*! pop next node */
+      if (__builtin_expect(stackPtr == 0, false)) break;
+      stackPtr--;
+      int32 cur = popCur;
+
+      /*! if popped node is too far, pop next one */
+      if (__builtin_expect(popDist > hit.t, false)) {
+        popCur  = stack[stackPtr-1].ofs;
+        popDist = stack[stackPtr-1].dist;
+        continue;
+      }
+
+    next:
+
+      /*! we mostly go into the inner node case */
+      if (__builtin_expect(cur >= 0, true))
+      {
+        /*! single ray intersection with 8 boxes */
+        const BVH8<Triangle8>::Node& node = bvh->node(nodes,cur);
+        const char* base = (const char*)nodes+BVH8<Triangle8>::offsetFactor*size_t(cur);
+        const avxf tNearX = (norg.x + *(avxf*)(base+nearX)) * rdir.x;
+        const avxf tNearY = (norg.y + *(avxf*)(base+nearY)) * rdir.y;
+        const avxf tNearZ = (norg.z + *(avxf*)(base+nearZ)) * rdir.z;
+        const avxf tNear = max(tNearX,tNearY,tNearZ,rayNear);
+        const avxf tFarX = (norg.x + *(avxf*)(base+farX)) * rdir.x;
+        const avxf tFarY = (norg.y + *(avxf*)(base+farY)) * rdir.y;
+        const avxf tFarZ = (norg.z + *(avxf*)(base+farZ)) * rdir.z;
+        popCur = stack[stackPtr-1].ofs;      //!< pre-pop of topmost stack item
+        popDist = stack[stackPtr-1].dist;    //!< pre-pop of distance of topmost stack item
+        const avxf tFar = min(tFarX,tFarY,tFarZ,rayFar);
+        size_t _hit = movemask(tNear <= tFar);
+
+        /*! if no child is hit, pop next node */
+        if (__builtin_expect(_hit == 0, false))
+          continue;
+
+        /*! one child is hit, continue with that child */
+        size_t r = __bsf(_hit); _hit = __btc(_hit,r);
+        if (__builtin_expect(_hit == 0, true)) {
+          cur = node.child[r];
+          goto next;
+        }
+
+        /*! two children are hit, push far child, and continue with closer child */
+        const int32 c0 = node.child[r]; const float d0 = tNear[r];
+        r = __bsf(_hit); _hit = __btc(_hit,r);
+        const int32 c1 = node.child[r]; const float d1 = tNear[r];
+        if (__builtin_expect(_hit == 0, true)) {
+          if (d0 < d1) { stack[stackPtr].ofs = c1; stack[stackPtr++].dist = d1; cur = c0; goto next; }
+          else         { stack[stackPtr].ofs = c0; stack[stackPtr++].dist = d0; cur = c1; goto next; }
+        }
+
+        /*! Three or more children are hit, push all onto the stack,
+         *  sort them there and continue with the closest child. */
+        StackItem* first = &stack[stackPtr];
+        stack[stackPtr].ofs = c0; stack[stackPtr++].dist = d0;
+        stack[stackPtr].ofs = c1; stack[stackPtr++].dist = d1;
+        do {
+          r = __bsf(_hit); _hit = __btc(_hit,r);
+          stack[stackPtr].ofs = node.child[r]; stack[stackPtr++].dist = tNear[r];
+        } while (_hit);
+        sort(first,&stack[stackPtr]-first);
+        cur = stack[stackPtr-1].ofs; stackPtr--;
+        goto next;
+      }
+
+      /*! this is a leaf node */
+      else {
+        cur ^= 0x80000000;
+        const size_t ofs = size_t(cur) >> 5;
+        const size_t num = size_t(cur) & 0x1F;
+        for (size_t i=ofs; i<ofs+num; i++) bvh->triangles[i].intersect(ray,hit);
+        popCur = stack[stackPtr-1].ofs;    //!< pre-pop of topmost stack item
+        popDist = stack[stackPtr-1].dist;  //!< pre-pop of distance of topmost stack item
+        rayFar = hit.t;
+      }
+    }
+  }
+
+  bool BVH8Traverser::occluded(const Ray& ray, int depth) const
+  {
+    /*! stack state */
+    size_t stackPtr = 1;                       //!< current stack pointer
+    int stack[1+7*BVH8<Triangle8>::maxDepth];  //!< stack of nodes that still need to get traversed
+    stack[0] = bvh->root;                      //!< push first node onto stack
+
+    /*! offsets to select the side that becomes the lower or upper bound */
+    const size_t nearX = (ray.dir.x >= 0) ? 0*sizeof(avxf) : 1*sizeof(avxf);
+    const size_t nearY = (ray.dir.y >= 0) ? 2*sizeof(avxf) : 3*sizeof(avxf);
+    const size_t nearZ = (ray.dir.z >= 0) ? 4*sizeof(avxf) : 5*sizeof(avxf);
+    const size_t farX  = nearX ^ sizeof(avxf);
+    const size_t farY  = nearY ^ sizeof(avxf);
+    const size_t farZ  = nearZ ^ sizeof(avxf);
+
+    /*! load the ray into SIMD registers */
+    const avx3f norg(-ray.org.x,-ray.org.y,-ray.org.z);
+    const avx3f rdir(ray.rdir.x,ray.rdir.y,ray.rdir.z);
+    const avxf rayNear(ray.near);
+    const avxf rayFar(ray.far);
+    const BVH8<Triangle8>::Node* nodes = bvh->nodes;
+
+    /*! pop node from stack */
+    while (stackPtr--)
+    {
+      int32 cur = stack[stackPtr];
+
+      /*! this is an inner node, push all hit children */
+      if (__builtin_expect(cur >= 0, true))
+      {
+        /*! single ray intersection with 8 boxes */
+        const BVH8<Triangle8>::Node& node = bvh->node(nodes,cur);
+        const char* base = (const char*)nodes+BVH8<Triangle8>::offsetFactor*size_t(cur);
+        const avxf tNearX = (norg.x + *(avxf*)(base+nearX)) * rdir.x;
+        const avxf tNearY = (norg.y + *(avxf*)(base+nearY)) * rdir.y;
+        const avxf tNearZ = (norg.z + *(avxf*)(base+nearZ)) * rdir.z;
+        const avxf tNear = max(tNearX,tNearY,tNearZ,rayNear);
+        const avxf tFarX = (norg.x + *(avxf*)(base+farX)) * rdir.x;
+        const avxf tFarY = (norg.y + *(avxf*)(base+farY)) * rdir.y;
+        const avxf tFarZ = (norg.z + *(avxf*)(base+farZ)) * rdir.z;
+        const avxf tFar = min(tFarX,tFarY,tFarZ,rayFar);
+        size_t _hit = movemask(tNear <= tFar);
+        while (_hit) {
+          size_t r = __bsf(_hit); _hit = __btc(_hit,r);
+          stack[stackPtr++] = node.child[r];
+        }
+      }
+
+      /*! this is a leaf node */
+      else {
+        cur ^= 0x80000000;
+        const size_t ofs = size_t(cur) >> 5;
+        const size_t num = size_t(cur) & 0x1F;
+        for (size_t i=ofs; i<ofs+num; i++)
+          if (bvh->triangles[i].occluded(ray))
+            return true;
+      }
+    }
+    return false;
+  }
+}
+
+#endif
+
+namespace embree
+{
+  Intersector* createBVH8Traverser(const Ref<BVH2<Triangle4> >& bvh2)
+  {
+#if defined(__AVX__)
+    return new BVH8Traverser(BVH2ToBVH8::convert(bvh2));
+#else
+    return NULL;
+#endif
+  }
+}
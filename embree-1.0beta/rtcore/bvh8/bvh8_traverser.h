@@ -0,0 +1,59 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef __EMBREE_BVH8_TRAVERSER_H__
+#define __EMBREE_BVH8_TRAVERSER_H__
+
+#include "bvh8.h"
+#include "triangle8.h"
+#include "../bvh2/bvh2.h"
+#include "../bvh4/triangle4.h"
+
+namespace embree
+{
+  /*! Collapses a BVH2 into a BVH8 and creates a traverser for it. The
+   *  BVH8 sources are the only ones compiled with AVX, thus callers
+   *  have to check hasAVX() first. Returns NULL if the sources got
+   *  compiled without AVX. */
+  Intersector* createBVH8Traverser(const Ref<BVH2<Triangle4> >& bvh2);
+}
+
+#if defined(__AVX__)
+
+namespace embree
+{
+  /*! BVH8 Traverser. Single ray traversal implementation for an 8
+   *  wide BVH that intersects the ray with all 8 child boxes of a
+   *  node in one AVX operation. */
+  class BVH8Traverser : public Intersector
+  {
+  public:
+
+    /*! Constructs the traverser from a BVH. */
+    BVH8Traverser (const Ref<BVH8<Triangle8> >& bvh) : bvh(bvh) {}
+
+    void intersect(const Ray& ray, Hit& hit, int depth) const;
+    bool occluded (const Ray& ray, int depth) const;
+
+  protected:
+    Ref<BVH8<Triangle8> > bvh; //!< BVH to traverse
+  };
+}
+
+#endif
+
+#endif
@@ -0,0 +1,113 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef __EMBREE_ACCEL_TRIANGLE8_H__
+#define __EMBREE_ACCEL_TRIANGLE8_H__
+
+#include "../ray.h"
+#include "../hit.h"
+
+#if defined(__AVX__)
+
+namespace embree
+{
+  /*! Intersector for 8 triangles. Same modified Moeller Trumbore
+   *  intersector as Triangle4, but operating on 8 triangles in AVX
+   *  registers. */
+  struct Triangle8
+  {
+    /*! Default constructor. */
+    __forceinline Triangle8 () {}
+
+    /*! Construction from vertices and IDs. */
+    __forceinline Triangle8 (const avx3f& v0, const avx3f& v1, const avx3f& v2, const avxi& id0, const avxi& id1)
+      : v0(v0), e1(v0-v1), e2(v2-v0), Ng(cross(e1,e2)), id0(id0), id1(id1) {}
+
+    /*! Returns a mask that tells which triangles are valid. */
+    __forceinline avxb valid() const { return id0 != avxi(-1); }
+
+    /*! Returns the number of stored triangles. */
+    __forceinline size_t size() const {
+      size_t r = 0; for (size_t i=0; i<8; i++) if (valid()[i]) r++; return r;
+    }
+
+    /*! Intersect a ray with the 8 triangles and updates the hit. */
+    __forceinline void intersect(const Ray& ray, Hit& hit) const
+    {
+      avx3f O = avx3f(ray.org.x,ray.org.y,ray.org.z);
+      avx3f D = avx3f(ray.dir.x,ray.dir.y,ray.dir.z);
+      avx3f C = v0 - O;
+      avx3f R = cross(D,C);
+      avxf det = dot(Ng,D);
+      avxf T = dot(Ng,C);
+      avxf U = dot(R,e2);
+      avxf V = dot(R,e1);
+      avxf absDet = abs(det);
+      avxf signDet = _mm256_and_ps(det,_mm256_castsi256_ps(avxi(0x80000000)));
+      avxf _t = _mm256_xor_ps(T,signDet);
+      avxf _u = _mm256_xor_ps(U,signDet);
+      avxf _v = _mm256_xor_ps(V,signDet);
+      avxf _w = absDet-_u-_v;
+      avxb mask = valid() & (det != avxf(zero)) & (_t >= absDet*avxf(ray.near)) & (absDet*avxf(hit.t) >= _t) & (min(_u,_v,_w) >= avxf(zero));
+      if (none(mask)) return;
+      avxf rcpAbsDet = rcp(absDet);
+      avxf t = _t * rcpAbsDet;
+      avxf u = _u * rcpAbsDet;
+      avxf v = _v * rcpAbsDet;
+      avxf __t = select(mask,t,avxf(inf));
+      size_t tri = __bsf(movemask(__t == reduce_min(__t)));
+      hit.t = t[tri];
+      hit.u = u[tri];
+      hit.v = v[tri];
+      hit.id0 = id0[tri];
+      hit.id1 = id1[tri];
+    }
+
+    /*! Test if the ray is occluded by one of the triangles. */
+    __forceinline bool occluded(const Ray& ray) const
+    {
+      avx3f O = avx3f(ray.org.x,ray.org.y,ray.org.z);
+      avx3f D = avx3f(ray.dir.x,ray.dir.y,ray.dir.z);
+      avx3f C = v0 - O;
+      avx3f R = cross(D,C);
+      avxf det = dot(Ng,D);
+      avxf T = dot(Ng,C);
+      avxf U = dot(R,e2);
+      avxf V = dot(R,e1);
+      avxf absDet = abs(det);
+      avxf signDet = _mm256_and_ps(det,_mm256_castsi256_ps(avxi(0x80000000)));
+      avxf _t = _mm256_xor_ps(T,signDet);
+      avxf _u = _mm256_xor_ps(U,signDet);
+      avxf _v = _mm256_xor_ps(V,signDet);
+      avxf _w = absDet-_u-_v;
+      avxb hit = valid() & (det != avxf(zero)) & (_t >= absDet*avxf(ray.near)) & (absDet*avxf(ray.far) >= _t) & (min(_u,_v,_w) >= avxf(zero));
+      return any(hit);
+    }
+
+  public:
+    avx3f v0;      //!< Base vertex of the triangles.
+    avx3f e1;      //!< 1st edge of the triangles (v0-v1).
+    avx3f e2;      //!< 2nd edge of the triangles (v2-v0).
+    avx3f Ng;      //!< Geometry normal of the triangles.
+    avxi id0;      //!< 1st user ID.
+    avxi id1;      //!< 2nd user ID.
+  };
+}
+
+#endif
+
+#endif
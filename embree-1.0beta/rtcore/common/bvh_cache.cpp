@@ -0,0 +1,192 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "bvh_cache.h"
+#include "sys/mapping.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace embree
+{
+  /*! Alignment of the arrays inside a cache file. */
+  static const size_t cacheAlignment = 64;
+
+  /*! Rounds a file offset up to the alignment of the arrays. */
+  static __forceinline size_t alignCacheOffset(size_t ofs) {
+    return (ofs+cacheAlignment-1) & ~(cacheAlignment-1);
+  }
+
+  /*! Writes zeros up to the given file offset. */
+  static bool padCacheFile(FILE* file, size_t ofs)
+  {
+    static const char zeros[cacheAlignment] = { 0 };
+    const size_t pos = size_t(ftell(file));
+    return pos == ofs || fwrite(zeros,ofs-pos,1,file) == 1;
+  }
+
+  /*! Keeps the mapping of a cache file alive while a BVH references it. */
+  class MappedBVHFile : public RefCount
+  {
+  public:
+    MappedBVHFile (mapping_t mapping) : mapping(mapping) {}
+    ~MappedBVHFile () { unmapFile(mapping); }
+  public:
+    mapping_t mapping;   //!< Mapping of the cache file.
+  };
+
+  template<typename BVH>
+    void BVHCache::countArrays(const BVH& bvh, int nodeID, size_t& numNodes, size_t& numBlocks)
+  {
+    if (nodeID >= 0) {
+      const typename BVH::Node& node = bvh.node(size_t(nodeID));
+      numNodes = max(numNodes,size_t(nodeID)*BVH::offsetFactor/sizeof(typename BVH::Node)+1);
+      for (size_t i=0; i<sizeof(node.child)/sizeof(int32); i++)
+        countArrays(bvh,node.child[i],numNodes,numBlocks);
+    }
+    else {
+      const size_t leafID = size_t(nodeID ^ 0x80000000);
+      const size_t ofs = leafID >> 5, num = leafID & 0x1F;
+      if (num) numBlocks = max(numBlocks,ofs+num);
+    }
+  }
+
+  uint64 BVHCache::hash(const BuildTriangle* triangles, size_t numTriangles)
+  {
+    /*! FNV-1a over the 4 byte fields, the triangles contain no padding */
+    const uint32* words = (const uint32*) triangles;
+    const size_t numWords = numTriangles*sizeof(BuildTriangle)/sizeof(uint32);
+    uint64 h = 0xcbf29ce484222325ULL;
+    for (size_t i=0; i<numWords; i++) {
+      h ^= words[i];
+      h *= 0x100000001b3ULL;
+    }
+    return h;
+  }
+
+  BVHCache::BVHCache(const FileName& directory, const char* type, const BuildTriangle* triangles, size_t numTriangles)
+    : type(type), triangleHash(hash(triangles,numTriangles)), numTriangles(numTriangles)
+  {
+    if (this->type.size() >= BVHCacheHeader::maxTypeLength)
+      throw std::runtime_error("acceleration structure type too long for bvh cache: "+this->type);
+
+    char name[64];
+    sprintf(name,"_%016llx.bvh",(unsigned long long)triangleHash);
+    fileName = directory + FileName(this->type + name);
+  }
+
+  bool BVHCache::cacheable(const char* type)
+  {
+    static const char* uncached[] = { "bvh2.srdh", "bvh2.rbvh", "bvh2.srdh.rbvh", "bvh2.import", "bvh4.srdh", "bvh4.import" };
+    for (size_t i=0; i<sizeof(uncached)/sizeof(uncached[0]); i++)
+      if (!strcmp(type,uncached[i])) return false;
+    return true;
+  }
+
+  Ref<BVH2<Triangle4> > BVHCache::loadBVH2() { return loadBVH<BVH2<Triangle4> >(); }
+  Ref<BVH4<Triangle4> > BVHCache::loadBVH4() { return loadBVH<BVH4<Triangle4> >(); }
+  void BVHCache::store(const Ref<BVH2<Triangle4> >& bvh) { storeBVH<BVH2<Triangle4> >(bvh); }
+  void BVHCache::store(const Ref<BVH4<Triangle4> >& bvh) { storeBVH<BVH4<Triangle4> >(bvh); }
+
+  template<typename BVH>
+    Ref<BVH> BVHCache::loadBVH()
+  {
+    /*! a missing file is the normal case of the first run */
+    FILE* file = fopen(fileName.c_str(),"rb");
+    if (!file) return NULL;
+    fclose(file);
+
+    double t0 = getSeconds();
+    mapping_t mapping = NULL;
+    try { mapping = mapFile(fileName); }
+    catch (const std::runtime_error& e) {
+      std::cerr << "Warning: ignoring bvh cache: " << e.what() << std::endl;
+      return NULL;
+    }
+    Ref<MappedBVHFile> storage = new MappedBVHFile(mapping);
+    const char* data = mappedData(mapping);
+    const size_t bytes = mappedSize(mapping);
+
+    const BVHCacheHeader& header = *(const BVHCacheHeader*)data;
+    if (bytes < sizeof(BVHCacheHeader) ||
+        header.magic != BVHCacheHeader::MAGIC || header.version != BVHCacheHeader::VERSION ||
+        strncmp(header.type,type.c_str(),BVHCacheHeader::maxTypeLength) != 0 ||
+        header.hash != triangleHash || header.numTriangles != int64(numTriangles) ||
+        header.nodeSize != int32(sizeof(typename BVH::Node)) || header.triangleSize != int32(sizeof(typename BVH::Triangle)) ||
+        header.nodeOffset < int64(sizeof(BVHCacheHeader)) || header.nodeOffset % cacheAlignment ||
+        header.triangleOffset < int64(sizeof(BVHCacheHeader)) || header.triangleOffset % cacheAlignment ||
+        uint64(header.nodeOffset) + uint64(header.numNodes)*sizeof(typename BVH::Node) > bytes ||
+        uint64(header.triangleOffset) + uint64(header.numTriangleBlocks)*sizeof(typename BVH::Triangle) > bytes)
+    {
+      std::cerr << "Warning: ignoring invalid bvh cache file " << fileName.str() << std::endl;
+      return NULL;
+    }
+
+    Ref<BVH> bvh = new BVH;
+    bvh->storage = storage.cast<RefCount>();
+    bvh->root = header.root;
+    bvh->nodes = (typename BVH::Node*)(data+header.nodeOffset);
+    bvh->triangles = (typename BVH::Triangle*)(data+header.triangleOffset);
+    double t1 = getSeconds();
+
+    std::cout << "triangles = " << numTriangles << ", load time = " << (t1-t0)*1000.0f << "ms, "
+              << "size = " << (bytes)*1E-6 << " MB, cache = " << fileName.str() << std::endl;
+    return bvh;
+  }
+
+  template<typename BVH>
+    void BVHCache::storeBVH(const Ref<BVH>& bvh)
+  {
+    size_t numNodes = 0, numBlocks = 0;
+    countArrays(*bvh,bvh->root,numNodes,numBlocks);
+
+    BVHCacheHeader header;
+    memset(&header,0,sizeof(header));
+    header.magic = BVHCacheHeader::MAGIC;
+    header.version = BVHCacheHeader::VERSION;
+    strncpy(header.type,type.c_str(),BVHCacheHeader::maxTypeLength-1);
+    header.hash = triangleHash;
+    header.numTriangles = int64(numTriangles);
+    header.nodeSize = int32(sizeof(typename BVH::Node));
+    header.triangleSize = int32(sizeof(typename BVH::Triangle));
+    header.root = bvh->root;
+    header.nodeOffset = int64(alignCacheOffset(sizeof(BVHCacheHeader)));
+    header.numNodes = int64(numNodes);
+    header.triangleOffset = int64(alignCacheOffset(size_t(header.nodeOffset)+numNodes*sizeof(typename BVH::Node)));
+    header.numTriangleBlocks = int64(numBlocks);
+
+    /*! write to a temporary file first, thus concurrent runs never see a partial file */
+    const FileName tmpName = fileName.str() + ".tmp";
+    FILE* file = fopen(tmpName.c_str(),"wb");
+    if (!file) {
+      std::cerr << "Warning: cannot write bvh cache file " << tmpName.str() << std::endl;
+      return;
+    }
+    bool ok = fwrite(&header,sizeof(header),1,file) == 1;
+    ok = ok && padCacheFile(file,size_t(header.nodeOffset));
+    ok = ok && fwrite(bvh->nodes,sizeof(typename BVH::Node),numNodes,file) == numNodes;
+    ok = ok && padCacheFile(file,size_t(header.triangleOffset));
+    ok = ok && fwrite(bvh->triangles,sizeof(typename BVH::Triangle),numBlocks,file) == numBlocks;
+    ok = (fclose(file) == 0) && ok;
+
+    remove(fileName.c_str());
+    if (!ok || rename(tmpName.c_str(),fileName.c_str()) != 0) {
+      std::cerr << "Warning: cannot write bvh cache file " << fileName.str() << std::endl;
+      remove(tmpName.c_str());
+    }
+  }
+}
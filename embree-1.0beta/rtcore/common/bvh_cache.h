@@ -0,0 +1,105 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef __EMBREE_BVH_CACHE_H__
+#define __EMBREE_BVH_CACHE_H__
+
+#include "../bvh2/bvh2.h"
+#include "../bvh4/bvh4.h"
+#include "../bvh4/triangle4.h"
+
+namespace embree
+{
+  /*! Header of a BVH cache file. The header is followed by the node
+   *  array and the triangle array of the BVH, both stored exactly as
+   *  in memory and aligned to cache lines, thus a cached BVH can be
+   *  traversed directly in a read only mapping of the file. */
+  struct BVHCacheHeader
+  {
+    enum { MAGIC = 0x31425652 };   //!< The characters "RVB1".
+    enum { VERSION = 1 };          //!< Increased whenever the layout of nodes or triangles changes.
+    enum { maxTypeLength = 32 };   //!< Maximal length of the acceleration structure type.
+
+    int32 magic;                   //!< Identifies the file format.
+    int32 version;                 //!< Version of the file format.
+    char type[maxTypeLength];      //!< Type of the acceleration structure, zero terminated.
+    uint64 hash;                   //!< Hash of the input triangles.
+    int64 numTriangles;            //!< Number of input triangles.
+    int32 nodeSize;                //!< Size of a node in bytes.
+    int32 triangleSize;            //!< Size of a triangle block in bytes.
+    int32 root;                    //!< Root node ID of the BVH.
+    int32 padding;                 //!< Unused, zero.
+    int64 nodeOffset;              //!< File offset of the node array.
+    int64 numNodes;                //!< Number of nodes.
+    int64 triangleOffset;          //!< File offset of the triangle array.
+    int64 numTriangleBlocks;       //!< Number of triangle blocks.
+  };
+
+  /*! Cache of built acceleration structures. A BVH is stored in one
+   *  file per acceleration structure type and scene, the name of the
+   *  file is derived from a hash of the input triangles. Loaded BVHs
+   *  reference the memory mapped file instead of allocated arrays,
+   *  which avoids both the build and copying the BVH into memory.
+   *  Files that do not match the triangles, the type, or the memory
+   *  layout of this build are ignored. */
+  class BVHCache
+  {
+  public:
+
+    /*! Prepares the cache lookup of a scene in the given directory. */
+    BVHCache(const FileName& directory, const char* type, const BuildTriangle* triangles, size_t numTriangles);
+
+    /*! Returns the cached BVH2 of the scene or NULL if there is none. */
+    Ref<BVH2<Triangle4> > loadBVH2();
+
+    /*! Returns the cached BVH4 of the scene or NULL if there is none. */
+    Ref<BVH4<Triangle4> > loadBVH4();
+
+    /*! Stores a BVH2 of the scene in the cache. */
+    void store(const Ref<BVH2<Triangle4> >& bvh);
+
+    /*! Stores a BVH4 of the scene in the cache. */
+    void store(const Ref<BVH4<Triangle4> >& bvh);
+
+    /*! Tests if the BVHs of an acceleration structure type depend on
+     *  the triangles only. BVHs built from shadow rays or imported
+     *  from files are not cached. */
+    static bool cacheable(const char* type);
+
+    /*! Computes the hash of an array of triangles. */
+    static uint64 hash(const BuildTriangle* triangles, size_t numTriangles);
+
+  private:
+
+    /*! Maps the cache file and builds a BVH over it. */
+    template<typename BVH> Ref<BVH> loadBVH();
+
+    /*! Writes the arrays of a BVH to the cache file. */
+    template<typename BVH> void storeBVH(const Ref<BVH>& bvh);
+
+    /*! Counts the nodes and triangle blocks referenced by a subtree. */
+    template<typename BVH> static void countArrays(const BVH& bvh, int nodeID, size_t& numNodes, size_t& numBlocks);
+
+  private:
+    std::string type;       //!< Type of the acceleration structure.
+    uint64 triangleHash;    //!< Hash of the input triangles.
+    size_t numTriangles;    //!< Number of input triangles.
+    FileName fileName;      //!< Name of the cache file.
+  };
+}
+
+#endif
@@ -23,7 +23,10 @@ namespace embree
 
   void ComputeBoundsTask::go()
   {
-    scheduler->addTask((Task::runFunction)&computeBounds,this,8,
+    numTasks = scheduler->getNumThreads();
+    geomBounds = (Box*) alignedMalloc(numTasks*sizeof(Box));
+    centBounds = (Box*) alignedMalloc(numTasks*sizeof(Box));
+    scheduler->addTask((Task::runFunction)&computeBounds,this,numTasks,
                        (Task::completeFunction)&mergeBounds,this);
     scheduler->go();
   }
@@ -31,8 +34,8 @@ namespace embree
   void ComputeBoundsTask::computeBounds(size_t tid, ComputeBoundsTask* This, size_t elt)
   {
     /* static work allocation */
-    size_t start = elt*This->numTriangles/8;
-    size_t end = (elt+1)*This->numTriangles/8;
+    size_t start = elt*This->numTriangles/This->numTasks;
+    size_t end = (elt+1)*This->numTriangles/This->numTasks;
     Box geomBounds = empty, centBounds = empty;
 
     for (size_t i=start; i<end; i++) {
@@ -50,10 +53,12 @@ namespace embree
   {
     This->geomBound = empty;
     This->centBound = empty;
-    for (int i=0; i<8; i++) {
+    for (size_t i=0; i<This->numTasks; i++) {
       This->geomBound = merge(This->geomBound,This->geomBounds[i]);
       This->centBound = merge(This->centBound,This->centBounds[i]);
     }
+    alignedFree(This->geomBounds); This->geomBounds = NULL;
+    alignedFree(This->centBounds); This->centBounds = NULL;
   }
 }
 
@@ -43,8 +43,9 @@ namespace embree
   private:
     const BuildTriangle* triangles;   //!< Input triangles.
     size_t numTriangles;              //!< Number of input triangles.
-    Box geomBounds[8];                //!< Geometry bounds per thread
-    Box centBounds[8];                //!< Centroid bounds per thread
+    size_t numTasks;                  //!< Number of tasks, one per thread.
+    Box* geomBounds;                  //!< Geometry bounds per task
+    Box* centBounds;                  //!< Centroid bounds per task
 
   public:
     Box geomBound;                   //!< Merged geometry bounds.
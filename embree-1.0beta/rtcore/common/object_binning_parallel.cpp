@@ -36,16 +36,22 @@ namespace embree
   {
     this->continuation = continuation;
     this->data = data;
-    scheduler->addTask((Task::runFunction)_stage0,this,8,(Task::completeFunction)&_stage1,this);
+
+    /*! one task per thread, the per task data lives until stage3 */
+    numTasks = scheduler->getNumThreads();
+    thread = (Thread*) alignedMalloc(numTasks*sizeof(Thread));
+    arrivals = (atomic_t*) alignedMalloc(numTasks*sizeof(atomic_t));
+    for (size_t i=0; i<numTasks; i++) arrivals[i] = 0;
+    scheduler->addTask((Task::runFunction)_stage0,this,numTasks,(Task::completeFunction)&_stage1,this);
   }
 
   template<int logBlockSize>
   void ObjectBinningParallel<logBlockSize>::stage0(size_t elt)
   {
     /* compute subrange to bin */
-    index_t start = elt*size()/8, end = (elt+1)*size()/8;
+    index_t start = elt*size()/numTasks, end = (elt+1)*size()/numTasks;
     Thread& t = thread[elt];
-    ssei binCount[maxBins];
+    ssei* binCount = t.binCount;
 
     /* initialize binning counter and bounds */
     for (size_t i=0; i<numBins; i++) {
@@ -94,29 +100,56 @@ namespace embree
       t.binLeftCount [i] = lcount += binCount[i-1];
       t.binRightCount[j] = rcount += binCount[j];
     }
+
+    /* tree reduction of the bins, the task arriving last at a pair
+     * of subtrees merges the right subtree into the left one and
+     * continues one level up, pair (i,i+s) counts arrivals at i+s */
+    for (size_t s=1; s<numTasks; s*=2)
+    {
+      size_t l = elt & ~s, r = elt | s;
+      if (r >= numTasks) continue;
+      if (atomic_add(&arrivals[r],1) == 0) return;
+      reduce(l,r);
+      elt = l;
+    }
+  }
+
+  template<int logBlockSize>
+  void ObjectBinningParallel<logBlockSize>::reduce(size_t dst, size_t src)
+  {
+    Thread& d = thread[dst];
+    const Thread& s = thread[src];
+    for (size_t i=0; i<numBins; i++) {
+      d.binCount[i] += s.binCount[i];
+      d.binBounds[i][0].grow(s.binBounds[i][0]);
+      d.binBounds[i][1].grow(s.binBounds[i][1]);
+      d.binBounds[i][2].grow(s.binBounds[i][2]);
+    }
   }
 
   template<int logBlockSize>
   void ObjectBinningParallel<logBlockSize>::stage1()
   {
     /* sweep from left to right (and right to left) and compute parallel prefix of merged bounds */
+    /* the reduction of stage0 left the merged bins in the first task */
+    const ssei* binCount = thread[0].binCount;
+    const Box (*binBounds)[4] = thread[0].binBounds;
+
     ssef lArea [maxBins], rArea [maxBins];
     ssef lCount[maxBins], rCount[maxBins];
     ssei rStart[maxBins];
     Box lbx = empty, lby = empty, lbz = empty;
     Box rbx = empty, rby = empty, rbz = empty;
+    ssei lcount = 0, rcount = 0;
     for (size_t i=1, j=numBins-1; i<numBins; i++, j--) {
-      ssei lcount = 0, rcount = 0;
-      for (size_t elt=0; elt<8; elt++) {
-        lcount += thread[elt].binLeftCount[i];
-        lbx.grow(thread[elt].binBounds[i-1][0]);
-        lby.grow(thread[elt].binBounds[i-1][1]);
-        lbz.grow(thread[elt].binBounds[i-1][2]);
-        rcount += thread[elt].binRightCount[j];
-        rbx.grow(thread[elt].binBounds[j][0]);
-        rby.grow(thread[elt].binBounds[j][1]);
-        rbz.grow(thread[elt].binBounds[j][2]);
-      }
+      lcount += binCount[i-1];
+      lbx.grow(binBounds[i-1][0]);
+      lby.grow(binBounds[i-1][1]);
+      lbz.grow(binBounds[i-1][2]);
+      rcount += binCount[j];
+      rbx.grow(binBounds[j][0]);
+      rby.grow(binBounds[j][1]);
+      rbz.grow(binBounds[j][2]);
       lArea[i][0] = halfArea(lbx);
       lArea[i][1] = halfArea(lby);
       lArea[i][2] = halfArea(lbz);
@@ -147,9 +180,9 @@ namespace embree
 
     /* allocate space for parallel split stage */
     size_t nleft = 0, nright = 0;
-    for (size_t elt=0; elt<8; elt++) {
-      targetLeft[elt] = nleft;
-      targetRight[elt] = rStart[bestSplit][bestDim]+nright;
+    for (size_t elt=0; elt<numTasks; elt++) {
+      thread[elt].targetLeft = nleft;
+      thread[elt].targetRight = rStart[bestSplit][bestDim]+nright;
       nleft += thread[elt].binLeftCount[bestSplit][bestDim];
       nright += thread[elt].binRightCount[bestSplit][bestDim];
     }
@@ -157,18 +190,18 @@ namespace embree
     numRight = nright;
 
     /*! continue with parallel split stage */
-    scheduler->addTask((Task::runFunction)_stage2,this,8,(Task::completeFunction)&_stage3,this);
+    scheduler->addTask((Task::runFunction)_stage2,this,numTasks,(Task::completeFunction)&_stage3,this);
   }
 
   template<int logBlockSize>
   void ObjectBinningParallel<logBlockSize>::stage2(size_t elt)
   {
     /* static work allocation */
-    size_t start = elt*size()/8, end = (elt+1)*size()/8;
+    size_t start = elt*size()/numTasks, end = (elt+1)*size()/numTasks;
     Thread& t = thread[elt];
 
     /* split list and compute left and right bounds */
-    size_t l = targetLeft[elt], r = targetRight[elt];
+    size_t l = t.targetLeft, r = t.targetRight;
     Box lgeomBounds = empty, lcentBounds = empty;
     Box rgeomBounds = empty, rcentBounds = empty;
 
@@ -208,12 +241,14 @@ namespace embree
     Box lgeomBounds = empty, lcentBounds = empty;
     Box rgeomBounds = empty, rcentBounds = empty;
 
-    for (int i=0; i<8; i++) {
+    for (size_t i=0; i<numTasks; i++) {
       lgeomBounds.grow(thread[i].lgeomBounds);
       rgeomBounds.grow(thread[i].rgeomBounds);
       lcentBounds.grow(thread[i].lcentBounds);
       rcentBounds.grow(thread[i].rcentBounds);
     }
+    alignedFree(thread); thread = NULL;
+    alignedFree(arrivals); arrivals = NULL;
 
     /*! finish */
     if (numLeft != 0 && numRight != 0)
@@ -51,6 +51,9 @@ namespace embree
     /*! Multi-threaded binning stage. Maps geometry into bins. Each bin stores number of primitives and bounds. */
     void stage0(size_t elt); static void _stage0(size_t tid, ObjectBinningParallel* This, size_t elt) { This->stage0(elt); }
 
+    /*! Merges the bins of task src into the bins of task dst. */
+    void reduce(size_t dst, size_t src);
+
     /*! Finds the best splitting dimension and location. */
     void stage1(          ); static void _stage1(size_t tid, ObjectBinningParallel* This            ) { This->stage1(   ); }
 
@@ -79,22 +82,26 @@ namespace embree
 
     /* output of parallel binning stage (stage0) */
     struct Thread {
-      ssei binLeftCount[maxBins];         //!< Number of primitives on the left of split.
-      ssei binRightCount[maxBins];        //!< Number of primitives on the right of split.
-      Box binBounds[maxBins][4];          //!< Bounds for every bin in every dimension.
+      ssei binLeftCount[maxBins];         //!< Number of primitives of the task on the left of split.
+      ssei binRightCount[maxBins];        //!< Number of primitives of the task on the right of split.
+      ssei binCount[maxBins];             //!< Number of primitives per bin, summed over a subtree of tasks by the reduction.
+      Box binBounds[maxBins][4];          //!< Bounds for every bin in every dimension, merged like binCount.
+      size_t targetLeft;                  //!< Target offset for the task to put left primitives.
+      size_t targetRight;                 //!< Target offset for the task to put right primitives.
       Box lgeomBounds;                    //!< Geometry bounds of geometry left of split.
       Box lcentBounds;                    //!< Centroid bounds of geometry left of split.
       Box rgeomBounds;                    //!< Geometry bounds of geometry right of split.
       Box rcentBounds;                    //!< Centroid bounds of geometry right of split.
-    } thread[8];
+    };
+    size_t numTasks;                      //!< Number of tasks of the parallel stages, one per thread.
+    Thread* thread;                       //!< Per task data, allocated from go until stage3.
+    atomic_t* arrivals;                   //!< Arrival counters of the pairs of the reduction tree.
 
     /* output of find best splti stage (stage1) */
     int bestDim;                          //!< Best splitting dimension
     int bestSplit;                        //!< Best splitting location
     size_t numLeft;                       //!< Number of primitives on the left of best split
     size_t numRight;                      //!< Number of primitives on the right of the best split
-    size_t targetLeft[8];                 //!< Target offset for the n-th thread to put left primitives.
-    size_t targetRight[8];                //!< Target offset for the n-th thread to put right primitives.
 
   public:
     float splitSAH;                        //!< SAH cost for the best split.
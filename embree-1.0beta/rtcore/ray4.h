@@ -0,0 +1,51 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#ifndef __EMBREE_RAY4_H__
+#define __EMBREE_RAY4_H__
+
+#include "ray.h"
+
+namespace embree
+{
+  /*! Packet of 4 rays in structure of arrays layout. */
+  struct Ray4
+  {
+    /*! Default construction does nothing. */
+    __forceinline Ray4() {}
+
+    /*! Gathers 4 rays into a packet. */
+    __forceinline Ray4(const Ray* rays)
+    {
+      for (size_t i=0; i<4; i++) {
+        org.x[i]  = rays[i].org.x;  org.y[i]  = rays[i].org.y;  org.z[i]  = rays[i].org.z;
+        dir.x[i]  = rays[i].dir.x;  dir.y[i]  = rays[i].dir.y;  dir.z[i]  = rays[i].dir.z;
+        rdir.x[i] = rays[i].rdir.x; rdir.y[i] = rays[i].rdir.y; rdir.z[i] = rays[i].rdir.z;
+        near[i] = rays[i].near;
+        far[i]  = rays[i].far;
+      }
+    }
+
+  public:
+    sse3f org;     //!< Ray origins
+    sse3f dir;     //!< Ray directions
+    sse3f rdir;    //!< Reciprocal ray directions
+    ssef near;     //!< Start of ray segments
+    ssef far;      //!< End of ray segments
+  };
+}
+
+#endif
@@ -0,0 +1,155 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#ifndef __EMBREE_RAY_STREAM_H__
+#define __EMBREE_RAY_STREAM_H__
+
+#include "ray.h"
+#include "hit.h"
+
+namespace embree
+{
+  /*! Returns the octant a direction points into. Bit k is set if
+   *  component k is negative. */
+  __forceinline size_t dirOctant(const Vec3f& dir) {
+    return (dir.x >= 0.0f ? 0 : 1) | (dir.y >= 0.0f ? 0 : 2) | (dir.z >= 0.0f ? 0 : 4);
+  }
+
+  /*! Stream of rays in structure of arrays layout. The stream does
+   *  not own its arrays, they are provided by the caller and hold one
+   *  element per ray. */
+  struct RayStreamSoA
+  {
+    /*! Default construction creates an empty stream. */
+    RayStreamSoA ()
+      : orgx(NULL), orgy(NULL), orgz(NULL), dirx(NULL), diry(NULL), dirz(NULL), tnear(NULL), tfar(NULL) {}
+
+    /*! Returns the i'th ray of the stream. */
+    __forceinline Ray get(size_t i) const {
+      return Ray(Vec3f(orgx[i],orgy[i],orgz[i]),Vec3f(dirx[i],diry[i],dirz[i]),tnear[i],tfar[i]);
+    }
+
+    /*! Returns the octant the direction of the i'th ray points into. */
+    __forceinline size_t octant(size_t i) const {
+      return dirOctant(Vec3f(dirx[i],diry[i],dirz[i]));
+    }
+
+    /*! Tests if the segment of the i'th ray is empty. */
+    __forceinline bool empty(size_t i) const {
+      return !(tnear[i] <= tfar[i]);
+    }
+
+  public:
+    const float* orgx;   //!< x coordinates of ray origins
+    const float* orgy;   //!< y coordinates of ray origins
+    const float* orgz;   //!< z coordinates of ray origins
+    const float* dirx;   //!< x coordinates of ray directions
+    const float* diry;   //!< y coordinates of ray directions
+    const float* dirz;   //!< z coordinates of ray directions
+    const float* tnear;  //!< Start of ray segments
+    const float* tfar;   //!< End of ray segments
+  };
+
+  /*! Stream of hits in structure of arrays layout. Like the ray
+   *  stream it does not own its arrays. */
+  struct HitStreamSoA
+  {
+    /*! Default construction creates an empty stream. */
+    HitStreamSoA () : id0(NULL), id1(NULL), u(NULL), v(NULL), t(NULL) {}
+
+    /*! Stores the i'th hit of the stream. The barycentric coordinates
+     *  are only written if something got hit. */
+    __forceinline void set(size_t i, const Hit& hit) {
+      id0[i] = hit.id0;
+      id1[i] = hit.id1;
+      t[i] = hit.t;
+      if (hit.id0 == -1) return;
+      u[i] = hit.u;
+      v[i] = hit.v;
+    }
+
+  public:
+    int* id0;    //!< 1st primitive IDs
+    int* id1;    //!< 2nd primitive IDs
+    float* u;    //!< Barycentric u coordinates of hits
+    float* v;    //!< Barycentric v coordinates of hits
+    float* t;    //!< Distances of hits
+  };
+
+  /*! Number of rays stream traversers order at once. */
+  const size_t rayStreamBlockSize = 256;
+
+  /*! Orders the rays [begin,end) of a stream for traversal. The rays
+   *  are grouped by direction octant, such that the traversal kernels
+   *  can do their octant dependent setup once per group. Rays with an
+   *  empty segment are filtered out and placed behind all others.
+   *  Writes the ray indices to order and the start of the group of
+   *  octant o to first[o]. first[8] is the number of rays with a
+   *  non-empty segment. */
+  inline void sortByOctant(const RayStreamSoA& rays, size_t begin, size_t end, size_t* order, size_t first[9])
+  {
+    /*! count rays per octant, the 9th bucket holds the empty rays */
+    size_t count[9] = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    for (size_t i=begin; i<end; i++)
+      count[rays.empty(i) ? 8 : rays.octant(i)]++;
+
+    size_t start[9];
+    for (size_t i=0, s=0; i<9; i++) { first[i] = start[i] = s; s += count[i]; }
+
+    for (size_t i=begin; i<end; i++)
+      order[start[rays.empty(i) ? 8 : rays.octant(i)]++] = i;
+  }
+
+  /*! Ray stream front end shared by the traversers. Orders the rays
+   *  of each block by octant and passes each octant run to the run
+   *  kernel of the traverser, which sets up its traversal state once
+   *  per run. */
+  template<typename Traverser>
+    void intersectStream(const Traverser& traverser, const RayStreamSoA& rays, HitStreamSoA& hits, size_t n)
+  {
+    size_t order[rayStreamBlockSize], first[9];
+    for (size_t begin=0; begin<n; begin+=rayStreamBlockSize)
+    {
+      const size_t end = min(begin+rayStreamBlockSize,n);
+      sortByOctant(rays,begin,end,order,first);
+      for (size_t o=0; o<8; o++)
+        if (first[o] < first[o+1]) traverser.intersectRun(o,rays,order+first[o],first[o+1]-first[o],hits);
+
+      /*! rays with an empty segment miss */
+      for (size_t i=first[8]; i<end-begin; i++) {
+        Hit hit; hit.u = hit.v = 0.0f; hit.t = rays.tfar[order[i]];
+        hits.set(order[i],hit);
+      }
+    }
+  }
+
+  /*! Occlusion counterpart of intersectStream. */
+  template<typename Traverser>
+    void occludedStream(const Traverser& traverser, const RayStreamSoA& rays, bool* occluded, size_t n)
+  {
+    size_t order[rayStreamBlockSize], first[9];
+    for (size_t begin=0; begin<n; begin+=rayStreamBlockSize)
+    {
+      const size_t end = min(begin+rayStreamBlockSize,n);
+      sortByOctant(rays,begin,end,order,first);
+      for (size_t o=0; o<8; o++)
+        if (first[o] < first[o+1]) traverser.occludedRun(o,rays,order+first[o],first[o+1]-first[o],occluded);
+      for (size_t i=first[8]; i<end-begin; i++) occluded[order[i]] = false;
+    }
+  }
+}
+
+#endif
@@ -17,12 +17,22 @@
 #include "rtcore.h"
 #include "bvh2/bvh2_builder.h"
 #include "bvh2/bvh2_builder_spatial.h"
+#include "bvh2/bvh2_builder_morton.h"
+#include "bvh2/bvh2_builder_srdh.h"
+#include "bvh2/bvh2_importer.h"
+#include "bvh2/bvh2_optimizer.h"
+#include "bvh2/bvh2_orderer.h"
 #include "bvh2/bvh2_to_bvh4.h"
 #include "bvh2/bvh2_traverser.h"
 #include "BVH2Printer.h"
 #include "bvh4/bvh4_builder.h"
 #include "bvh4/bvh4_traverser.h"
+#include "bvh4/bvh4_packet_traverser.h"
+#include "BVH4Printer.h"
+#include "bvh8/bvh8_traverser.h"
+#include "common/bvh_cache.h"
 #include "PrintingTraverser.h"
+#include "sys/sysinfo.h"
 
 #include <string>
 
@@ -30,26 +40,192 @@ namespace embree
 {
 	void printBVH2ToFile(Ref<BVH2<Triangle4> > bvh, FileName& bvhOutput);
 
-  Intersector* rtcCreateAccelNoTrace(const char* type, const BuildTriangle* triangles, size_t numTriangles, FileName& bvhOutput)
+  /*! Loads the AnyHit rays of a recorded trace that guide the SRDH builder and the RBVH orderer. */
+  static void loadShadowRays(const FileName& shadowRays, std::vector<ShadowRay>& rays)
+  {
+    if (shadowRays.str().length() != 0) BVH2BuilderSRDH::loadRays(shadowRays,rays);
+    else std::cout << "Warning: no shadow ray trace given, SRDH builds use the SAH and RBVHs visit the closer child first" << std::endl;
+  }
+
+  Intersector::~Intersector() {}
+
+  void Intersector::intersect4(const sseb& valid, const Ray* rays, Hit* hits, int depth) const {
+    for (size_t i=0; i<4; i++) if (valid[i]) intersect(rays[i],hits[i],depth);
+  }
+
+  sseb Intersector::occluded4(const sseb& valid, const Ray* rays, int depth) const {
+    return sseb(valid[0] && occluded(rays[0],depth), valid[1] && occluded(rays[1],depth),
+                valid[2] && occluded(rays[2],depth), valid[3] && occluded(rays[3],depth));
+  }
+
+  void Intersector::intersectN(const RayStreamSoA& rays, HitStreamSoA& hits, size_t n, int depth) const {
+    for (size_t i=0; i<n; i++) { Hit hit; intersect(rays.get(i),hit,depth); hits.set(i,hit); }
+  }
+
+  void Intersector::occludedN(const RayStreamSoA& rays, bool* occluded, size_t n, int depth) const {
+    for (size_t i=0; i<n; i++) occluded[i] = this->occluded(rays.get(i),depth);
+  }
+
+  Intersector* rtcCreateAccelNoTrace(const char* type, const BuildTriangle* triangles, size_t numTriangles, FileName& bvhOutput, const FileName& shadowRays, const FileName& bvhInput, BVHCache* cache)
   {
     if (!strcmp(type,"bvh2"        )) 	{
-		Ref<BVH2<Triangle4> > bvh = BVH2Builder::build(triangles,numTriangles);
-		BVH2Printer::printBVH2ToFile(bvh,bvhOutput);
+		Ref<BVH2<Triangle4> > bvh;
+		if (cache) bvh = cache->loadBVH2();
+		if (!bvh) {
+			bvh = BVH2Builder::build(triangles,numTriangles);
+			if (cache) cache->store(bvh);
+		}
+		if (bvhOutput.str().length() != 0)
+			BVH2Printer::printBVH2ToFile(bvh,bvhOutput);
 		return new BVH2Traverser(bvh);
 	}
     else if (!strcmp(type,"bvh2.spatial"))	{
-		Ref<BVH2<Triangle4> > bvh = BVH2BuilderSpatial::build(triangles,numTriangles);
-		BVH2Printer::printBVH2ToFile(bvh,bvhOutput);
+		Ref<BVH2<Triangle4> > bvh;
+		if (cache) bvh = cache->loadBVH2();
+		if (!bvh) {
+			bvh = BVH2BuilderSpatial::build(triangles,numTriangles);
+			if (cache) cache->store(bvh);
+		}
+		if (bvhOutput.str().length() != 0)
+			BVH2Printer::printBVH2ToFile(bvh,bvhOutput);
 		return new BVH2Traverser(bvh);
 	}
-    else if (!strcmp(type,"bvh4") || !strcmp(type,"default"))	{
-		Ref<BVH4<Triangle4> > bvh = BVH4Builder::build(triangles,numTriangles);
+    else if (!strcmp(type,"bvh2.morton"))	{
+		Ref<BVH2<Triangle4> > bvh;
+		if (cache) bvh = cache->loadBVH2();
+		if (!bvh) {
+			bvh = BVH2BuilderMorton::build(triangles,numTriangles);
+			if (cache) cache->store(bvh);
+		}
+		if (bvhOutput.str().length() != 0)
+			BVH2Printer::printBVH2ToFile(bvh,bvhOutput);
+		return new BVH2Traverser(bvh);
+	}
+    else if (!strcmp(type,"bvh2.trbvh"))	{
+		Ref<BVH2<Triangle4> > bvh;
+		if (cache) bvh = cache->loadBVH2();
+		if (!bvh) {
+			/*! single block leaves leave the grouping of triangles to the treelet optimizer */
+			bvh = BVH2BuilderMorton::build(triangles,numTriangles,4);
+			BVH2Optimizer::optimize(bvh);
+			if (cache) cache->store(bvh);
+		}
+		if (bvhOutput.str().length() != 0)
+			BVH2Printer::printBVH2ToFile(bvh,bvhOutput);
+		return new BVH2Traverser(bvh);
+	}
+    else if (!strcmp(type,"bvh2.srdh") || !strcmp(type,"bvh2.rbvh") || !strcmp(type,"bvh2.srdh.rbvh"))	{
+		/*! the cache is keyed by the triangles only, thus BVHs depending on rays are never cached */
+		std::vector<ShadowRay> rays;
+		loadShadowRays(shadowRays,rays);
+		Ref<BVH2<Triangle4> > bvh;
+		if (!strcmp(type,"bvh2.rbvh")) bvh = BVH2Builder::build(triangles,numTriangles);
+		else bvh = BVH2BuilderSRDH::build(triangles,numTriangles,rays);
+		if (strcmp(type,"bvh2.srdh")) BVH2Orderer::order(bvh,rays);
+		if (bvhOutput.str().length() != 0) {
+			/*! RBVHs are always written as text RBVH files, plain SRDHs in the binary format */
+			if (strcmp(type,"bvh2.srdh")) BVH2Printer::printRBVH2ToFile(bvh,triangles,numTriangles,bvhOutput);
+			else BVH2Printer::printBVH2ToFile(bvh,bvhOutput);
+		}
+		return new BVH2Traverser(bvh);
+	}
+    else if (!strcmp(type,"bvh2.import"))	{
+		/*! the cache is keyed by the triangles only, thus imported BVHs are never cached */
+		if (bvhInput.str().length() == 0) throw std::runtime_error("no bvh file given to import");
+		Ref<BVH2<Triangle4> > bvh = BVH2Importer::import(bvhInput,triangles,numTriangles);
+		if (bvhOutput.str().length() != 0)
+			BVH2Printer::printRBVH2ToFile(bvh,triangles,numTriangles,bvhOutput);
+		return new BVH2Traverser(bvh);
+	}
+    else if (!strcmp(type,"bvh4") || !strcmp(type,"default") || !strcmp(type,"bvh4.packet"))	{
+		Ref<BVH4<Triangle4> > bvh;
+		if (cache) bvh = cache->loadBVH4();
+		if (!bvh) {
+			bvh = BVH4Builder::build(triangles,numTriangles);
+			if (cache) cache->store(bvh);
+		}
+		if (bvhOutput.str().length() != 0)
+			BVH4Printer::printBVH4ToFile(bvh,bvhOutput);
+		/*! the packet traverser only pays off for coherent rays, thus it is opt-in */
+		if (!strcmp(type,"bvh4.packet")) return new BVH4PacketTraverser(bvh);
 		return new BVH4Traverser(bvh);
 	}
     else if (!strcmp(type,"bvh4.spatial")) 	{
-	  Ref<BVH4<Triangle4> > bvh = BVH2ToBVH4::convert(BVH2BuilderSpatial::build(triangles,numTriangles));
+		Ref<BVH4<Triangle4> > bvh;
+		if (cache) bvh = cache->loadBVH4();
+		if (!bvh) {
+			Ref<BVH2<Triangle4> > bvh2 = BVH2BuilderSpatial::build(triangles,numTriangles);
+			bvh = BVH2ToBVH4::convert(bvh2);
+			if (cache) cache->store(bvh);
+		}
+		if (bvhOutput.str().length() != 0)
+			BVH4Printer::printBVH4ToFile(bvh,bvhOutput);
       return new BVH4Traverser(bvh);
     }
+    else if (!strcmp(type,"bvh4.morton")) 	{
+		Ref<BVH4<Triangle4> > bvh;
+		if (cache) bvh = cache->loadBVH4();
+		if (!bvh) {
+			Ref<BVH2<Triangle4> > bvh2 = BVH2BuilderMorton::build(triangles,numTriangles);
+			bvh = BVH2ToBVH4::convert(bvh2);
+			if (cache) cache->store(bvh);
+		}
+		if (bvhOutput.str().length() != 0)
+			BVH4Printer::printBVH4ToFile(bvh,bvhOutput);
+		return new BVH4Traverser(bvh);
+	}
+    else if (!strcmp(type,"bvh4.trbvh")) 	{
+		Ref<BVH4<Triangle4> > bvh;
+		if (cache) bvh = cache->loadBVH4();
+		if (!bvh) {
+			Ref<BVH2<Triangle4> > bvh2 = BVH2BuilderMorton::build(triangles,numTriangles,4);
+			BVH2Optimizer::optimize(bvh2);
+			bvh = BVH2ToBVH4::convert(bvh2);
+			if (cache) cache->store(bvh);
+		}
+		if (bvhOutput.str().length() != 0)
+			BVH4Printer::printBVH4ToFile(bvh,bvhOutput);
+		return new BVH4Traverser(bvh);
+	}
+    else if (!strcmp(type,"bvh4.srdh")) 	{
+		std::vector<ShadowRay> rays;
+		loadShadowRays(shadowRays,rays);
+		Ref<BVH2<Triangle4> > bvh2 = BVH2BuilderSRDH::build(triangles,numTriangles,rays);
+		Ref<BVH4<Triangle4> > bvh = BVH2ToBVH4::convert(bvh2);
+		if (bvhOutput.str().length() != 0)
+			BVH4Printer::printBVH4ToFile(bvh,bvhOutput);
+		return new BVH4Traverser(bvh);
+	}
+    else if (!strcmp(type,"bvh4.import")) 	{
+		/*! the BVH4 traversal ignores the child order of imported RBVHs */
+		if (bvhInput.str().length() == 0) throw std::runtime_error("no bvh file given to import");
+		Ref<BVH2<Triangle4> > bvh2 = BVH2Importer::import(bvhInput,triangles,numTriangles);
+		Ref<BVH4<Triangle4> > bvh = BVH2ToBVH4::convert(bvh2);
+		if (bvhOutput.str().length() != 0)
+			BVH4Printer::printBVH4ToFile(bvh,bvhOutput);
+		return new BVH4Traverser(bvh);
+	}
+    else if (!strcmp(type,"bvh8") || !strcmp(type,"bvh8.spatial")) {
+      const bool spatial = !strcmp(type,"bvh8.spatial");
+      /*! the BVH8 is collapsed from a BVH2, thus we cache and print the BVH2 */
+      if (hasAVX()) {
+        Ref<BVH2<Triangle4> > bvh;
+        if (cache) bvh = cache->loadBVH2();
+        if (!bvh) {
+          bvh = spatial ? BVH2BuilderSpatial::build(triangles,numTriangles) : BVH2Builder::build(triangles,numTriangles);
+          if (cache) cache->store(bvh);
+        }
+        if (Intersector* accel = createBVH8Traverser(bvh)) {
+          if (bvhOutput.str().length() != 0)
+            BVH2Printer::printBVH2ToFile(bvh,bvhOutput);
+          return accel;
+        }
+      }
+      /*! without AVX in the build or on this CPU we fall back to the BVH4 */
+      const char* fallback = spatial ? "bvh4.spatial" : "bvh4";
+      std::cout << "Warning: AVX not available, using " << fallback << " instead of " << type << std::endl;
+      return rtcCreateAccelNoTrace(fallback,triangles,numTriangles,bvhOutput,shadowRays,bvhInput,NULL);
+    }
     else {
       throw std::runtime_error("invalid acceleration structure: "+std::string(type));
       return NULL;
@@ -57,10 +233,16 @@ namespace embree
   }
   Intersector* rtcCreateAccel(const char* type, TraceData traceFile, const BuildTriangle* triangles, size_t numTriangles)
   {
-      Intersector *sansTracer = rtcCreateAccelNoTrace(type,triangles,numTriangles, traceFile.bvhOutputFile);
+      Intersector *sansTracer = NULL;
+      if (traceFile.bvhCacheDir.str().length() != 0 && BVHCache::cacheable(type)) {
+          BVHCache cache(traceFile.bvhCacheDir, type, triangles, numTriangles);
+          sansTracer = rtcCreateAccelNoTrace(type,triangles,numTriangles, traceFile.bvhOutputFile, traceFile.shadowRayFile, traceFile.bvhInputFile, &cache);
+      }
+      else
+          sansTracer = rtcCreateAccelNoTrace(type,triangles,numTriangles, traceFile.bvhOutputFile, traceFile.shadowRayFile, traceFile.bvhInputFile, NULL);
       if(traceFile.rayTraceFile.str().length()==0)
           return sansTracer;
-      return new PrintingTraverser(sansTracer, traceFile.rayTraceFile);
+      return new PrintingTraverser(sansTracer, traceFile.rayTraceFile, traceFile.rayTraceFormat, traceFile.rayTraceSampling);
   }
 
   
@@ -20,17 +20,23 @@
 #include "sys/filename.h"
 #include "ray.h"
 #include "hit.h"
+#include "ray_stream.h"
 
 namespace embree
 {
-  /*! Single ray interface to the traverser. A closest intersection
-   *  point of a ray with the geometry can be found. A ray can also be
-   *  tested for occlusion by any geometry. */
+  /*! Ray interface to the traverser. A closest intersection point
+   *  of a ray with the geometry can be found. A ray can also be
+   *  tested for occlusion by any geometry. Both queries are also
+   *  available for packets of 4 rays and for streams of rays. */
   class Intersector : public RefCount {
   public:
 
-    /*! A virtual destructor is required. */
-    virtual ~Intersector() {}
+    /*! Default construction. */
+    __forceinline Intersector() {}
+
+    /*! A virtual destructor is required. It is not inline, such that
+     *  only rtcore.cpp holds the vtable. */
+    virtual ~Intersector();
 
     /*! Intersects the ray with the geometry and returns the hit
      *  information. */
@@ -40,6 +46,27 @@ namespace embree
 
     /*! Tests the ray for occlusion with the scene. */
     virtual bool occluded (const Ray& ray    /*!< Ray to test occlusion for. */, int depth) const = 0;
+
+    /*! Intersects a packet of 4 rays with the geometry. Rays whose
+     *  entry of the valid mask is false are ignored and their hits
+     *  left untouched. The default implementation shoots the rays one
+     *  by one, traversers that support packets override it. */
+    virtual void intersect4(const sseb& valid, const Ray* rays, Hit* hits, int depth) const;
+
+    /*! Tests a packet of 4 rays for occlusion, returns the mask of
+     *  valid rays that are occluded. */
+    virtual sseb occluded4(const sseb& valid, const Ray* rays, int depth) const;
+
+    /*! Intersects the first n rays of a stream with the geometry and
+     *  stores the closest hits. The default implementation shoots the
+     *  rays one by one, traversers override it to amortize the per
+     *  ray setup over the stream. The default implementations are
+     *  not inline, such that the AVX compiled traversers do not emit
+     *  AVX copies of them the linker could pick for everyone. */
+    virtual void intersectN(const RayStreamSoA& rays, HitStreamSoA& hits, size_t n, int depth) const;
+
+    /*! Tests the first n rays of a stream for occlusion. */
+    virtual void occludedN(const RayStreamSoA& rays, bool* occluded, size_t n, int depth) const;
   };
 
   /*! Triangle interface structure to the builder. The builders get an
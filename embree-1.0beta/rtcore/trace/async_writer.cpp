@@ -0,0 +1,134 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "async_writer.h"
+
+namespace embree
+{
+  AsyncWriter::AsyncWriter(const FileName& fileName, size_t blockSize, size_t maxQueued)
+    : blockSize(blockSize), maxQueued(maxQueued), stream(NULL), terminate(false), failed(false)
+  {
+    file = fopen(fileName.c_str(), "wb");
+    if (!file) throw std::runtime_error("cannot open file " + fileName.str());
+    ioThread = createThread(ioThreadFunc,this);
+  }
+
+  AsyncWriter::~AsyncWriter()
+  {
+    /*! a failed write makes submit throw, the failure gets reported below */
+    if (stream) {
+      try {
+        if (stream->size) submit(stream);
+        else release(stream);
+      }
+      catch (const std::runtime_error&) {}
+    }
+    {
+      Lock<MutexSys> lock(mutex);
+      terminate = true;
+      condition.broadcast();
+    }
+    join(ioThread);
+    if (fclose(file) != 0) failed = true;
+    if (failed) std::cerr << "AsyncWriter: cannot write file" << std::endl;
+
+    for (size_t i=0; i<unused.size(); i++) {
+      alignedFree(unused[i]->data);
+      delete unused[i];
+    }
+  }
+
+  AsyncWriter::Block* AsyncWriter::acquire()
+  {
+    {
+      Lock<MutexSys> lock(mutex);
+      if (!unused.empty()) {
+        Block* block = unused.back(); unused.pop_back();
+        block->size = 0;
+        return block;
+      }
+    }
+    Block* block = new Block;
+    block->data = (char*) alignedMalloc(blockSize);
+    block->size = 0;
+    return block;
+  }
+
+  void AsyncWriter::release(Block* block)
+  {
+    Lock<MutexSys> lock(mutex);
+    unused.push_back(block);
+  }
+
+  void AsyncWriter::submit(Block* block)
+  {
+    Lock<MutexSys> lock(mutex);
+    while (queue.size() >= maxQueued && !failed) condition.wait(mutex);
+    if (failed) {
+      unused.push_back(block);
+      throw std::runtime_error("AsyncWriter: cannot write file");
+    }
+    queue.push_back(block);
+    condition.broadcast();
+  }
+
+  void AsyncWriter::write(const void* ptr, size_t bytes)
+  {
+    const char* src = (const char*) ptr;
+    while (bytes)
+    {
+      if (!stream) stream = acquire();
+      size_t n = min(bytes,blockSize-stream->size);
+      memcpy(stream->data+stream->size,src,n);
+      stream->size += n; src += n; bytes -= n;
+      if (stream->size == blockSize) {
+        Block* block = stream; stream = NULL;
+        submit(block);
+      }
+    }
+  }
+
+  void AsyncWriter::ioThreadFunc(void* ptr)
+  {
+    /*! the I/O thread would inherit the affinity of its creator, usually a pinned scheduler thread */
+    clearAffinity();
+    ((AsyncWriter*)ptr)->run();
+  }
+
+  void AsyncWriter::run()
+  {
+    while (true)
+    {
+      Block* block = NULL;
+      {
+        Lock<MutexSys> lock(mutex);
+        while (queue.empty() && !terminate) condition.wait(mutex);
+        if (queue.empty()) return;
+        block = queue.front();
+      }
+
+      /*! the file is only accessed by this thread, so write without holding the lock */
+      bool ok = fwrite(block->data,1,block->size,file) == block->size;
+
+      Lock<MutexSys> lock(mutex);
+      queue.pop_front();
+      unused.push_back(block);
+      if (!ok) failed = true;
+      condition.broadcast();
+    }
+  }
+}
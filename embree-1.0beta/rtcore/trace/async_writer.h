@@ -0,0 +1,102 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef __EMBREE_ASYNC_WRITER_H__
+#define __EMBREE_ASYNC_WRITER_H__
+
+#include "../common/default.h"
+#include "sys/thread.h"
+#include "sys/filename.h"
+#include "sys/sync/mutex.h"
+#include "sys/sync/condition.h"
+
+#include <deque>
+
+namespace embree
+{
+  /*! Writes blocks of data to a file from a dedicated I/O
+   *  thread. Producers acquire an empty block, fill it, and submit
+   *  it to a bounded queue. The I/O thread writes the submitted
+   *  blocks in submission order and hands them back for reuse, thus
+   *  a producer fills its next block while the previous one is
+   *  written. Submitting blocks while the queue is full blocks the
+   *  producer until the disk caught up. Destroying the writer
+   *  writes all submitted blocks before the file gets closed. */
+  class AsyncWriter : public RefCount
+  {
+  public:
+
+    /*! A block of data to write. */
+    struct Block {
+      char*  data;   //!< Pointer to the data of the block.
+      size_t size;   //!< Number of valid bytes in the block.
+    };
+
+  public:
+
+    /*! Opens the file and starts the I/O thread. Blocks have a
+     *  capacity of blockSize bytes, at most maxQueued blocks are
+     *  waiting to get written. */
+    AsyncWriter(const FileName& fileName, size_t blockSize = 4*1024*1024, size_t maxQueued = 8);
+
+    /*! Writes all submitted blocks and the stream block, then stops
+     *  the I/O thread and closes the file. */
+    ~AsyncWriter();
+
+    /*! Capacity of each block in bytes. */
+    __forceinline size_t capacity() const { return blockSize; }
+
+    /*! Returns an empty block. Thread safe. */
+    Block* acquire();
+
+    /*! Hands a block back without writing it. Thread safe. */
+    void release(Block* block);
+
+    /*! Queues a block for writing. Waits while the queue is full.
+     *  Thread safe. */
+    void submit(Block* block);
+
+    /*! Appends bytes to the internal stream block, which gets
+     *  submitted when full. Not thread safe, meant for a single
+     *  producer that writes a sequential stream. */
+    void write(const void* ptr, size_t bytes);
+
+  private:
+
+    /*! Thread function of the I/O thread. */
+    static void ioThreadFunc(void* ptr);
+
+    /*! Writes queued blocks until the writer gets destroyed. */
+    void run();
+
+  private:
+    FILE* file;                   //!< File to write to.
+    size_t blockSize;             //!< Capacity of each block.
+    size_t maxQueued;             //!< Maximal number of blocks in the queue.
+    thread_t ioThread;            //!< Thread writing the blocks.
+    Block* stream;                //!< Block the write function appends to.
+
+    MutexSys mutex;               //!< Protects the state below.
+    ConditionSys condition;       //!< Signals changes of the queue.
+    std::deque<Block*> queue;     //!< Blocks waiting to get written.
+    std::vector<Block*> unused;   //!< Blocks available for reuse.
+    bool terminate;               //!< Tells the I/O thread to finish.
+    bool failed;                  //!< Set if writing to the file failed.
+  };
+}
+
+#endif
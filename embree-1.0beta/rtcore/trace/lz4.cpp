@@ -0,0 +1,149 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "lz4.h"
+
+#include <cstring>
+#include <vector>
+
+namespace embree
+{
+  enum {
+    minMatch  = 4,                  //!< Shortest encodable match.
+    lastLiterals = 5,               //!< Number of bytes at the end that are always literals.
+    matchLimit = 12,                //!< A match has to start this many bytes before the end.
+    maxOffset = 65535,              //!< Largest distance of a match.
+    hashLog = 14                    //!< Log of the size of the hash table.
+  };
+
+  static __forceinline uint32 read32(const uint8* p) {
+    uint32 v; memcpy(&v,p,sizeof(v)); return v;
+  }
+
+  static __forceinline uint32 lz4Hash(uint32 v) {
+    return (v*2654435761u) >> (32-hashLog);
+  }
+
+  /*! Writes the 255 continuation bytes of a length. */
+  static __forceinline uint8* writeLength(uint8* op, size_t len)
+  {
+    for (; len >= 255; len -= 255) *op++ = 255;
+    *op++ = (uint8) len;
+    return op;
+  }
+
+  /*! Writes a sequence of literals followed by a match, or only
+   *  literals for the last sequence (matchLength == 0). */
+  static uint8* writeSequence(uint8* op, uint8* oend, const uint8* literals, size_t numLiterals, size_t offset, size_t matchLength)
+  {
+    if (size_t(oend-op) < 1 + numLiterals/255 + 1 + numLiterals + 2 + matchLength/255 + 1) return NULL;
+
+    uint8* token = op++;
+    if (numLiterals >= 15) { *token = 15 << 4; op = writeLength(op,numLiterals-15); }
+    else *token = uint8(numLiterals << 4);
+    memcpy(op,literals,numLiterals); op += numLiterals;
+    if (matchLength == 0) return op;
+
+    *op++ = uint8(offset);
+    *op++ = uint8(offset >> 8);
+    size_t len = matchLength-minMatch;
+    if (len >= 15) { *token |= 15; op = writeLength(op,len-15); }
+    else *token |= uint8(len);
+    return op;
+  }
+
+  size_t lz4Compress(const char* src, size_t n, char* dst, size_t capacity)
+  {
+    const uint8* const base = (const uint8*) src;
+    const uint8* const iend = base + n;
+    const uint8* ip = base, *anchor = base;
+    uint8* op = (uint8*) dst, *const oend = op + capacity;
+
+    if (n > matchLimit)
+    {
+      std::vector<uint32> table(size_t(1) << hashLog, 0);
+      const uint8* const mflimit = iend - matchLimit;
+      const uint8* const mlimit = iend - lastLiterals;
+
+      while (ip < mflimit)
+      {
+        const uint32 h = lz4Hash(read32(ip));
+        const uint8* ref = base + table[h];
+        table[h] = uint32(ip-base);
+
+        if (ref >= ip || ip-ref > maxOffset || read32(ref) != read32(ip)) {
+          ip += 1 + ((ip-anchor) >> 6); // skip faster through incompressible data
+          continue;
+        }
+
+        const uint8* p = ip + minMatch, *r = ref + minMatch;
+        while (p < mlimit && *p == *r) { p++; r++; }
+
+        op = writeSequence(op,oend,anchor,ip-anchor,ip-ref,p-ip);
+        if (!op) return 0;
+        ip = anchor = p;
+      }
+    }
+
+    op = writeSequence(op,oend,anchor,iend-anchor,0,0);
+    if (!op) return 0;
+    return op - (uint8*) dst;
+  }
+
+  /*! Reads the continuation bytes of a length. */
+  static __forceinline bool readLength(const uint8*& ip, const uint8* iend, size_t& len)
+  {
+    uint8 b;
+    do {
+      if (ip >= iend) return false;
+      len += b = *ip++;
+    } while (b == 255);
+    return true;
+  }
+
+  bool lz4Decompress(const char* src, size_t n, char* dst, size_t size)
+  {
+    const uint8* ip = (const uint8*) src, *const iend = ip + n;
+    uint8* op = (uint8*) dst, *const obegin = op, *const oend = op + size;
+
+    while (ip < iend)
+    {
+      const uint8 token = *ip++;
+
+      size_t numLiterals = token >> 4;
+      if (numLiterals == 15 && !readLength(ip,iend,numLiterals)) return false;
+      if (size_t(iend-ip) < numLiterals || size_t(oend-op) < numLiterals) return false;
+      memcpy(op,ip,numLiterals); ip += numLiterals; op += numLiterals;
+      if (ip == iend) break;
+
+      if (iend-ip < 2) return false;
+      const size_t offset = ip[0] | (size_t(ip[1]) << 8); ip += 2;
+      if (offset == 0 || size_t(op-obegin) < offset) return false;
+
+      size_t matchLength = token & 15;
+      if (matchLength == 15 && !readLength(ip,iend,matchLength)) return false;
+      matchLength += minMatch;
+      if (size_t(oend-op) < matchLength) return false;
+
+      /*! byte wise copy as source and destination may overlap */
+      const uint8* ref = op - offset;
+      for (size_t i=0; i<matchLength; i++) op[i] = ref[i];
+      op += matchLength;
+    }
+    return op == oend;
+  }
+}
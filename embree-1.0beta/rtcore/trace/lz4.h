@@ -0,0 +1,42 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef __EMBREE_LZ4_H__
+#define __EMBREE_LZ4_H__
+
+#include "sys/platform.h"
+
+namespace embree
+{
+  /*! Compression and decompression of the LZ4 block format. The
+   *  compressor is a single pass greedy matcher with a hash table of
+   *  recent positions, which favours speed over compression ratio,
+   *  the output can be decoded by any LZ4 block decoder. */
+
+  /*! Maximal compressed size of n bytes. */
+  __forceinline size_t lz4CompressBound(size_t n) { return n + n/255 + 16; }
+
+  /*! Compresses n bytes of src into dst of the given capacity. Returns
+   *  the compressed size, or 0 if the result does not fit into dst. */
+  size_t lz4Compress(const char* src, size_t n, char* dst, size_t capacity);
+
+  /*! Decompresses n bytes of src into exactly size bytes of dst.
+   *  Returns false if the input is corrupt. */
+  bool lz4Decompress(const char* src, size_t n, char* dst, size_t size);
+}
+
+#endif
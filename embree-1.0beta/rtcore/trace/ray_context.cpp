@@ -0,0 +1,54 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "ray_context.h"
+
+namespace embree
+{
+  /*! Contexts of the 4 rays of a packet of the calling thread,
+   *  single rays use the first one. Thread local variables cannot
+   *  have constructors, thus the fields are stored separately. */
+  static __thread int32 contextPixelX[4] = { -1, -1, -1, -1 };
+  static __thread int32 contextPixelY[4] = { -1, -1, -1, -1 };
+  static __thread int32 contextSample[4] = { -1, -1, -1, -1 };
+
+  void setRayContext(const RayContext& context)
+  {
+    for (size_t i=0; i<4; i++) {
+      contextPixelX[i] = context.pixelX;
+      contextPixelY[i] = context.pixelY;
+      contextSample[i] = context.sample;
+    }
+  }
+
+  void setRayContext4(const RayContext* contexts)
+  {
+    for (size_t i=0; i<4; i++) {
+      contextPixelX[i] = contexts[i].pixelX;
+      contextPixelY[i] = contexts[i].pixelY;
+      contextSample[i] = contexts[i].sample;
+    }
+  }
+
+  RayContext getRayContext() {
+    return RayContext(contextPixelX[0],contextPixelY[0],contextSample[0]);
+  }
+
+  RayContext getRayContext4(size_t i) {
+    return RayContext(contextPixelX[i],contextPixelY[i],contextSample[i]);
+  }
+}
@@ -0,0 +1,63 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef __EMBREE_RAY_CONTEXT_H__
+#define __EMBREE_RAY_CONTEXT_H__
+
+#include "../common/default.h"
+
+namespace embree
+{
+  /*! Describes where the rays a thread currently shoots come
+   *  from. The renderer sets the context of a thread before it
+   *  shoots the rays of a sample, thus code below the Intersector
+   *  interface can attribute rays to pixels without changing the
+   *  interface. Pixel and sample are -1 for rays shot outside of a
+   *  renderer. */
+  struct RayContext
+  {
+    /*! Default construction creates an unknown context. */
+    __forceinline RayContext () : pixelX(-1), pixelY(-1), sample(-1) {}
+
+    /*! Constructs a context from pixel coordinates and sample index. */
+    __forceinline RayContext (int32 pixelX, int32 pixelY, int32 sample)
+      : pixelX(pixelX), pixelY(pixelY), sample(sample) {}
+
+  public:
+    int32 pixelX;   //!< Horizontal pixel coordinate.
+    int32 pixelY;   //!< Vertical pixel coordinate.
+    int32 sample;   //!< Index of the sample in its pixel, counted over all accumulated frames.
+  };
+
+  /*! Sets the ray context of the calling thread. The context also
+   *  applies to all rays of the packets the thread shoots. */
+  void setRayContext(const RayContext& context);
+
+  /*! Sets one context per ray of the packets of 4 rays the calling
+   *  thread shoots, for renderers that trace the rays of different
+   *  samples together. Single rays keep the context of the first
+   *  ray. */
+  void setRayContext4(const RayContext* contexts);
+
+  /*! Returns the ray context of the calling thread. */
+  RayContext getRayContext();
+
+  /*! Returns the context of the i'th ray of a packet of 4 rays. */
+  RayContext getRayContext4(size_t i);
+}
+
+#endif
@@ -0,0 +1,108 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "trace_format.h"
+#include "lz4.h"
+
+namespace embree
+{
+  /*! Transposes records of n fields into columns. */
+  static void transpose(const int32* fields, size_t n, size_t num, int32* dst)
+  {
+    for (size_t i=0; i<num; i++)
+      for (size_t c=0; c<n; c++) dst[c*num+i] = fields[i*n+c];
+  }
+
+  /*! Transposes records of n fields into columns and splits the
+   *  columns into byte planes, i.e. first the lowest byte of every
+   *  field, then the second byte, and so on. The exponent and sign
+   *  bytes of neighbouring floats are mostly equal, which LZ4
+   *  compresses well. */
+  static void transposeShuffled(const int32* fields, size_t n, size_t num, uint8* dst)
+  {
+    const size_t words = num*n;
+    for (size_t i=0; i<num; i++) {
+      for (size_t c=0; c<n; c++) {
+        const uint32 v = fields[i*n+c];
+        const size_t j = c*num+i;
+        dst[0*words+j] = uint8(v >>  0);
+        dst[1*words+j] = uint8(v >>  8);
+        dst[2*words+j] = uint8(v >> 16);
+        dst[3*words+j] = uint8(v >> 24);
+      }
+    }
+  }
+
+  /*! Merges byte planes back into columns. */
+  static void unshuffle(const uint8* src, size_t words, uint32* dst)
+  {
+    for (size_t j=0; j<words; j++)
+      dst[j] = uint32(src[j]) | uint32(src[words+j]) << 8 | uint32(src[2*words+j]) << 16 | uint32(src[3*words+j]) << 24;
+  }
+
+  size_t encodeTraceChunk(const int32* fields, size_t fieldsPerRecord, size_t num, TraceChunkHeader::Compression compression, char* scratch, char* dst)
+  {
+    TraceChunkHeader* header = (TraceChunkHeader*) dst;
+    char* payload = dst + sizeof(TraceChunkHeader);
+    const size_t rawBytes = num*fieldsPerRecord*sizeof(int32);
+
+    header->numRecords = int32(num);
+    header->rawBytes = int32(rawBytes);
+    for (size_t i=0; i<TraceRecord::numTypes; i++) header->histogram[i] = 0;
+    header->minDepth = num ? ((const TraceRecord*)fields)->depth : 0;
+    header->maxDepth = num ? ((const TraceRecord*)fields)->depth : 0;
+    for (size_t i=0; i<num; i++) {
+      const TraceRecord& record = *(const TraceRecord*)&fields[i*fieldsPerRecord];
+      header->histogram[record.type & 3]++;
+      header->minDepth = min(header->minDepth,record.depth);
+      header->maxDepth = max(header->maxDepth,record.depth);
+    }
+
+    size_t storedBytes = 0;
+    if (compression == TraceChunkHeader::LZ4) {
+      transposeShuffled(fields,fieldsPerRecord,num,(uint8*)scratch);
+      storedBytes = lz4Compress(scratch,rawBytes,payload,rawBytes);
+    }
+    if (storedBytes == 0 || storedBytes >= rawBytes) {
+      compression = TraceChunkHeader::NONE;
+      transpose(fields,fieldsPerRecord,num,(int32*)payload);
+      storedBytes = rawBytes;
+    }
+    header->compression = compression;
+    header->storedBytes = int32(storedBytes);
+
+    const size_t paddedBytes = paddedTraceChunkBytes(*header);
+    memset(payload+storedBytes,0,paddedBytes-storedBytes);
+    return sizeof(TraceChunkHeader) + paddedBytes;
+  }
+
+  void decodeTraceChunk(const TraceChunkHeader& header, const char* payload, char* dst, char* scratch)
+  {
+    switch (header.compression) {
+    case TraceChunkHeader::NONE:
+      memcpy(dst,payload,header.rawBytes);
+      break;
+    case TraceChunkHeader::LZ4:
+      if (!lz4Decompress(payload,header.storedBytes,scratch,header.rawBytes))
+        throw std::runtime_error("corrupt trace chunk");
+      unshuffle((const uint8*)scratch,header.rawBytes/sizeof(int32),(uint32*)dst);
+      break;
+    default:
+      throw std::runtime_error("unknown trace chunk compression");
+    }
+  }
+}
@@ -0,0 +1,118 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef __EMBREE_TRACE_FORMAT_H__
+#define __EMBREE_TRACE_FORMAT_H__
+
+#include "trace_record.h"
+
+namespace embree
+{
+  /*! Version 2 of the ray trace file format, see
+   *  documentation/Ray_Trace_File_Format.txt. A file consists of a
+   *  header, a sequence of chunks, an index of all chunks, and a
+   *  footer that locates the index. The records of a chunk are
+   *  stored as structure of arrays, i.e. first the types of all
+   *  records, then the depths, the origins x, y, z, and the vectors
+   *  x, y, z, followed by the optional fields enabled in the flags
+   *  of the file header. Every field is 4 bytes large. */
+
+  /*! Header at the beginning of a version 2 file. */
+  struct TraceFileHeader
+  {
+    enum { MAGIC = 0x32545652 };      //!< The characters "RVT2".
+
+    /*! Optional fields of the records. */
+    enum Flags {
+      WEIGHTS = 1,                    //!< Records carry a float sampling weight.
+      EXTENDED = 2                    //!< Records carry a TraceRecordExt after the weight.
+    };
+
+    int32 magic;                      //!< Identifies the file format.
+    int32 version;                    //!< Version of the format, always 2.
+    int32 recordsPerChunk;            //!< Maximal number of records of a chunk.
+    int32 flags;                      //!< Optional fields of the records.
+  };
+
+  /*! Index of the first field of the extension of a record with the given optional fields. */
+  __forceinline size_t traceExtendedField(int32 flags) {
+    return sizeof(TraceRecord)/sizeof(int32) + ((flags & TraceFileHeader::WEIGHTS) ? 1 : 0);
+  }
+
+  /*! Number of 4 byte fields of a record with the given optional fields. */
+  __forceinline size_t traceFieldsPerRecord(int32 flags) {
+    return traceExtendedField(flags) + ((flags & TraceFileHeader::EXTENDED) ? sizeof(TraceRecordExt)/sizeof(int32) : 0);
+  }
+
+  /*! Header in front of the payload of each chunk. */
+  struct TraceChunkHeader
+  {
+    /*! Encodings of the payload. */
+    enum Compression {
+      NONE = 0,  //!< The payload are the plain columns.
+      LZ4  = 1   //!< The columns are byte shuffled and LZ4 block compressed.
+    };
+
+    int32 numRecords;                        //!< Number of records in the chunk.
+    int32 compression;                       //!< Encoding of the payload.
+    int32 rawBytes;                          //!< Size of the decoded payload.
+    int32 storedBytes;                       //!< Size of the encoded payload, padded to a multiple of 4 in the file.
+    int32 histogram[TraceRecord::numTypes];  //!< Number of records of each ray type.
+    int32 minDepth;                          //!< Smallest depth of a record in the chunk.
+    int32 maxDepth;                          //!< Largest depth of a record in the chunk.
+  };
+
+  /*! Entry of the chunk index. */
+  struct TraceIndexEntry
+  {
+    int64 offset;                     //!< File offset of the chunk header.
+    TraceChunkHeader header;          //!< Copy of the chunk header.
+  };
+
+  /*! Footer at the end of a version 2 file. */
+  struct TraceFooter
+  {
+    int64 indexOffset;                //!< File offset of the first index entry.
+    int32 numChunks;                  //!< Number of chunks and index entries.
+    int32 sentinel;                   //!< Always TraceRecord::SENTINEL.
+  };
+
+  /*! Size of the padded payload of a chunk in the file. */
+  __forceinline size_t paddedTraceChunkBytes(const TraceChunkHeader& header) {
+    return (size_t(header.storedBytes) + 3) & ~size_t(3);
+  }
+
+  /*! Maximal size of an encoded chunk including its header. */
+  __forceinline size_t maxTraceChunkBytes(size_t numRecords, size_t fieldsPerRecord) {
+    return sizeof(TraceChunkHeader) + numRecords*fieldsPerRecord*sizeof(int32);
+  }
+
+  /*! Encodes records into a chunk header followed by its payload.
+   *  Each record consists of fieldsPerRecord fields, the first ones
+   *  laid out as a TraceRecord. The destination needs to hold
+   *  maxTraceChunkBytes bytes, the scratch memory the fields of num
+   *  records. Returns the number of bytes written. If compression
+   *  does not reduce the size the chunk is stored uncompressed. */
+  size_t encodeTraceChunk(const int32* fields, size_t fieldsPerRecord, size_t num, TraceChunkHeader::Compression compression, char* scratch, char* dst);
+
+  /*! Decodes the payload of a chunk into its columns. The
+   *  destination and scratch memory need to hold header.rawBytes
+   *  bytes. Throws if the payload is corrupt. */
+  void decodeTraceChunk(const TraceChunkHeader& header, const char* payload, char* dst, char* scratch);
+}
+
+#endif
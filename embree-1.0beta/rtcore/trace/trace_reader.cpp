@@ -0,0 +1,197 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "trace_reader.h"
+
+namespace embree
+{
+  /*! Weight of records of files without weights. */
+  static const float unitWeight = 1.0f;
+
+  /*! Fields of records without extension. */
+  static const int32 unknownIndex = -1;
+  static const float defaultNear = 0.0f;
+  static const float defaultFar = float(inf);
+
+  /*! Points the extension columns of a view to the fields of records without extension. */
+  static void clearExtension(TraceView& view)
+  {
+    view.pixelX = view.pixelY = view.sample = TraceColumn<int32>((const char*)&unknownIndex,0);
+    view.id0 = view.id1 = TraceColumn<int32>((const char*)&unknownIndex,0);
+    view.near = TraceColumn<float>((const char*)&defaultNear,0);
+    view.far  = TraceColumn<float>((const char*)&defaultFar ,0);
+  }
+
+  TraceReader::TraceReader(const FileName& fileName, bool legacy)
+    : fileFlags(0), legacyLayout(false), numRecords(0)
+  {
+    mapping = mapFile(fileName);
+    data = mappedData(mapping);
+    bytes = mappedSize(mapping);
+
+    try {
+      if (bytes >= sizeof(TraceFileHeader) && ((const TraceFileHeader*)data)->magic == TraceFileHeader::MAGIC) openV2(fileName);
+      else { openV1(fileName); legacyLayout = legacy; }
+    }
+    catch (...) {
+      unmapFile(mapping);
+      throw;
+    }
+  }
+
+  TraceReader::~TraceReader() {
+    unmapFile(mapping);
+  }
+
+  void TraceReader::openV1(const FileName& fileName)
+  {
+    fileVersion = 1;
+    if (bytes % sizeof(TraceRecord) != sizeof(int32) || *(const int32*)(data+bytes-sizeof(int32)) != TraceRecord::SENTINEL)
+      throw std::runtime_error("invalid ray trace file " + fileName.str());
+
+    numRecords = bytes/sizeof(TraceRecord);
+    for (size_t first=0; first<numRecords; first+=recordsPerChunk)
+    {
+      Chunk chunk;
+      chunk.data = data + first*sizeof(TraceRecord);
+      chunk.first = first;
+      memset(&chunk.header,0,sizeof(TraceChunkHeader));
+      chunk.header.numRecords = int32(min(size_t(recordsPerChunk),numRecords-first));
+      chunk.header.rawBytes = chunk.header.storedBytes = chunk.header.numRecords*int32(sizeof(TraceRecord));
+      chunk.header.minDepth = 0;
+      chunk.header.maxDepth = 0x7fffffff;
+      chunks.push_back(chunk);
+    }
+  }
+
+  void TraceReader::openV2(const FileName& fileName)
+  {
+    const TraceFileHeader& fileHeader = *(const TraceFileHeader*)data;
+    if (fileHeader.version != 2 || bytes < sizeof(TraceFileHeader)+sizeof(TraceFooter))
+      throw std::runtime_error("invalid ray trace file " + fileName.str());
+    fileVersion = 2;
+    fileFlags = fileHeader.flags;
+    const size_t recordBytes = traceFieldsPerRecord(fileFlags)*sizeof(int32);
+
+    const TraceFooter& footer = *(const TraceFooter*)(data+bytes-sizeof(TraceFooter));
+    const size_t indexBytes = size_t(footer.numChunks)*sizeof(TraceIndexEntry);
+    if (footer.sentinel != TraceRecord::SENTINEL || footer.numChunks < 0 || footer.indexOffset < int64(sizeof(TraceFileHeader)) ||
+        size_t(footer.indexOffset) + indexBytes + sizeof(TraceFooter) != bytes)
+      throw std::runtime_error("invalid ray trace file " + fileName.str());
+
+    const TraceIndexEntry* index = (const TraceIndexEntry*)(data+footer.indexOffset);
+    for (int32 i=0; i<footer.numChunks; i++)
+    {
+      const TraceChunkHeader& header = index[i].header;
+      const size_t offset = size_t(index[i].offset);
+      if (index[i].offset < int64(sizeof(TraceFileHeader)) || header.numRecords < 0 || header.storedBytes < 0 ||
+          size_t(header.rawBytes) != size_t(header.numRecords)*recordBytes ||
+          (header.compression == TraceChunkHeader::NONE && header.storedBytes != header.rawBytes) ||
+          offset + sizeof(TraceChunkHeader) + paddedTraceChunkBytes(header) > size_t(footer.indexOffset) ||
+          memcmp(&header,data+offset,sizeof(TraceChunkHeader)) != 0)
+        throw std::runtime_error("invalid chunk in ray trace file " + fileName.str());
+
+      Chunk chunk;
+      chunk.data = data + offset + sizeof(TraceChunkHeader);
+      chunk.first = numRecords;
+      chunk.header = header;
+      chunks.push_back(chunk);
+      numRecords += header.numRecords;
+    }
+  }
+
+  size_t TraceReader::findChunk(size_t record) const
+  {
+    size_t lo = 0, hi = chunks.size();
+    while (hi-lo > 1) {
+      size_t mid = (lo+hi)/2;
+      if (chunks[mid].first <= record) lo = mid; else hi = mid;
+    }
+    return lo;
+  }
+
+  TraceView TraceReader::chunk(size_t i, std::vector<char>& buffer) const
+  {
+    const Chunk& c = chunks[i];
+    const size_t num = c.header.numRecords;
+
+    TraceView view;
+    view.num = num;
+    view.anyHitDirections = false;
+    if (fileVersion == 1) {
+      const size_t stride = sizeof(TraceRecord);
+      const char* records = c.data;
+
+      /*! the original printer wrote 3 for occluded and 2 for connected AnyHit rays */
+      if (legacyLayout) {
+        buffer.resize(max(num,size_t(1))*stride);
+        memcpy(&buffer[0],c.data,num*stride);
+        TraceRecord* converted = (TraceRecord*)&buffer[0];
+        for (size_t j=0; j<num; j++) {
+          if      (converted[j].type == TraceRecord::ABRK) converted[j].type = TraceRecord::ACON;
+          else if (converted[j].type == TraceRecord::ACON) converted[j].type = TraceRecord::ABRK;
+        }
+        records = &buffer[0];
+        view.anyHitDirections = true;
+      }
+
+      const TraceRecord& r = *(const TraceRecord*)records;
+      view.type  = TraceColumn<int32>((const char*)&r.type  ,stride);
+      view.depth = TraceColumn<int32>((const char*)&r.depth ,stride);
+      view.orgx  = TraceColumn<float>((const char*)&r.org[0],stride);
+      view.orgy  = TraceColumn<float>((const char*)&r.org[1],stride);
+      view.orgz  = TraceColumn<float>((const char*)&r.org[2],stride);
+      view.vecx  = TraceColumn<float>((const char*)&r.vec[0],stride);
+      view.vecy  = TraceColumn<float>((const char*)&r.vec[1],stride);
+      view.vecz  = TraceColumn<float>((const char*)&r.vec[2],stride);
+      view.weight = TraceColumn<float>((const char*)&unitWeight,0);
+      clearExtension(view);
+      return view;
+    }
+
+    const char* columns = c.data;
+    if (c.header.compression != TraceChunkHeader::NONE) {
+      buffer.resize(2*c.header.rawBytes);
+      if (c.header.rawBytes) decodeTraceChunk(c.header,c.data,&buffer[0],&buffer[c.header.rawBytes]);
+      columns = buffer.empty() ? NULL : &buffer[0];
+    }
+
+    const size_t column = num*sizeof(int32);
+    view.type  = TraceColumn<int32>(columns+0*column,sizeof(int32));
+    view.depth = TraceColumn<int32>(columns+1*column,sizeof(int32));
+    view.orgx  = TraceColumn<float>(columns+2*column,sizeof(float));
+    view.orgy  = TraceColumn<float>(columns+3*column,sizeof(float));
+    view.orgz  = TraceColumn<float>(columns+4*column,sizeof(float));
+    view.vecx  = TraceColumn<float>(columns+5*column,sizeof(float));
+    view.vecy  = TraceColumn<float>(columns+6*column,sizeof(float));
+    view.vecz  = TraceColumn<float>(columns+7*column,sizeof(float));
+    if (fileFlags & TraceFileHeader::WEIGHTS) view.weight = TraceColumn<float>(columns+8*column,sizeof(float));
+    else view.weight = TraceColumn<float>((const char*)&unitWeight,0);
+    if (fileFlags & TraceFileHeader::EXTENDED) {
+      const char* ext = columns+traceExtendedField(fileFlags)*column;
+      view.pixelX = TraceColumn<int32>(ext+0*column,sizeof(int32));
+      view.pixelY = TraceColumn<int32>(ext+1*column,sizeof(int32));
+      view.sample = TraceColumn<int32>(ext+2*column,sizeof(int32));
+      view.id0    = TraceColumn<int32>(ext+3*column,sizeof(int32));
+      view.id1    = TraceColumn<int32>(ext+4*column,sizeof(int32));
+      view.near   = TraceColumn<float>(ext+5*column,sizeof(float));
+      view.far    = TraceColumn<float>(ext+6*column,sizeof(float));
+    }
+    else clearExtension(view);
+    return view;
+  }
+}
@@ -0,0 +1,167 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef __EMBREE_TRACE_READER_H__
+#define __EMBREE_TRACE_READER_H__
+
+#include "trace_format.h"
+#include "sys/filename.h"
+#include "sys/mapping.h"
+
+namespace embree
+{
+  /*! Random access column of a trace. Elements are stride bytes apart. */
+  template<typename T>
+    struct TraceColumn
+  {
+    __forceinline TraceColumn () : base(NULL), stride(0) {}
+    __forceinline TraceColumn (const char* base, size_t stride) : base(base), stride(stride) {}
+
+    /*! Returns the i'th element of the column. */
+    __forceinline const T& operator[](size_t i) const { return *(const T*)(base + i*stride); }
+
+    /*! Returns true if the elements are stored contiguously. */
+    __forceinline bool dense() const { return stride == sizeof(T); }
+
+  public:
+    const char* base;   //!< Pointer to the first element.
+    size_t stride;      //!< Distance of two elements in bytes.
+  };
+
+  /*! Structure of arrays view of the records of a chunk. */
+  struct TraceView
+  {
+    /*! Returns the origin of the i'th ray. */
+    __forceinline Vec3f org(size_t i) const { return Vec3f(orgx[i],orgy[i],orgz[i]); }
+
+    /*! Returns the difference or direction of the i'th ray. */
+    __forceinline Vec3f vec(size_t i) const { return Vec3f(vecx[i],vecy[i],vecz[i]); }
+
+    /*! Returns the i'th record. */
+    __forceinline TraceRecord record(size_t i) const { return TraceRecord(type[i],depth[i],org(i),vec(i)); }
+
+    /*! Returns true if the records carry sampling weights. */
+    __forceinline bool weighted() const { return weight.stride != 0; }
+
+    /*! Returns true if AnyHit records store the direction of an unbounded segment instead of the difference. */
+    __forceinline bool directions() const { return anyHitDirections; }
+
+    /*! Returns true if the records carry the fields of a TraceRecordExt. */
+    __forceinline bool extended() const { return sample.stride != 0; }
+
+    /*! Returns the extension of the i'th record. */
+    __forceinline TraceRecordExt ext(size_t i) const {
+      return TraceRecordExt(RayContext(pixelX[i],pixelY[i],sample[i]),id0[i],id1[i],near[i],far[i]);
+    }
+
+  public:
+    size_t num;                          //!< Number of records.
+    TraceColumn<int32> type;             //!< Ray types, see TraceRecord::Type.
+    TraceColumn<int32> depth;            //!< Recursion depths.
+    TraceColumn<float> orgx, orgy, orgz; //!< Ray origins.
+    TraceColumn<float> vecx, vecy, vecz; //!< Differences to the hit point or ray directions.
+    TraceColumn<float> weight;           //!< Sampling weights, 1 for traces of all rays.
+    TraceColumn<int32> pixelX, pixelY;   //!< Pixel coordinates, -1 without extended records.
+    TraceColumn<int32> sample;           //!< Sample indices, -1 without extended records.
+    TraceColumn<int32> id0, id1;         //!< IDs of the hit primitives, -1 without extended records.
+    TraceColumn<float> near, far;        //!< Ray segments, 0 and infinity without extended records.
+    bool anyHitDirections;               //!< AnyHit records hold directions, as in legacy version 1 files.
+  };
+
+  /*! Reads version 1 and version 2 ray trace files. The file is
+   *  memory mapped and views point directly into the mapping, only
+   *  compressed chunks get decoded into memory of the caller. Version
+   *  1 files are presented as chunks of recordsPerChunk records with
+   *  strided columns, whose headers only hold the record count and
+   *  a conservative depth range. Version 1 files written by the
+   *  original printer swap the ABrk and ACon IDs and store only the
+   *  direction of AnyHit rays. The layouts cannot be told apart, thus
+   *  the caller has to ask for the legacy layout, whose chunks get
+   *  converted into memory of the caller. The reader does not change
+   *  after construction, thus threads can read chunks in parallel. */
+  class TraceReader : public RefCount
+  {
+  public:
+
+    /*! Number of records of the chunks of a version 1 file. */
+    enum { recordsPerChunk = 32*1024 };
+
+    /*! Maps the file and validates its structure. Version 1 files
+     *  are read in the legacy layout if requested. */
+    TraceReader(const FileName& fileName, bool legacy = false);
+
+    /*! Unmaps the file. */
+    ~TraceReader();
+
+    /*! Version of the file format. */
+    __forceinline int version() const { return fileVersion; }
+
+    /*! Returns true if the records get converted from the legacy version 1 layout. */
+    __forceinline bool legacy() const { return legacyLayout; }
+
+    /*! Optional fields of the records, see TraceFileHeader::Flags. */
+    __forceinline int32 flags() const { return fileFlags; }
+
+    /*! Total number of records. */
+    __forceinline size_t size() const { return numRecords; }
+
+    /*! Number of chunks of the file. */
+    __forceinline size_t numChunks() const { return chunks.size(); }
+
+    /*! Header of the i'th chunk. */
+    __forceinline const TraceChunkHeader& header(size_t i) const { return chunks[i].header; }
+
+    /*! Index of the first record of the i'th chunk. */
+    __forceinline size_t firstRecord(size_t i) const { return chunks[i].first; }
+
+    /*! Index of the chunk that contains the given record. */
+    size_t findChunk(size_t record) const;
+
+    /*! Returns a view of the records of the i'th chunk. The buffer
+     *  receives the decoded columns of compressed chunks and the
+     *  converted records of legacy files and has to stay alive while
+     *  the view is used. */
+    TraceView chunk(size_t i, std::vector<char>& buffer) const;
+
+  private:
+
+    /*! Location of a chunk. */
+    struct Chunk {
+      const char* data;          //!< Start of the payload (version 2) or of the first record (version 1).
+      size_t first;              //!< Index of the first record.
+      TraceChunkHeader header;   //!< Header of the chunk.
+    };
+
+    /*! Builds chunks of a version 1 file. */
+    void openV1(const FileName& fileName);
+
+    /*! Builds chunks from the index of a version 2 file. */
+    void openV2(const FileName& fileName);
+
+  private:
+    mapping_t mapping;           //!< Mapping of the file.
+    const char* data;            //!< Mapped file contents.
+    size_t bytes;                //!< Size of the file.
+    int fileVersion;             //!< Version of the file format.
+    int32 fileFlags;             //!< Optional fields of the records.
+    bool legacyLayout;           //!< Version 1 file in the layout of the original printer.
+    size_t numRecords;           //!< Total number of records.
+    std::vector<Chunk> chunks;   //!< All chunks of the file.
+  };
+}
+
+#endif
@@ -0,0 +1,85 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef __EMBREE_TRACE_RECORD_H__
+#define __EMBREE_TRACE_RECORD_H__
+
+#include "ray_context.h"
+
+namespace embree
+{
+  /*! A single ray cast as stored in a ray trace file. The layout
+   *  matches the RayCast production of
+   *  documentation/Ray_Trace_File_Format.txt, i.e. a record is the
+   *  ray type, the recursion depth, the origin, and the difference
+   *  (or direction for misses) of the ray. */
+  struct TraceRecord
+  {
+    /*! Ray types. */
+    enum Type {
+      FHIT = 0,      //!< FirstHit-Hit (intersection was found)
+      FMIS = 1,      //!< FirstHit-Miss (intersection not found)
+      ABRK = 2,      //!< AnyHit-Broken (intersection was found)
+      ACON = 3,      //!< AnyHit-Connected (intersection not found)
+      numTypes = 4   //!< Number of different ray types.
+    };
+
+    /*! End of file sentinel. */
+    enum { SENTINEL = 9215 };
+
+    /*! Default construction does nothing. */
+    __forceinline TraceRecord() {}
+
+    /*! Constructs a record from a ray and the vector to store. */
+    __forceinline TraceRecord(int32 type, int32 depth, const Vec3f& org, const Vec3f& vec)
+      : type(type), depth(depth)
+    {
+      this->org[0] = org.x; this->org[1] = org.y; this->org[2] = org.z;
+      this->vec[0] = vec.x; this->vec[1] = vec.y; this->vec[2] = vec.z;
+    }
+
+  public:
+    int32 type;    //!< Type of the ray.
+    int32 depth;   //!< Recursion depth the ray was shot at.
+    float org[3];  //!< Origin of the ray.
+    float vec[3];  //!< Difference to the hit point or direction of the ray.
+  };
+
+  /*! Optional extension of a record that identifies the sample a
+   *  ray belongs to, the primitive it hit, and the tested segment of
+   *  the ray. Stored only in traces with extended records. */
+  struct TraceRecordExt
+  {
+    /*! Default construction does nothing. */
+    __forceinline TraceRecordExt() {}
+
+    /*! Constructs an extension from the context and the results of a ray. */
+    __forceinline TraceRecordExt(const RayContext& context, int32 id0, int32 id1, float near, float far)
+      : pixelX(context.pixelX), pixelY(context.pixelY), sample(context.sample), id0(id0), id1(id1), near(near), far(far) {}
+
+  public:
+    int32 pixelX;  //!< Horizontal pixel coordinate, -1 if unknown.
+    int32 pixelY;  //!< Vertical pixel coordinate, -1 if unknown.
+    int32 sample;  //!< Index of the sample in its pixel, -1 if unknown.
+    int32 id0;     //!< 1st ID of the hit primitive, -1 for misses and AnyHit rays.
+    int32 id1;     //!< 2nd ID of the hit primitive, -1 for misses and AnyHit rays.
+    float near;    //!< Start of the ray segment.
+    float far;     //!< End of the ray segment.
+  };
+}
+
+#endif
@@ -0,0 +1,209 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "trace_replay.h"
+
+#include <iomanip>
+
+namespace embree
+{
+  /*! Names of the ray types. */
+  static const char* typeNames[TraceRecord::numTypes] = { "FHit", "FMis", "ABrk", "ACon" };
+
+  /*! Names of the type changes of a ray. */
+  static const char* mismatchNames[TraceRecord::numTypes] = { "FHit now misses", "FMis now hits", "ABrk now connects", "ACon now breaks" };
+
+  /*! Upper bounds of the bins of the error histogram, the first bin only counts exact matches. */
+  static const float errorBounds[TraceReplay::numErrorBins] = { 0.0f, 1E-6f, 1E-5f, 1E-4f, 1E-3f, 1E-2f, float(inf) };
+
+  /*! Names of the bins of the error histogram. */
+  static const char* errorNames[TraceReplay::numErrorBins] = { "= 0", "< 1e-6", "< 1e-5", "< 1e-4", "< 1e-3", "< 1e-2", ">= 1e-2" };
+
+  TraceReplay::Stats::Stats ()
+  {
+    for (size_t t=0; t<TraceRecord::numTypes; t++) mismatches[t] = 0.0;
+    for (size_t i=0; i<numErrorBins; i++) errors[i] = 0.0;
+    otherPrimitive = 0.0;
+  }
+
+  void TraceReplay::Stats::add(const Stats& other)
+  {
+    for (size_t t=0; t<TraceRecord::numTypes; t++) {
+      for (size_t d=0; d<=maxDepth; d++) {
+        buckets[t][d].records += other.buckets[t][d].records;
+        buckets[t][d].rays += other.buckets[t][d].rays;
+        buckets[t][d].timed += other.buckets[t][d].timed;
+        buckets[t][d].cycles += other.buckets[t][d].cycles;
+      }
+      mismatches[t] += other.mismatches[t];
+    }
+    for (size_t i=0; i<numErrorBins; i++) errors[i] += other.errors[i];
+    otherPrimitive += other.otherPrimitive;
+  }
+
+  size_t TraceReplay::errorBin(float error)
+  {
+    if (error == 0.0f) return 0;
+    for (size_t i=1; i<numErrorBins-1; i++)
+      if (error < errorBounds[i]) return i;
+    return numErrorBins-1;
+  }
+
+  double TraceReplay::numMismatches() const
+  {
+    double num = 0.0;
+    for (size_t t=0; t<TraceRecord::numTypes; t++) num += stats.mismatches[t];
+    return num;
+  }
+
+  TraceReplay::TraceReplay (const Ref<Intersector>& accel, const Ref<TraceReader>& trace, float epsilon)
+    : accel(accel), trace(trace), epsilon(epsilon), seconds(0.0), cyclesPerSecond(1.0) {}
+
+  Ray TraceReplay::ray(const TraceView& view, size_t i, float epsilon)
+  {
+    const Vec3f org = view.org(i), vec = view.vec(i);
+    const float len = length(vec);
+    const Vec3f dir = len > 0.0f ? vec/len : Vec3f(0.0f,0.0f,1.0f);
+    if (view.extended()) return Ray(org,dir,view.near[i],view.far[i]);
+
+    const float near = view.depth[i] == 0 ? 0.0f : epsilon*reduce_max(abs(org));
+
+    if (view.type[i] == TraceRecord::ABRK || view.type[i] == TraceRecord::ACON) return Ray(org,dir,near,view.directions() ? float(inf) : len);
+    else return Ray(org,dir,near,inf);
+  }
+
+  void TraceReplay::run()
+  {
+    stats = Stats();
+    chunkID = 0;
+
+    double t0 = getSeconds();
+    uint64 c0 = rdtsc();
+    scheduler->addTask((Task::runFunction)&run_replayThread,this,scheduler->getNumThreads());
+    scheduler->go();
+    uint64 c1 = rdtsc();
+    double t1 = getSeconds();
+
+    seconds = t1-t0;
+    cyclesPerSecond = double(c1-c0)/max(seconds,1E-9);
+  }
+
+  void TraceReplay::replayThread()
+  {
+    Stats local;
+    std::vector<char> buffer;
+
+    while (true)
+    {
+      /*! pick the next chunk */
+      size_t chunk = chunkID++;
+      if (chunk >= trace->numChunks()) break;
+      TraceView view = trace->chunk(chunk,buffer);
+
+      for (size_t i=0; i<view.num; i++)
+      {
+        const int32 type = view.type[i];
+        if (type < 0 || type >= TraceRecord::numTypes) continue;
+        const Ray ray = TraceReplay::ray(view,i,epsilon);
+        const int32 depth = view.depth[i];
+        const double weight = view.weight[i];
+
+        /*! only the traversal of a sample of the rays is timed, the check happens afterwards */
+        Bucket& bucket = local.buckets[type][clamp(depth,0,int32(maxDepth))];
+        const bool timed = bucket.records++ % timingStride == 0;
+        bucket.rays += weight;
+        bool changed = false;
+        uint64 c0 = timed ? rdtsc() : 0, c1 = c0;
+        if (type == TraceRecord::FHIT || type == TraceRecord::FMIS) {
+          Hit hit; accel->intersect(ray,hit,depth);
+          if (timed) c1 = rdtsc();
+          changed = bool(hit) != (type == TraceRecord::FHIT);
+          if (hit && !changed) {
+            const Vec3f vec = view.vec(i);
+            local.errors[errorBin(length(ray.dir*hit.t-vec)/length(vec))] += weight;
+            if (view.extended() && (hit.id0 != view.id0[i] || hit.id1 != view.id1[i])) local.otherPrimitive += weight;
+          }
+        } else {
+          bool occluded = accel->occluded(ray,depth);
+          if (timed) c1 = rdtsc();
+          changed = occluded != (type == TraceRecord::ABRK);
+        }
+        if (changed) local.mismatches[type] += weight;
+
+        if (timed) {
+          bucket.timed += weight;
+          bucket.cycles += weight*double(c1-c0);
+        }
+      }
+    }
+
+    Lock<MutexSys> lock(mutex);
+    stats.add(local);
+  }
+
+  void TraceReplay::print(std::ostream& cout) const
+  {
+    Bucket total;
+    for (size_t t=0; t<TraceRecord::numTypes; t++)
+      for (size_t d=0; d<=maxDepth; d++) {
+        total.records += stats.buckets[t][d].records;
+        total.rays += stats.buckets[t][d].rays;
+        total.timed += stats.buckets[t][d].timed;
+        total.cycles += stats.buckets[t][d].cycles;
+      }
+
+    /*! weighted counts are rounded to whole rays */
+    const std::ios::fmtflags flags = cout.flags();
+    const std::streamsize precision = cout.precision();
+    cout << "replayed " << total.records << " rays in " << seconds*1000.0 << " ms, "
+         << total.records/max(seconds,1E-9)*1E-6 << " Mrps, " << scheduler->getNumThreads() << " threads" << std::endl;
+    cout << std::fixed << std::setprecision(0);
+    if (trace->flags() & TraceFileHeader::WEIGHTS)
+      cout << "sampled rays stand for " << total.rays << " rays of the full trace" << std::endl;
+    cout << "  type depth        rays   Mrps/thread" << std::endl;
+
+    /*! rays per second of a single thread, as the cycles of all threads are summed */
+    for (size_t t=0; t<TraceRecord::numTypes; t++)
+    {
+      Bucket sum;
+      for (size_t d=0; d<=maxDepth; d++) {
+        const Bucket& b = stats.buckets[t][d];
+        if (b.records == 0) continue;
+        sum.records += b.records; sum.rays += b.rays; sum.timed += b.timed; sum.cycles += b.cycles;
+        cout << "  " << typeNames[t] << " " << std::setw(4) << d << (d == maxDepth ? "+" : " ")
+             << std::setw(12) << b.rays << std::setprecision(3) << std::setw(14) << b.timed*cyclesPerSecond/max(b.cycles,1.0)*1E-6 << std::setprecision(0) << std::endl;
+      }
+      if (sum.records == 0) continue;
+      cout << "  " << typeNames[t] << "  all" << std::setw(12) << sum.rays
+           << std::setprecision(3) << std::setw(14) << sum.timed*cyclesPerSecond/max(sum.cycles,1.0)*1E-6 << std::setprecision(0) << std::endl;
+    }
+    cout << "   all  all" << std::setw(12) << total.rays
+         << std::setprecision(3) << std::setw(14) << total.timed*cyclesPerSecond/max(total.cycles,1.0)*1E-6 << std::setprecision(0) << std::endl;
+
+    cout << numMismatches() << " of " << total.rays << " rays changed their type" << std::endl;
+    for (size_t t=0; t<TraceRecord::numTypes; t++)
+      cout << "  " << std::setw(18) << std::left << mismatchNames[t] << std::right << std::setw(12) << stats.mismatches[t] << std::endl;
+
+    cout << "relative error of FHit hit points" << std::endl;
+    for (size_t i=0; i<numErrorBins; i++)
+      cout << "  " << std::setw(18) << std::left << errorNames[i] << std::right << std::setw(12) << stats.errors[i] << std::endl;
+    if (trace->flags() & TraceFileHeader::EXTENDED)
+      cout << stats.otherPrimitive << " FHit rays hit another primitive" << std::endl;
+    cout.flags(flags);
+    cout.precision(precision);
+  }
+}
@@ -0,0 +1,123 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef __EMBREE_TRACE_REPLAY_H__
+#define __EMBREE_TRACE_REPLAY_H__
+
+#include "trace_reader.h"
+#include "../rtcore.h"
+
+namespace embree
+{
+  /*! Shoots the rays of a recorded trace again against an
+   *  acceleration structure. FirstHit records are replayed with
+   *  intersect, AnyHit records with occluded. The chunks of the
+   *  trace are distributed over the threads of the task scheduler,
+   *  the time spent on every timingStride'th ray of each ray type
+   *  and depth is accumulated. The results are compared against the recorded ones,
+   *  i.e. the type of each ray has to stay the same and the hit
+   *  points of FirstHit-Hit rays have to match the recorded
+   *  differences. Traces with extended records additionally provide
+   *  the exact ray segments and the hit primitives. Records of
+   *  sampled traces count with their weight, such that the ray
+   *  counts and the timings estimate those of the full trace. */
+  class TraceReplay
+  {
+  public:
+
+    /*! Rays of larger depth are accumulated with this depth. */
+    enum { maxDepth = 15 };
+
+    /*! Only every timingStride'th ray of a bucket reads the time stamp counter. */
+    enum { timingStride = 8 };
+
+    /*! Number of bins of the hit point error histogram. */
+    enum { numErrorBins = 7 };
+
+    /*! Replay statistics of one ray type and depth. */
+    struct Bucket
+    {
+      Bucket () : records(0), rays(0.0), timed(0.0), cycles(0.0) {}
+    public:
+      size_t records;    //!< Number of replayed records.
+      double rays;       //!< Summed weights of the replayed records.
+      double timed;      //!< Summed weights of the timed records.
+      double cycles;     //!< Time stamp counter cycles of the timed records, weighted like the records.
+    };
+
+    /*! Replay statistics of all ray types and depths. */
+    struct Stats
+    {
+      Stats ();
+      void add(const Stats& other);
+    public:
+      Bucket buckets[TraceRecord::numTypes][maxDepth+1];   //!< Statistics per ray type and depth.
+      double mismatches[TraceRecord::numTypes];            //!< Weighted rays per recorded type that changed their type.
+      double errors[numErrorBins];                         //!< Weighted histogram of the relative hit point error of FirstHit-Hit rays.
+      double otherPrimitive;                               //!< Weighted FirstHit-Hit rays that hit a different primitive.
+    };
+
+  public:
+
+    /*! Prepares replaying the trace. Epsilon is multiplied with the
+     *  largest origin coordinate to obtain the start of the ray
+     *  segment of secondary rays, as done by the path tracer. */
+    TraceReplay (const Ref<Intersector>& accel, const Ref<TraceReader>& trace, float epsilon = 128.0f*float(ulp));
+
+    /*! Replays all rays. */
+    void run();
+
+    /*! Prints the rays per second and the mismatches of the last run. */
+    void print(std::ostream& cout) const;
+
+    /*! Weighted number of rays of the last run whose type differs from the recorded one. */
+    double numMismatches() const;
+
+    /*! Returns the bin of the error histogram for a relative error. */
+    static size_t errorBin(float error);
+
+    /*! Reconstructs the i'th ray of a view. FirstHit rays start at
+     *  the origin and extend to infinity, AnyHit rays extend to the
+     *  end of their recorded difference, or to infinity if the view
+     *  holds their directions. Extended records provide
+     *  the segment of the ray, which is used instead, assuming the
+     *  recorded ray had a normalized direction. Records with a zero
+     *  difference get an arbitrary direction and an empty AnyHit
+     *  segment. */
+    static Ray ray(const TraceView& view, size_t i, float epsilon);
+
+  private:
+
+    /*! Replay function called once for each thread. */
+    void replayThread();
+    static void run_replayThread(size_t tid, TraceReplay* This, size_t) { This->replayThread(); }
+
+  private:
+    Ref<Intersector> accel;       //!< Acceleration structure to shoot the rays at.
+    Ref<TraceReader> trace;       //!< Trace to replay.
+    float epsilon;                //!< Relative start of secondary rays.
+
+  private:
+    Atomic chunkID;               //!< Next chunk to replay.
+    MutexSys mutex;               //!< Protects the statistics.
+    Stats stats;                  //!< Statistics summed over all threads.
+    double seconds;               //!< Wall clock time of the replay.
+    double cyclesPerSecond;       //!< Measured frequency of the time stamp counter.
+  };
+}
+
+#endif
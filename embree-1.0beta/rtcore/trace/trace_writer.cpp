@@ -0,0 +1,184 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "trace_writer.h"
+
+#include <cstdlib>
+
+namespace embree
+{
+  TraceWriter::ThreadBuffer::ThreadBuffer (size_t fieldsPerRecord, int seed)
+    : num(0), count(0), random(seed)
+  {
+    fields = (int32*) alignedMalloc(recordsPerBuffer*fieldsPerRecord*sizeof(int32));
+  }
+
+  TraceWriter::ThreadBuffer::~ThreadBuffer () {
+    alignedFree(fields);
+  }
+
+  TraceWriter::TraceWriter(const FileName& fileName, const std::string& format, const std::string& sampling)
+    : every(1), rate(1.0f), reservoirSize(0), offset(0)
+  {
+    const bool extend = format.size() >= 4 && format.substr(format.size()-4) == "+ext";
+    const std::string base = extend ? format.substr(0,format.size()-4) : format;
+    if      (base == "v1"    ) this->format = V1;
+    else if (base == "v2"    ) this->format = V2;
+    else if (base == "v2.lz4") this->format = V2_LZ4;
+    else throw std::runtime_error("unknown trace format: "+format);
+
+    const std::string policy = sampling.substr(0,sampling.find(':'));
+    const char* arg = sampling.find(':') == std::string::npos ? "" : sampling.c_str() + sampling.find(':') + 1;
+    if (policy == "all") this->sampling = ALL;
+    else if (policy == "every" && atoi(arg) > 0) {
+      this->sampling = EVERY; every = atoi(arg);
+    }
+    else if (policy == "rate" && atof(arg) > 0.0 && atof(arg) <= 1.0) {
+      this->sampling = RATE; rate = float(atof(arg));
+    }
+    else if (policy == "reservoir" && atoi(arg) > 0) {
+      this->sampling = RESERVOIR; reservoirSize = atoi(arg);
+    }
+    else throw std::runtime_error("invalid trace sampling: "+sampling);
+
+    if (this->sampling != ALL && this->format == V1)
+      throw std::runtime_error("sampled traces require the v2 trace format");
+    if (extend && this->format == V1)
+      throw std::runtime_error("extended records require the v2 trace format");
+    int32 flags = 0;
+    if (this->sampling != ALL) flags |= TraceFileHeader::WEIGHTS;
+    if (extend) flags |= TraceFileHeader::EXTENDED;
+    fieldsPerRecord = traceFieldsPerRecord(flags);
+    weightField = (flags & TraceFileHeader::WEIGHTS) ? baseFields : 0;
+    extField = (flags & TraceFileHeader::EXTENDED) ? traceExtendedField(flags) : 0;
+
+    out = new AsyncWriter(fileName,maxTraceChunkBytes(recordsPerBuffer,fieldsPerRecord),maxQueuedBuffers);
+    tls = createTls();
+
+    if (this->format != V1) {
+      AsyncWriter::Block* block = out.ptr->acquire();
+      TraceFileHeader* header = (TraceFileHeader*) block->data;
+      header->magic = TraceFileHeader::MAGIC;
+      header->version = 2;
+      header->recordsPerChunk = recordsPerBuffer;
+      header->flags = flags;
+      block->size = sizeof(TraceFileHeader);
+      offset += block->size;
+      out.ptr->submit(block);
+    }
+  }
+
+  TraceWriter::~TraceWriter()
+  {
+    /*! destructors must not throw, thus failed writes are only reported */
+    try { finish(); }
+    catch (const std::exception& e) {
+      std::cerr << "Error: cannot finish ray trace file: " << e.what() << std::endl;
+    }
+
+    for (size_t i=0; i<buffers.size(); i++) delete buffers[i];
+    buffers.clear();
+    destroyTls(tls);
+  }
+
+  void TraceWriter::finish()
+  {
+    /*! the reservoirs are complete now, each kept ray stands for seen/kept rays */
+    for (size_t i=0; i<buffers.size(); i++) {
+      for (size_t r=0; r<buffers[i]->reservoirs.size(); r++) {
+        const Reservoir& reservoir = buffers[i]->reservoirs[r];
+        for (size_t j=0; j<reservoir.records.size(); j++)
+          append(buffers[i],reservoir.records[j].record,reservoir.records[j].ext,float(reservoir.seen)/float(reservoir.records.size()));
+      }
+    }
+
+    for (size_t i=0; i<buffers.size(); i++)
+      flush(buffers[i]);
+
+    /*! the trailer goes through the stream block, which the async writer submits last */
+    if (format == V1) {
+      int32 sentinel = TraceRecord::SENTINEL;
+      out.ptr->write(&sentinel,sizeof(int32));
+    }
+    else {
+      TraceFooter footer;
+      footer.indexOffset = offset;
+      footer.numChunks = int32(index.size());
+      footer.sentinel = TraceRecord::SENTINEL;
+      if (index.size()) out.ptr->write(&index[0],index.size()*sizeof(TraceIndexEntry));
+      out.ptr->write(&footer,sizeof(TraceFooter));
+    }
+  }
+
+  TraceWriter::ThreadBuffer* TraceWriter::createThreadBuffer()
+  {
+    Lock<MutexSys> lock(mutex);
+    ThreadBuffer* buffer = new ThreadBuffer(fieldsPerRecord,int(buffers.size())+1);
+    if (format == V2_LZ4) buffer->scratch.resize(recordsPerBuffer*fieldsPerRecord*sizeof(int32));
+    if (sampling == RESERVOIR) buffer->reservoirs.resize(TraceRecord::numTypes*(maxReservoirDepth+1));
+    setTls(tls,buffer);
+    buffers.push_back(buffer);
+    return buffer;
+  }
+
+  void TraceWriter::sample(ThreadBuffer* buffer, const TraceRecord& record, const TraceRecordExt& ext)
+  {
+    const size_t type = size_t(record.type) & 3;
+    const size_t depth = size_t(clamp(record.depth,0,int32(maxReservoirDepth)));
+    Reservoir& reservoir = buffer->reservoirs[type*(maxReservoirDepth+1)+depth];
+
+    /*! the n'th ray replaces a random kept ray with probability k/n */
+    reservoir.seen++;
+    if (reservoir.records.size() < reservoirSize) reservoir.records.push_back(Entry(record,ext));
+    else {
+      size_t j = size_t(buffer->random.getDouble()*double(reservoir.seen));
+      if (j < reservoirSize) reservoir.records[j] = Entry(record,ext);
+    }
+  }
+
+  void TraceWriter::flush(ThreadBuffer* buffer)
+  {
+    if (buffer->num == 0) return;
+
+    /*! encode outside of the lock, thus threads compress in parallel */
+    AsyncWriter::Block* block = out.ptr->acquire();
+    switch (format) {
+    case V1:
+      memcpy(block->data,buffer->fields,buffer->num*sizeof(TraceRecord));
+      block->size = buffer->num*sizeof(TraceRecord);
+      break;
+    case V2:
+      block->size = encodeTraceChunk(buffer->fields,fieldsPerRecord,buffer->num,TraceChunkHeader::NONE,NULL,block->data);
+      break;
+    case V2_LZ4:
+      block->size = encodeTraceChunk(buffer->fields,fieldsPerRecord,buffer->num,TraceChunkHeader::LZ4,&buffer->scratch[0],block->data);
+      break;
+    }
+    buffer->num = 0;
+
+    /*! blocks are written in submission order, so the offset is known here */
+    Lock<MutexSys> lock(mutex);
+    if (format != V1) {
+      TraceIndexEntry entry;
+      entry.offset = offset;
+      entry.header = *(TraceChunkHeader*)block->data;
+      index.push_back(entry);
+    }
+    offset += block->size;
+    out.ptr->submit(block);
+  }
+}
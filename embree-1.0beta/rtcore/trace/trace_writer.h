@@ -0,0 +1,192 @@
+// ======================================================================== //
+// Copyright 2009-2011 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef __EMBREE_TRACE_WRITER_H__
+#define __EMBREE_TRACE_WRITER_H__
+
+#include "trace_record.h"
+#include "trace_format.h"
+#include "async_writer.h"
+#include "math/random.h"
+
+namespace embree
+{
+  /*! Writes trace records to a ray trace file. Each thread appends
+   *  records to its own buffer, thus the per ray path takes no lock
+   *  and does not touch memory shared with other threads. Full
+   *  buffers are encoded by the thread that filled them and handed
+   *  to an AsyncWriter, whose I/O thread writes them while the
+   *  thread continues. As a buffer only ever contains complete
+   *  records, records of different threads never interleave inside
+   *  the file. In the version 2 format each buffer becomes one
+   *  chunk of the file.
+   *
+   *  The writer can store a sample of the rays only. Every kept
+   *  record then carries a weight, the number of rays it stands
+   *  for, such that sums over the weighted records estimate the
+   *  sums over all rays without bias.
+   *
+   *  Extended records additionally store a TraceRecordExt, i.e. the
+   *  pixel and sample of the ray, the hit primitive, and the ray
+   *  segment. They are opt-in as they more than double the size of
+   *  a trace. */
+  class TraceWriter : public RefCount
+  {
+  public:
+
+    /*! File formats the writer supports. */
+    enum Format {
+      V1,       //!< Plain sequence of records.
+      V2,       //!< Chunked file with uncompressed chunks.
+      V2_LZ4    //!< Chunked file with compressed chunks.
+    };
+
+    /*! Policies to select the rays that get stored. */
+    enum Sampling {
+      ALL,        //!< Every ray is stored.
+      EVERY,      //!< Every n'th ray of a thread is stored.
+      RATE,       //!< Each ray is stored with a fixed probability.
+      RESERVOIR   //!< A fixed number of rays per ray type and depth is stored.
+    };
+
+    /*! Number of records of a thread buffer. */
+    enum { recordsPerBuffer = 32*1024 };
+
+    /*! Maximal number of full buffers waiting for the I/O thread. */
+    enum { maxQueuedBuffers = 16 };
+
+    /*! Rays of larger depth share the reservoirs of this depth. */
+    enum { maxReservoirDepth = 15 };
+
+    /*! Opens the trace file for writing. The format is one of "v1",
+     *  "v2", or "v2.lz4", optionally followed by "+ext" to store
+     *  extended records. The sampling is one of "all", "every:n",
+     *  "rate:p", or "reservoir:k". Sampling and extended records
+     *  require the version 2 format, which is able to store the
+     *  additional fields. */
+    TraceWriter(const FileName& fileName, const std::string& format = "v1", const std::string& sampling = "all");
+
+    /*! Flushes all buffers and closes the file. Writing threads have
+     *  to be finished when the writer gets destroyed. Write errors
+     *  are reported but not thrown. */
+    ~TraceWriter();
+
+    /*! Returns true if the writer stores extended records. */
+    __forceinline bool extended() const { return extField != 0; }
+
+    /*! Passes a record of the calling thread to the sampling policy.
+     *  The extension is ignored unless extended records are stored. */
+    __forceinline void write(const TraceRecord& record, const TraceRecordExt& ext = TraceRecordExt())
+    {
+      ThreadBuffer* buffer = (ThreadBuffer*) getTls(tls);
+      if (__builtin_expect(buffer == NULL, false)) buffer = createThreadBuffer();
+
+      switch (sampling) {
+      case ALL:
+        append(buffer,record,ext,1.0f);
+        break;
+      case EVERY:
+        if (++buffer->count == every) { buffer->count = 0; append(buffer,record,ext,float(every)); }
+        break;
+      case RATE:
+        if (buffer->random.getFloat() < rate) append(buffer,record,ext,1.0f/rate);
+        break;
+      case RESERVOIR:
+        sample(buffer,record,ext);
+        break;
+      }
+    }
+
+  private:
+
+    /*! A record kept in a reservoir. */
+    struct Entry {
+      Entry () {}
+      Entry (const TraceRecord& record, const TraceRecordExt& ext) : record(record), ext(ext) {}
+    public:
+      TraceRecord record;                 //!< The record.
+      TraceRecordExt ext;                 //!< Its extension.
+    };
+
+    /*! Sample of the rays of one ray type and depth. */
+    struct Reservoir {
+      Reservoir () : seen(0) {}
+    public:
+      size_t seen;                        //!< Number of rays offered to the reservoir.
+      std::vector<Entry> records;         //!< Sampled rays.
+    };
+
+    /*! Buffer of records of a single thread. */
+    struct ThreadBuffer
+    {
+      ThreadBuffer (size_t fieldsPerRecord, int seed);
+      ~ThreadBuffer ();
+    public:
+      size_t num;                         //!< Number of records in the buffer.
+      int32* fields;                      //!< Fields of the buffered records.
+      std::vector<char> scratch;          //!< Scratch memory for compression.
+      size_t count;                       //!< Rays since the last stored ray.
+      Random random;                      //!< Random numbers for sampling.
+      std::vector<Reservoir> reservoirs;  //!< Reservoirs of all ray types and depths.
+    };
+
+    /*! Creates the buffer of the calling thread. */
+    ThreadBuffer* createThreadBuffer();
+
+    /*! Appends a record to the buffer. */
+    __forceinline void append(ThreadBuffer* buffer, const TraceRecord& record, const TraceRecordExt& ext, float weight)
+    {
+      int32* fields = buffer->fields + buffer->num*fieldsPerRecord;
+      *(TraceRecord*)fields = record;
+      if (weightField) ((float*)fields)[weightField] = weight;
+      if (extField) *(TraceRecordExt*)(fields+extField) = ext;
+      if (__builtin_expect(++buffer->num == recordsPerBuffer, false)) flush(buffer);
+    }
+
+    /*! Offers a record to the reservoir of its ray type and depth. */
+    void sample(ThreadBuffer* buffer, const TraceRecord& record, const TraceRecordExt& ext);
+
+    /*! Encodes the records of a buffer, queues them for writing, and empties the buffer. */
+    void flush(ThreadBuffer* buffer);
+
+    /*! Writes the reservoirs, all buffers, and the trailer of the file. */
+    void finish();
+
+  private:
+
+    /*! Number of fields of a record without optional fields. */
+    enum { baseFields = sizeof(TraceRecord)/sizeof(int32) };
+
+    Format format;                        //!< Format of the file.
+    Sampling sampling;                    //!< Policy to select stored rays.
+    size_t every;                         //!< Distance of stored rays for EVERY sampling.
+    float rate;                           //!< Probability to store a ray for RATE sampling.
+    size_t reservoirSize;                 //!< Rays per reservoir for RESERVOIR sampling.
+    size_t fieldsPerRecord;               //!< Number of 4 byte fields of a record.
+    size_t weightField;                   //!< Field of the weight, 0 if records carry no weight.
+    size_t extField;                      //!< First field of the extension, 0 if records are not extended.
+
+    Ref<AsyncWriter> out;                 //!< Writes encoded buffers to the file.
+    tls_t tls;                            //!< Thread local pointer to the buffer of a thread.
+    MutexSys mutex;                       //!< Protects the state below.
+    std::vector<ThreadBuffer*> buffers;   //!< Buffers of all threads that wrote records.
+    int64 offset;                         //!< File offset of the next block.
+    std::vector<TraceIndexEntry> index;   //!< Index of all written chunks.
+  };
+}
+
+#endif